@@ -4,35 +4,56 @@
 ##  $ mkdir /<LOCATION>/.build-perl
 ##  $ cp auto-build-perl.sh /<LOCATION>/.build-perl/
 ##  $ cd /<LOCATION>/.build-perl/
-##  $ ./build-perl.sh perl-5.nn.n.tar.gz
+##  $ ./build-perl.sh perl-5.nn.n.tar.gz [debug|release|lto|pgo|all]
+
+## Variants, each installed side by side under its own prefix:
+##   debug    -O0 -g + AddressSanitizer, for chasing the SEGV  <BASE>/perl-5.nn.n-oic-NN
+##   release  -O2                                               <BASE>/perl-5.nn.n-oic-NN-release
+##   lto      -O2 -flto                                         <BASE>/perl-5.nn.n-oic-NN-lto
+##   pgo      -O2, trained on t_A_segv.pl then rebuilt          <BASE>/perl-5.nn.n-oic-NN-pgo
+## pgo needs ORA_SOURCE, ORA_SCHEMA and ORA_PASSWD for the training run and
+## SEGV_PERL=<dir of t_A_segv.pl> once this script is copied away from the repo.
+## bench-perl-variants.sh then compares whatever was installed.
 
 ## Default Build
 #MIN='-min'
 REF="${1:-perl-5.40.2.tar.gz}"
+VARIANTS="${2:-debug}"
 OIC="${ORACLE_HOME#/usr/lib/oracle/}"
 OIC="${OIC%/client64}"
 BASE="${PWD%/*}"
+SEGV_PERL="${SEGV_PERL:-$(cd "$(dirname "$0")/../segv-perl" 2>/dev/null && pwd)}"
+PGOD="${PWD}/pgo-profile"
+
+[ "$VARIANTS" = all ] && VARIANTS='debug release lto pgo'
 
 title ()  { echo "$1"; }
 abort ()  { echo ' ABRT ->> '"$*"; title 'ABORTED'; exit 1; }
 info  ()  { echo ' INFO ->> '"$*"; }
 
+## Install prefix of a variant; debug keeps the original name
+prefix ()
+{
+  local PERL="${REF%.tar.gz}-oic-${OIC}${MIN}"
+  [ "$1" = debug ] && echo "${BASE}/${PERL}" || echo "${BASE}/${PERL}-$1"
+}
+
 announce_begin ()
 {
   local PERL="${REF%.tar.gz}"
-  title "BUILDING: ${PERL} ${OIC}"
+  title "BUILDING: ${PERL} ${OIC} ${VARIANT}"
   info '+ -------------------------------- +'
-  info "  Building: ${PERL} ${OIC}"
+  info "  Building: ${PERL} ${OIC} ${VARIANT}"
   info '+ -------------------------------- +'
 }
 
 announce_end ()
 {
   local PERL="${REF%.tar.gz}"
-  title "COMPLETE: ${PERL} ${OIC}"
+  title "COMPLETE: ${PERL} ${OIC} ${VARIANT}"
   echo
   info '+ -------------------------------- +'
-  info "  Complete: ${PERL} ${OIC}"
+  info "  Complete: ${PERL} ${OIC} ${VARIANT}"
   info '+ -------------------------------- +'
   echo
 }
@@ -40,10 +61,10 @@ announce_end ()
 announce_fail ()
 {
   local PERL="${REF%.tar.gz}"
-  title "BUILD-FAIL: ${PERL} ${OIC}"
+  title "BUILD-FAIL: ${PERL} ${OIC} ${VARIANT}"
   echo
   info '+ -------------------------------- +'
-  info "  ABORT: ${PERL} ${OIC}"
+  info "  ABORT: ${PERL} ${OIC} ${VARIANT}"
   info '+ -------------------------------- +'
   echo
 }
@@ -57,14 +78,47 @@ get_perl_tar ()
     || curl -k --output ./${PERL} "${URI}${LEAF}${PERL}"
 }
 
+## rebuild_perl <variant> [pgo-generate|pgo-use]
 rebuild_perl ()
 {
   local PERL=$REF
-  local INST="${BASE}/${PERL%.tar.gz}-oic-${OIC}${MIN}"
+  local INST="$(prefix $1)"
   local BULD="./${PERL%.tar.gz}"
-  local DBUG="-DEBUGGING=-g -O0"
+  local OPTI='-O2'
+  local CFLG=''
+  local LFLG=''
+  local -a XTRA=()
 # local DEVL="-Dusedevel"
 
+  case "${2:-$1}" in
+    debug)
+      OPTI='-O0 -g'
+      CFLG='-fsanitize=address -g -fno-omit-frame-pointer'
+      LFLG='-fsanitize=address'
+      ;;
+    release)
+      ;;
+    lto)
+      ## libperl.a holds LTO objects, so it needs the plugin-aware archiver
+      OPTI='-O2 -flto=auto'
+      XTRA=( -Dar=gcc-ar -Dranlib=gcc-ranlib -Aldflags='-flto=auto' )
+      ;;
+    pgo-generate)
+      ## Atomic counters: the training workload is threaded
+      OPTI="-O2 -fprofile-generate -fprofile-update=atomic -fprofile-dir=${PGOD}"
+      XTRA=( -Aldflags='-fprofile-generate' )
+      ;;
+    pgo-use)
+      ## Same build path as the instrumented run so the profiles line up;
+      ## the XS modules are force-rebuilt afterwards (cpan_finish force), so
+      ## none of the instrumented ones survive - they just go unprofiled
+      OPTI="-O2 -fprofile-use -fprofile-correction -Wno-missing-profile -fprofile-dir=${PGOD}"
+      ;;
+    *)
+      abort "Unknown variant: ${2:-$1} (debug, release, lto, pgo or all)"
+      ;;
+  esac
+
   [ -r $PERL ] || return $?
   [ -d $BULD ] && rm -rf $BULD
   [ -d $BULD ] || info  'Confirmed BULD '$BULD' is removed (fresh build)'
@@ -75,46 +129,91 @@ rebuild_perl ()
   tar xzf $PERL && \
   (
     cd $BULD && \
-    sed -i "s/^optimize=''/optimize='-O0 -g'/" Configure && \
-    CFLAGS="-fsanitize=address -g -fno-omit-frame-pointer" LDFLAGS="-fsanitize=address" \
-    ./Configure -des -Dusethreads -Duse64bitint -Duse64bitall -Dprefix=${INST} $DEVL \
-      -Alddlflags="-shared -g -O0 -L/usr/local/lib -fstack-protector-strong" \
-      -Accflags="-g -O0" \
+    sed -i "s|^optimize=''|optimize='${OPTI}'|" Configure && \
+    CFLAGS="${CFLG}" LDFLAGS="${LFLG}" \
+    ./Configure -des -Dusethreads -Duse64bitint -Duse64bitall -Dprefix=${INST} $DEVL "${XTRA[@]}" \
+      -Alddlflags="-shared ${OPTI} -L/usr/local/lib -fstack-protector-strong" \
+      -Accflags="${OPTI}" \
     && make install
   )
 }
 
 cpan_env ()
 {
-   local PERL="${REF%.tar.gz}-oic-${OIC}${MIN}"
+  local INST="$(prefix ${VARIANT})"
   export PERL_LWP_SSL_VERIFY_HOSTNAME=0
   export PERL_RL_TEST_PROMPT_MENLEN=0
   export DATE_MANIP_TEST_DM5=1
   export PERL_READLINE_NOWARN=1
 
-  export PATH=${BASE}/${PERL}/bin:/usr/sbin:/usr/bin
+  export PATH=${INST}/bin:/usr/sbin:/usr/bin
   echo $PATH
   which perl
 
   return 0
 }
 
+## cpan_finish [force]
+## force: rebuild even what cpan considers up to date - after the pgo-use
+## rebuild the instrumented XS modules must not be picked up again
 cpan_finish ()
 {
+  local FRCE=''
+  [ "$1" = force ] && FRCE='-f'
+
   cpan_env
 
-  cpan Log::Log4perl Config::Simple Term::ReadKey &&
-  cpan GSSAPI DBI DBD::Oracle
+  cpan ${FRCE} -i Log::Log4perl Config::Simple Term::ReadKey &&
+  cpan ${FRCE} -i GSSAPI DBI DBD::Oracle
+}
+
+## Run the thread/DBI workload on the instrumented perl.  Profiles written
+## while building and while cpan installed modules are dropped first.
+pgo_train ()
+{
+  [ -r "${SEGV_PERL}/t_A_segv.pl" ] || abort 'SEGV_PERL: t_A_segv.pl not found for the PGO training run'
+  [ -n "$ORA_SOURCE" -a -n "$ORA_SCHEMA" -a -n "$ORA_PASSWD" ] || \
+    abort 'PGO training: export ORA_SOURCE, ORA_SCHEMA and ORA_PASSWD'
+
+  rm -rf ${PGOD}
+  info "Training on ${SEGV_PERL}/t_A_segv.pl"
+
+  ## A crashed run writes no profile: warn, keep whatever the others left
+  for RUN in 1 2 3
+  do
+    ( cd ${SEGV_PERL} && \
+      DBQ_TIMING=1,4,8 DBQ_SHARED=4 DBQ_SPAWN=200 DBQ_TRIALS=3 perl t_A_segv.pl > /dev/null 2>&1 ) || \
+      info "Training run ${RUN} failed"
+  done
+
+  [ -d ${PGOD} ] || abort "No profile written to ${PGOD}"
+}
+
+build_variant ()
+{
+  if [ "$VARIANT" = pgo ]
+  then
+    rebuild_perl pgo pgo-generate && \
+    cpan_finish                   && \
+    pgo_train                     && \
+    rebuild_perl pgo pgo-use      && \
+    cpan_finish force
+  else
+    rebuild_perl $VARIANT         && \
+    cpan_finish
+  fi
 }
 
 
+for VARIANT in $VARIANTS
+do
   announce_begin  && \
 ##check_settings  && \
   get_perl_tar    && \
-  rebuild_perl    && \
-  cpan_finish     && \
+  build_variant   && \
 
-announce_end || announce_fail
+  announce_end || announce_fail
+done
 
 ## vim: number expandtab tabstop=2 shiftwidth=2
 ## END
@@ -0,0 +1,125 @@
+#!/bin/bash
+
+## USAGE:
+##  $ cd /<LOCATION>/.build-perl/
+##  $ ./bench-perl-variants.sh perl-5.nn.n.tar.gz [debug release lto pgo]
+##
+## Runs the same t_A_segv.pl connect/ping workload on every variant that
+## auto-build-perl.sh installed and tabulates the medians, with the speedup
+## over the first variant found (debug unless it is missing).  Needs
+## ORA_SOURCE, ORA_SCHEMA and ORA_PASSWD, and SEGV_PERL=<dir of t_A_segv.pl>
+## once copied away from the repo.
+##
+##   RUNS=5          runs per variant (median taken)
+##   DBQ_TIMING=4    workers for the ping dispatch timing
+##   DBQ_SPAWN=200   threads->create/join and pool hand-offs timed
+
+REF="${1:-perl-5.40.2.tar.gz}"
+shift
+VARIANTS="${*:-debug release lto pgo}"
+OIC="${ORACLE_HOME#/usr/lib/oracle/}"
+OIC="${OIC%/client64}"
+BASE="${PWD%/*}"
+SEGV_PERL="${SEGV_PERL:-$(cd "$(dirname "$0")/../segv-perl" 2>/dev/null && pwd)}"
+RUNS="${RUNS:-5}"
+WORKERS="${DBQ_TIMING:-4}"
+SPAWN="${DBQ_SPAWN:-200}"
+LOGS="${PWD}/bench-logs"
+
+title ()  { echo "$1"; }
+abort ()  { echo ' ABRT ->> '"$*"; title 'ABORTED'; exit 1; }
+info  ()  { echo ' INFO ->> '"$*"; }
+
+## Same naming as auto-build-perl.sh
+prefix ()
+{
+  local PERL="${REF%.tar.gz}-oic-${OIC}${MIN}"
+  [ "$1" = debug ] && echo "${BASE}/${PERL}" || echo "${BASE}/${PERL}-$1"
+}
+
+## One run of the workload; prints: wall ping/s burst/s create_us pool_us.
+## A failed check still leaves valid timings; a crashed run has none.
+run_once ()
+{
+  local INST="$1"
+  local LOG="$2"
+
+  ( cd ${SEGV_PERL} && \
+    PATH=${INST}/bin:/usr/sbin:/usr/bin \
+    ASAN_OPTIONS="${ASAN_OPTIONS:-detect_leaks=0}" \
+    DBQ_TIMING=${WORKERS} DBQ_ROUNDS=200 DBQ_SPAWN=${SPAWN} DBQ_TRIALS=3 \
+    ${INST}/bin/perl t_A_segv.pl > ${LOG} 2>&1 )
+
+  ## Test::More notes: the QUEUE_TIMING row, the THREAD_SPAWN rows, the total
+  awk -v W=${WORKERS} '
+    $1 == "#" && $2 == W && $3 == 200 && NF == 10  { ping = $9; burst = $10 }
+    $1 == "#" && $2 == "create" && NF == 10        { create = $6 }
+    $1 == "#" && $2 == "pool" && NF == 10          { pool = $6 }
+    /^# Completed in /                             { wall = $4 + 0 }
+    END { if (wall && ping && create) print wall, ping, burst, create, pool; else exit 1 }
+  ' ${LOG}
+}
+
+## Median of each column over the runs
+median ()
+{
+  awk '
+    { for (i = 1; i <= NF; i++) v[i, NR] = $i; nf = NF }
+    END {
+      for (i = 1; i <= nf; i++) {
+        n = 0
+        for (r = 1; r <= NR; r++) a[++n] = v[i, r]
+        for (x = 2; x <= n; x++)
+          for (y = x; y > 1 && a[y - 1] > a[y]; y--) { t = a[y]; a[y] = a[y - 1]; a[y - 1] = t }
+        printf "%s%s", (i > 1 ? " " : ""), (n % 2 ? a[(n + 1) / 2] : (a[n / 2] + a[n / 2 + 1]) / 2)
+      }
+      print ""
+    }'
+}
+
+[ -r "${SEGV_PERL}/t_A_segv.pl" ] || abort 'SEGV_PERL: t_A_segv.pl not found'
+[ -n "$ORA_SOURCE" -a -n "$ORA_SCHEMA" -a -n "$ORA_PASSWD" ] || \
+  abort 'export ORA_SOURCE, ORA_SCHEMA and ORA_PASSWD'
+mkdir -p ${LOGS}
+
+declare -A RESULT
+FOUND=''
+
+for VARIANT in $VARIANTS
+do
+  INST="$(prefix ${VARIANT})"
+  [ -x ${INST}/bin/perl ] || { info "Skipping ${VARIANT}: no ${INST}/bin/perl"; continue; }
+
+  info "Benchmarking ${VARIANT} (${RUNS} runs)"
+  ROWS=''
+  for RUN in $(seq 1 ${RUNS})
+  do
+    ROW=$(run_once ${INST} ${LOGS}/${VARIANT}-${RUN}.log) || \
+      { info "${VARIANT} run ${RUN} failed, see ${LOGS}/${VARIANT}-${RUN}.log"; continue; }
+    ROWS="${ROWS}${ROW}"$'\n'
+  done
+  [ -n "$ROWS" ] || continue
+
+  RESULT[$VARIANT]=$(printf '%s' "$ROWS" | median)
+  FOUND="${FOUND} ${VARIANT}"
+done
+
+[ -n "$FOUND" ] || abort 'No variant could be benchmarked'
+
+## Speedup: higher is better for every column (times inverted)
+echo
+printf '%-8s %9s %10s %10s %11s %9s   %s\n' \
+  VARIANT 'WALL s' 'PING/S' 'BURST/S' 'CREATE us' 'POOL us' 'SPEEDUP wall/ping/burst/create/pool'
+BASELINE=''
+for VARIANT in $FOUND
+do
+  [ -n "$BASELINE" ] || BASELINE="${RESULT[$VARIANT]}"
+  echo ${RESULT[$VARIANT]} ${BASELINE} | awk -v V=${VARIANT} '{
+    printf "%-8s %9.3f %10.1f %10.1f %11.2f %9.2f   %.2fx %.2fx %.2fx %.2fx %.2fx\n", V, $1, $2, $3, $4, $5,
+      $6 / $1, $2 / $7, $3 / $8, $9 / $4, ($5 ? $10 / $5 : 0)
+  }'
+done
+echo
+
+## vim: number expandtab tabstop=2 shiftwidth=2
+## END
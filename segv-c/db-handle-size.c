@@ -5,22 +5,66 @@
 #include <pthread.h>
 #include <oci.h>
 #include <unistd.h> // For getopt
-
-#define HANDLE_SAMPLE_SIZE 10
-
-typedef struct hi_t HandleInspect;
-
-typedef union {
-    HandleInspect * handle;
-    uint8_t         address[8];
-} peek_t;
-
-struct hi_t {
-    uint8_t     leader[8];
-    peek_t      a;
-    peek_t      b;
-    peek_t      c;
+#include "malloc-count.h"
+#include "env-alloc.h"
+
+#define DEFAULT_COUNT 100
+
+// Connected probes need more than one handle per sample
+#define PROBE_ATTACHED      1000    // server handle + OCIServerAttach
+#define PROBE_CONNECTION    1001    // server, svcctx and session, attached and logged on
+
+typedef struct {
+    const char* name;
+    ub4         type;       // OCI_HTYPE_* or PROBE_*
+    ub4         mode;       // OCIEnvNlsCreate mode for OCI_HTYPE_ENV
+    int         connected;  // needs ORA_* credentials and a listener (-c)
+} Probe;
+
+static const Probe probes[] = {
+    { "env_default",    OCI_HTYPE_ENV,      OCI_DEFAULT,    0 },
+    { "env_threaded",   OCI_HTYPE_ENV,      OCI_THREADED,   0 },
+    { "error",          OCI_HTYPE_ERROR,    0,              0 },
+    { "server",         OCI_HTYPE_SERVER,   0,              0 },
+    { "svcctx",         OCI_HTYPE_SVCCTX,   0,              0 },
+    { "session",        OCI_HTYPE_SESSION,  0,              0 },
+    { "stmt",           OCI_HTYPE_STMT,     0,              0 },
+    { "attached",       PROBE_ATTACHED,     0,              1 },
+    { "connection",     PROBE_CONNECTION,   0,              1 },
 };
+#define PROBE_COUNT ((int)(sizeof(probes) / sizeof(probes[0])))
+
+// One sample: up to three handles (connection probe)
+typedef struct {
+    void*       h[3];
+    EnvAlloc*   alloc;      // -A: allocator behind an env probe
+    int         attached;
+    int         logged_on;
+} Sample;
+
+typedef struct {
+    const char* name;
+    int         count;      // handles actually created
+    double      bytes;      // heap bytes per handle while held
+    double      allocs;     // malloc calls per handle to create it
+    double      frees;      // free calls per handle to release it
+    double      peak;       // transient heap high-water mark per handle
+    double      rss;        // RSS growth per handle while held
+    double      retained;   // heap bytes per handle left behind after freeing
+    char        error[256];
+} Footprint;
+
+// Parent handles shared by the child-handle probes
+typedef struct {
+    OCIEnv*     envhp;
+    OCIError*   errhp;
+    const char* schema;
+    const char* passwd;
+    const char* dbname;
+    EnvAllocKind  env_alloc;    // -A: memory callbacks for every environment
+    EnvAlloc*     alloc;        // allocator behind envhp
+    EnvAllocStats alloc_stats;  // counters of every allocator released so far
+} Parent;
 
 void dump_memory(void *ptr, size_t size) {
     unsigned char *data = (unsigned char*) ptr;
@@ -31,239 +75,354 @@ void dump_memory(void *ptr, size_t size) {
     printf("\n");
 }
 
-// Detect ENV handle size (a guess)
-void* db_eng_size()
+// Resident set size in bytes from /proc/self/statm
+static long rss_bytes(void)
 {
-    OCIEnv* envset[HANDLE_SAMPLE_SIZE]; // OCI environment handle (OCIEnvNlsCreate)
-    sword   status  = OCI_SUCCESS;
-    int     size    = 0;;
-    OCIEnv* env     = NULL; // OCI environment handle (OCIEnvNlsCreate)
-
-    for ( int i = 0 ; i < HANDLE_SAMPLE_SIZE ; i++ )
-    {
-    //  if (( status = OCIEnvNlsCreate(&envset[i], OCI_DEFAULT,  0, NULL, NULL, NULL, 0, NULL, 0, 0)) != OCI_SUCCESS)
-        if (( status = OCIEnvNlsCreate(&envset[i], OCI_THREADED, 0, NULL, NULL, NULL, 0, NULL, 0, 0)) != OCI_SUCCESS)
-            printf("Failed to initialize OCI (envset[%d]) environment", i);
-    }
-
-    for ( int i = 0 ; i < HANDLE_SAMPLE_SIZE ; i++ )
-    {
-        if ( i > 0 )
-        {
-        //  printf("OCIEnvNlsCreate(handle=%ld,...) %p %p\n", 0l, envset[i], envset[i-1] );
-            printf("OCIEnvNlsCreate(handle=%ld,...) %p\n"
-                ,(long)( ((char*)envset[i]) - (char*)(envset[i-1] ))
-                , envset[i-1]);
-        }
-        dump_memory(envset[i],64); 
-    }
+    long  size = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+
+    if (!f)
+        return 0;
+    if (fscanf(f, "%ld %ld", &size, &resident) != 2)
+        resident = 0;
+    fclose(f);
+    return resident * sysconf(_SC_PAGESIZE);
+}
 
-    for ( int i = 0 ; i < HANDLE_SAMPLE_SIZE ; i++ )
-    {
-        env = envset[i];
-        if (env && (status = OCIHandleFree(env, OCI_HTYPE_ENV)) != OCI_SUCCESS )
-            fprintf(stderr, "OCIHandleFree(env, OCI_HTYPE_ENV) returned %d\n", status);
-        envset[i] = NULL;
-    }
+static void oci_error(Parent* p, Footprint* fp, const char* what)
+{
+    sb4 code = 0;
+    int len  = snprintf(fp->error, sizeof(fp->error), "%s: ", what);
 
-    printf("SIZEOF: HandleInspect = %lu\n", sizeof(HandleInspect));
+    if (OCIErrorGet(p->errhp, 1, NULL, &code, (OraText*)fp->error + len, sizeof(fp->error) - len, OCI_HTYPE_ERROR) != OCI_SUCCESS)
+        snprintf(fp->error + len, sizeof(fp->error) - len, "failed");
 }
 
-// Thread function
-/*
-void* db_thread_function(void* arg)
+// Create one sample of the probe; 0 on success
+static int probe_create(const Probe* pr, Parent* p, Sample* s, Footprint* fp)
 {
-    ThreadStatus* t_status = (ThreadStatus*)arg;
-    OCIEnv*     mng_env = NULL; // OCI environment handle (OCIEnvNlsCreate)
-    OCIEnv*     envhp   = NULL; // OCI environment handle (OCIEnvNlsCreate)
-    OCIError*   errhp   = NULL; // OCI error handle
-    OCIServer*  srvhp   = NULL; // OCI server handle
-    OCISvcCtx*  svchp   = NULL; // OCI service context handle
-    OCISession* seshp   = NULL; // OCI session handle
-    sword status;
-
-    // Get credentials from environment variables
-    const char* schema = getenv("ORA_SCHEMA");
-    const char* passwd = getenv("ORA_PASSWD");
-    const char* dbname = getenv("ORA_DBNAME");
-
-//  if (OCIEnvCreate(&env, OCI_THREADED, NULL, NULL, NULL, NULL, 0, NULL) != OCI_SUCCESS) {
-
-    // Initialize OCI environment - mimic what is seen in DBD::Oracle ->> OCI_DEFAULT
-    if (( status = OCIEnvNlsCreate(&mng_env, OCI_DEFAULT, 0, NULL, NULL, NULL, 0, NULL, 0, 0)) != OCI_SUCCESS) {
-        snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to initialize OCI (mng_env) environment");
-        t_status->connection_status = status;
-        pthread_exit(NULL);
+    memset(s, 0, sizeof(*s));
+
+    switch (pr->type) {
+        case OCI_HTYPE_ENV:
+            s->alloc = env_alloc_create(p->env_alloc);
+            if (OCIEnvNlsCreate((OCIEnv**)&s->h[0], pr->mode, ENV_ALLOC_CALLBACKS(s->alloc), 0, NULL, 0, 0) != OCI_SUCCESS) {
+                snprintf(fp->error, sizeof(fp->error), "OCIEnvNlsCreate failed");
+                return -1;
+            }
+            return 0;
+
+        case PROBE_ATTACHED:
+        case PROBE_CONNECTION:
+            if (OCIHandleAlloc(p->envhp, &s->h[0], OCI_HTYPE_SERVER, 0, NULL) != OCI_SUCCESS) {
+                snprintf(fp->error, sizeof(fp->error), "OCIHandleAlloc(SERVER) failed");
+                return -1;
+            }
+            if (OCIServerAttach(s->h[0], p->errhp, (OraText*)p->dbname, strlen(p->dbname), OCI_DEFAULT) != OCI_SUCCESS) {
+                oci_error(p, fp, "OCIServerAttach");
+                return -1;
+            }
+            s->attached = 1;
+            if (pr->type == PROBE_ATTACHED)
+                return 0;
+
+            if (OCIHandleAlloc(p->envhp, &s->h[1], OCI_HTYPE_SVCCTX, 0, NULL) != OCI_SUCCESS
+             || OCIHandleAlloc(p->envhp, &s->h[2], OCI_HTYPE_SESSION, 0, NULL) != OCI_SUCCESS) {
+                snprintf(fp->error, sizeof(fp->error), "OCIHandleAlloc(SVCCTX/SESSION) failed");
+                return -1;
+            }
+            if (OCIAttrSet(s->h[1], OCI_HTYPE_SVCCTX, s->h[0], 0, OCI_ATTR_SERVER, p->errhp) != OCI_SUCCESS
+             || OCIAttrSet(s->h[2], OCI_HTYPE_SESSION, (void*)p->schema, strlen(p->schema), OCI_ATTR_USERNAME, p->errhp) != OCI_SUCCESS
+             || OCIAttrSet(s->h[2], OCI_HTYPE_SESSION, (void*)p->passwd, strlen(p->passwd), OCI_ATTR_PASSWORD, p->errhp) != OCI_SUCCESS) {
+                oci_error(p, fp, "OCIAttrSet");
+                return -1;
+            }
+            if (OCISessionBegin(s->h[1], p->errhp, s->h[2], OCI_CRED_RDBMS, OCI_DEFAULT) != OCI_SUCCESS) {
+                oci_error(p, fp, "OCISessionBegin");
+                return -1;
+            }
+            s->logged_on = 1;
+            if (OCIAttrSet(s->h[1], OCI_HTYPE_SVCCTX, s->h[2], 0, OCI_ATTR_SESSION, p->errhp) != OCI_SUCCESS) {
+                oci_error(p, fp, "OCIAttrSet(SESSION)");
+                return -1;
+            }
+            return 0;
+
+        default:
+            if (OCIHandleAlloc(p->envhp, &s->h[0], pr->type, 0, NULL) != OCI_SUCCESS) {
+                snprintf(fp->error, sizeof(fp->error), "OCIHandleAlloc(%s) failed", pr->name);
+                return -1;
+            }
+            return 0;
     }
+}
 
-    // DBD::Oracle uses this function. Works here OK ->> OCI_THREADED
-    if (( status = OCIEnvNlsCreate(&envhp, OCI_THREADED, 0, NULL, NULL, NULL, 0, NULL, 0, 0)) != OCI_SUCCESS) {
-        snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to initialize OCI environment");
-        t_status->connection_status = status;
-        pthread_exit(NULL);
+// Release whatever probe_create managed to set up
+static void probe_destroy(const Probe* pr, Parent* p, Sample* s)
+{
+    switch (pr->type) {
+        case OCI_HTYPE_ENV:
+            if (s->h[0])
+                OCIHandleFree(s->h[0], OCI_HTYPE_ENV);
+            env_alloc_destroy(s->alloc, &p->alloc_stats);
+            break;
+
+        case PROBE_ATTACHED:
+        case PROBE_CONNECTION:
+            if (s->logged_on)
+                OCISessionEnd(s->h[1], p->errhp, s->h[2], OCI_DEFAULT);
+            if (s->attached)
+                OCIServerDetach(s->h[0], p->errhp, OCI_DEFAULT);
+            if (s->h[2])
+                OCIHandleFree(s->h[2], OCI_HTYPE_SESSION);
+            if (s->h[1])
+                OCIHandleFree(s->h[1], OCI_HTYPE_SVCCTX);
+            if (s->h[0])
+                OCIHandleFree(s->h[0], OCI_HTYPE_SERVER);
+            break;
+
+        default:
+            if (s->h[0])
+                OCIHandleFree(s->h[0], pr->type);
+            break;
     }
+    memset(s, 0, sizeof(*s));
+}
 
-    // Allocate error handle
-    if (( status = OCIHandleAlloc(envhp, (void**)&errhp, OCI_HTYPE_ERROR, 0, NULL)) != OCI_SUCCESS) {
-        snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to allocate OCI error handle");
-        t_status->connection_status = status;
-        pthread_exit(NULL);
+// Hold count samples of one probe and measure what they cost
+static void probe_run(const Probe* pr, Parent* p, Sample* samples, int count, int dump, Footprint* fp)
+{
+    MallocCount before, held, after;
+    long        rss_before, rss_held;
+    int         n;
+
+    memset(fp, 0, sizeof(*fp));
+    fp->name = pr->name;
+
+    rss_before = rss_bytes();
+    malloc_count_reset_peak();
+    malloc_count_snapshot(&before);
+    for (n = 0; n < count; n++) {
+        if (probe_create(pr, p, &samples[n], fp) != 0) {
+            probe_destroy(pr, p, &samples[n]);
+            break;
+        }
     }
+    malloc_count_snapshot(&held);
+    rss_held = rss_bytes();
 
-    // Allocate server handle
-    if (( status = OCIHandleAlloc(envhp, (void**)&srvhp, OCI_HTYPE_SERVER, 0, NULL)) != OCI_SUCCESS) {
-        snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to allocate OCI server handle");
-        t_status->connection_status = status;
-        pthread_exit(NULL);
+    if (dump && n > 0) {
+        printf(" %s handle %p:\n", pr->name, samples[0].h[0]);
+        dump_memory(samples[0].h[0], 64);
     }
 
-    // CTX: Allocate service context handle
-    if (( status = OCIHandleAlloc(envhp, (void**)&svchp, OCI_HTYPE_SVCCTX, 0, NULL)) != OCI_SUCCESS) {
-        snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to allocate OCI service handle");
-        t_status->connection_status = status;
-        pthread_exit(NULL);
-    }
+    for (int i = 0; i < n; i++)
+        probe_destroy(pr, p, &samples[i]);
+    malloc_count_snapshot(&after);
+
+    fp->count = n;
+    if (n == 0)
+        return;
+    fp->bytes    = (double)(held.live - before.live) / n;
+    fp->allocs   = (double)(held.allocs - before.allocs) / n;
+    fp->frees    = (double)(after.frees - held.frees) / n;
+    fp->peak     = (double)(after.peak - before.live) / n;
+    fp->rss      = (double)(rss_held - rss_before) / n;
+    fp->retained = (double)(after.live - before.live) / n;
+}
 
-    // Allocate session handle (dbdcnx.c, #339)
-    if (( status = OCIHandleAlloc(envhp, (void**)&seshp, OCI_HTYPE_SESSION, 0, NULL)) != OCI_SUCCESS) {
-        snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to allocate OCI session handle");
-        t_status->connection_status = status;
-        pthread_exit(NULL);
-    }
+static void write_report(const char* path, int count, const MallocCount* first, const Parent* p, Footprint* fps, int nfp)
+{
+    const char* ext  = strrchr(path, '.');
+    int         json = ext && strcmp(ext, ".json") == 0;
+    FILE*       f    = fopen(path, "w");
 
-    // Attach to the server (dbdcnx.c, :#346)
-    if (( status = OCIServerAttach(srvhp, errhp, (OraText*)dbname, strlen(dbname), OCI_DEFAULT)) != OCI_SUCCESS) {
-        OCIErrorGet(errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
-        t_status->connection_status = -1;
-        goto cleanup;
+    if (!f) {
+        perror(path);
+        return;
     }
 
-    // Set the server handle in the service context (dbdcnx.c, L#353)
-    if (( status = OCIAttrSet(svchp, OCI_HTYPE_SVCCTX, srvhp, 0, OCI_ATTR_SERVER, errhp)) != OCI_SUCCESS) {
-        snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to set server handle in service context");
-        t_status->connection_status = status;
-        pthread_exit(NULL);
+    if (json) {
+        fprintf(f, "{\n  \"count\": %d,\n", count);
+        fprintf(f, "  \"first_env\": { \"bytes\": %lld, \"allocs\": %llu },\n",
+                (long long)first->live, (unsigned long long)first->allocs);
+        fprintf(f, "  \"env_alloc\": { \"kind\": \"%s\", \"envs\": %llu, \"allocs\": %llu, \"bytes\": %llu, \"blocks\": %llu, \"reserved\": %llu },\n",
+                env_alloc_name(p->env_alloc), (unsigned long long)p->alloc_stats.envs, (unsigned long long)p->alloc_stats.allocs,
+                (unsigned long long)p->alloc_stats.bytes, (unsigned long long)p->alloc_stats.blocks,
+                (unsigned long long)p->alloc_stats.reserved);
+        fprintf(f, "  \"handles\": [");
+        for (int i = 0; i < nfp; i++) {
+            fprintf(f, "%s\n    { \"name\": \"%s\", \"count\": %d, \"bytes\": %.1f, \"allocs\": %.2f, \"frees\": %.2f, "
+                       "\"peak\": %.1f, \"rss\": %.1f, \"retained\": %.1f }",
+                    i ? "," : "", fps[i].name, fps[i].count, fps[i].bytes, fps[i].allocs, fps[i].frees,
+                    fps[i].peak, fps[i].rss, fps[i].retained);
+        }
+        fprintf(f, "\n  ]\n}\n");
+    } else {
+        fprintf(f, "handle,count,bytes,allocs,frees,peak,rss,retained\n");
+        for (int i = 0; i < nfp; i++)
+            fprintf(f, "%s,%d,%.1f,%.2f,%.2f,%.1f,%.1f,%.1f\n", fps[i].name, fps[i].count, fps[i].bytes,
+                    fps[i].allocs, fps[i].frees, fps[i].peak, fps[i].rss, fps[i].retained);
     }
 
-    // SET USERNAME (dbdcnx.c, L#368)
-    if (( status = OCIAttrSet(seshp, OCI_HTYPE_SESSION, (void*)schema, strlen(schema), OCI_ATTR_USERNAME, errhp)) != OCI_SUCCESS) {
-        snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to set username in session handle");
-        t_status->connection_status = status;
-        pthread_exit(NULL);
-    }
+    fclose(f);
+}
 
-    // SET PASSWORD (dbdcnx.c, L#379)
-    if (( status = OCIAttrSet(seshp, OCI_HTYPE_SESSION, (void*)passwd, strlen(passwd), OCI_ATTR_PASSWORD, errhp)) != OCI_SUCCESS) {
-        snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to set password in session handle");
-        t_status->connection_status = status;
-        pthread_exit(NULL);
-    }
+static void usage(const char* prog)
+{
+    fprintf(stderr, "Usage: %s [-n count] [-c] [-x] [-A none|malloc|arena|pool] [-o report.json|report.csv] [handle ...]\n", prog);
+    fprintf(stderr, "  -n count     handles of each type held at once (default %d)\n", DEFAULT_COUNT);
+    fprintf(stderr, "  -c           also profile attached servers and logged on sessions\n");
+    fprintf(stderr, "               (needs ORA_SCHEMA, ORA_PASSWD and ORA_DBNAME)\n");
+    fprintf(stderr, "  -x           hex dump the first 64 bytes of one handle of each type\n");
+    fprintf(stderr, "  -A alloc     memory callbacks for every environment: none (default), malloc (counted),\n");
+    fprintf(stderr, "               arena or pool - child handles then come out of the parent's allocator\n");
+    fprintf(stderr, "  -o file      also write the results as JSON (*.json) or CSV\n");
+    fprintf(stderr, "  handle       any of:");
+    for (int i = 0; i < PROBE_COUNT; i++)
+        fprintf(stderr, " %s", probes[i].name);
+    fprintf(stderr, "\n");
+}
 
-    // Connect to the database using OCISessionBegin (dbdcnx.c, L#405)
-    if (( status = OCISessionBegin(svchp, errhp, seshp, OCI_CRED_RDBMS, OCI_DEFAULT)) != OCI_SUCCESS) {
-        OCIErrorGet(errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
-        t_status->connection_status = status;
-        goto cleanup;
-    }
+int main(int argc, char* argv[]) {
+    int         count = DEFAULT_COUNT;
+    int         connected = 0;
+    int         dump = 0;
+    int         env_alloc = ENV_ALLOC_NONE;
+    const char* report_file = NULL;
+    int         selected[PROBE_COUNT] = { 0 };
+    int         any_selected = 0;
+    int         opt;
 
-    // Set the session handle in the service context (dbdcnx.c, L#410)
-    if (( status = OCIAttrSet(svchp, OCI_HTYPE_SVCCTX, seshp, 0, OCI_ATTR_SESSION, errhp)) != OCI_SUCCESS) {
-        snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to set session handle in service context");
-        t_status->connection_status = status;
-        pthread_exit(NULL);
+    // Parse command-line arguments
+    while ((opt = getopt(argc, argv, "n:cxA:o:")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = atoi(optarg);
+                if (count <= 0) {
+                    fprintf(stderr, "Invalid count: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'c':
+                connected = 1;
+                break;
+            case 'x':
+                dump = 1;
+                break;
+            case 'A':
+                if ((env_alloc = env_alloc_parse(optarg)) < 0) {
+                    fprintf(stderr, "Invalid allocator: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                report_file = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
     }
 
-    // status = OCILogon(envhp, errhp, &svchp, (OraText*)schema, strlen(schema),
-    //                   (OraText*)passwd, strlen(passwd),
-    //                   (OraText*)dbname, strlen(dbname));
-    // if (status != OCI_SUCCESS) {
-    //     OCIErrorGet(errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
-    //     t_status->connection_status = status;
-    //     goto cleanup;
-    // }
-    // t_status->connection_status = 0;
-
-    // Perform ping
-    status = OCIPing(svchp, errhp, OCI_DEFAULT);
-    if (status != OCI_SUCCESS) {
-        OCIErrorGet(errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
-        t_status->ping_status = status;
-        goto cleanup;
+    for (int a = optind; a < argc; a++) {
+        int i;
+        for (i = 0; i < PROBE_COUNT && strcmp(argv[a], probes[i].name) != 0; i++)
+            ;
+        if (i == PROBE_COUNT) {
+            fprintf(stderr, "Unknown handle type: %s\n", argv[a]);
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        selected[i] = 1;
+        any_selected = 1;
+        connected |= probes[i].connected;
     }
-    t_status->ping_status = 0;
 
-cleanup:
+    Parent p = { 0 };
+    p.schema = getenv("ORA_SCHEMA");
+    p.passwd = getenv("ORA_PASSWD");
+    p.dbname = getenv("ORA_DBNAME");
+    p.env_alloc = env_alloc;
 
-    // Disconnect and clean up using OCISessionEnd && OCIServerDetach
-    if (seshp && (status = OCISessionEnd(svchp, errhp, seshp, OCI_DEFAULT)) != OCI_SUCCESS) {
-        OCIErrorGet(errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
-        t_status->connection_status = status;
+    // Validate environment variables
+    if (connected && (!p.schema || !p.passwd || !p.dbname)) {
+        fprintf(stderr, "Error: ORA_SCHEMA, ORA_PASSWD, and ORA_DBNAME environment variables must be defined for -c.\n");
+        return EXIT_FAILURE;
     }
 
-    if (srvhp && (status = OCIServerDetach(srvhp, errhp, OCI_DEFAULT)) != OCI_SUCCESS) {
-        OCIErrorGet(errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
-        t_status->connection_status = status;
-    }
+    // The first environment pays for process wide setup (NLS data, thread
+    // keys, ...) - measure it separately so it does not skew env_default
+    MallocCount before, first;
+    OCIEnv*     env = NULL;
+    long        rss_before = rss_bytes();
 
-    // This PAIRS with OCILogon
-    // if (svchp && (status = OCILogoff(svchp, errhp)) != OCI_SUCCESS )
-    //     fprintf(stderr, "OCILogOff(svc,errhp) returned %d\n", status);
+    malloc_count_snapshot(&before);
+    if (OCIEnvNlsCreate(&env, OCI_THREADED, 0, NULL, NULL, NULL, 0, NULL, 0, 0) != OCI_SUCCESS) {
+        fprintf(stderr, "Failed to initialize OCI environment\n");
+        return EXIT_FAILURE;
+    }
+    OCIHandleFree(env, OCI_HTYPE_ENV);
+    malloc_count_snapshot(&first);
+    first.live   -= before.live;
+    first.allocs -= before.allocs;
+    printf(" INFO: First OCIEnvNlsCreate: %llu allocations, %lld bytes still held after free, RSS +%ld KiB\n",
+           (unsigned long long)first.allocs, (long long)first.live, (rss_bytes() - rss_before) / 1024);
+
+    // Parent for the child handles, set up as db-thread does
+    p.alloc = env_alloc_create(env_alloc);
+    if (OCIEnvNlsCreate(&p.envhp, OCI_THREADED, ENV_ALLOC_CALLBACKS(p.alloc), 0, NULL, 0, 0) != OCI_SUCCESS
+     || OCIHandleAlloc(p.envhp, (void**)&p.errhp, OCI_HTYPE_ERROR, 0, NULL) != OCI_SUCCESS) {
+        fprintf(stderr, "Failed to initialize parent OCI environment\n");
+        return EXIT_FAILURE;
+    }
 
-    if (seshp && (status = OCIHandleFree(seshp, OCI_HTYPE_SESSION)) != OCI_SUCCESS )
-        fprintf(stderr, "OCIHandleFree(seshp, OCI_HTYPE_SESSION) returned %d\n", status);
-    if (errhp && (status = OCIHandleFree(errhp, OCI_HTYPE_ERROR)) != OCI_SUCCESS )
-        fprintf(stderr, "OCIHandleFree(errhp, OCI_HTYPE_ERROR) returned %d\n", status);
-    if (envhp && (status = OCIHandleFree(envhp, OCI_HTYPE_ENV)) != OCI_SUCCESS )
-        fprintf(stderr, "OCIHandleFree(envhp, OCI_HTYPE_ENV) returned %d\n", status);
-    if (mng_env && (status = OCIHandleFree(mng_env, OCI_HTYPE_ENV)) != OCI_SUCCESS )
-        fprintf(stderr, "OCIHandleFree(mng_env, OCI_HTYPE_ENV) returned %d\n", status);
+    Sample*    samples = calloc(count, sizeof(Sample));
+    Footprint* fps = calloc(PROBE_COUNT, sizeof(Footprint));
+    int        nfp = 0;
 
-    pthread_exit(NULL);
-}
-*/
+    if (!samples || !fps) {
+        perror("Failed to allocate memory");
+        return EXIT_FAILURE;
+    }
 
-int main(int argc, char* argv[]) {
-    int opt;
+    for (int i = 0; i < PROBE_COUNT; i++) {
+        if (any_selected ? !selected[i] : (probes[i].connected && !connected))
+            continue;
 
-    // Parse command-line arguments
-/*
-    while ((opt = getopt(argc, argv, "t:")) != -1) {
-        switch (opt) {
-            case 't':
-                num_threads = atoi(optarg);
-                if (num_threads <= 0) {
-                    fprintf(stderr, "Invalid number of threads: %s\n", optarg);
-                    return EXIT_FAILURE;
-                }
-                break;
-            default:
-                fprintf(stderr, "Usage: %s [-t threads]\n", argv[0]);
-                return EXIT_FAILURE;
-        }
+        // One unmeasured round first so lazily built per-type state is not
+        // charged to the samples
+        Footprint warm;
+        probe_run(&probes[i], &p, samples, 1, 0, &warm);
+        probe_run(&probes[i], &p, samples, count, dump, &fps[nfp]);
+        nfp++;
     }
-*/
 
-    // Validate environment variables
-//  const char* schema = getenv("ORA_SCHEMA");
-//  const char* passwd = getenv("ORA_PASSWD");
-//  const char* dbname = getenv("ORA_DBNAME");
-
-//  if (!schema || !passwd || !dbname) {
-//      fprintf(stderr, "Error: ORA_SCHEMA, ORA_PASSWD, and ORA_DBNAME environment variables must be defined.\n");
-//      return EXIT_FAILURE;
-//  }
-
-//  pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
-//  ThreadStatus* statuses = malloc(num_threads * sizeof(ThreadStatus));
-
-//  if (!threads || !statuses) {
-//      perror("Failed to allocate memory");
-//      free(threads);
-//      free(statuses);
-//      return EXIT_FAILURE;
-//  }
-
-    db_eng_size();
+    printf("\n %-16s %6s %12s %8s %8s %12s %12s %10s\n",
+           "HANDLE", "COUNT", "BYTES", "ALLOCS", "FREES", "PEAK", "RSS", "RETAINED");
+    for (int i = 0; i < nfp; i++) {
+        printf(" %-16s %6d %12.1f %8.2f %8.2f %12.1f %12.1f %10.1f\n", fps[i].name, fps[i].count,
+               fps[i].bytes, fps[i].allocs, fps[i].frees, fps[i].peak, fps[i].rss, fps[i].retained);
+        if (fps[i].count < count)
+            printf("   %s stopped after %d: %s\n", fps[i].name, fps[i].count, fps[i].error);
+    }
+    printf(" (per handle: heap bytes held, malloc calls to create, free calls to release,\n"
+           "  transient heap high-water, RSS growth, heap bytes still held after release)\n\n");
+
+    free(samples);
+    OCIHandleFree(p.errhp, OCI_HTYPE_ERROR);
+    OCIHandleFree(p.envhp, OCI_HTYPE_ENV);
+    env_alloc_destroy(p.alloc, &p.alloc_stats);
+
+    if (p.alloc_stats.envs > 0)
+        printf(" INFO: Env allocator %s: %llu environments, %.1f callbacks and %.1f malloc calls per env, %.0f bytes reserved per env\n\n",
+               env_alloc_name(env_alloc), (unsigned long long)p.alloc_stats.envs,
+               (double)p.alloc_stats.allocs / p.alloc_stats.envs, (double)p.alloc_stats.blocks / p.alloc_stats.envs,
+               (double)p.alloc_stats.reserved / p.alloc_stats.envs);
+
+    if (report_file)
+        write_report(report_file, count, &first, &p, fps, nfp);
+    free(fps);
 
     return EXIT_SUCCESS;
 }
@@ -1,118 +1,590 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <time.h>
 #include <pthread.h>
 #include <oci.h>
 #include <unistd.h> // For getopt
+#include <errno.h>
+#include <math.h>
+#include "env-alloc.h"
+#include "live-stats.h"
+#include "export-map.h"
+#include "sig-route.h"
+#include "malloc-count.h"
+#include "mem-track.h"
 
-// Structure to hold thread status
+#define DEFAULT_LOOPS 32
+#define SOAK_LEAK     32        // -M: bytes of growth per connect cycle flagged as a leak
+
+// Log-bucketed latency histogram (nanoseconds): values below HIST_SUB are
+// exact, above that each power of two is split into HIST_SUB buckets
+#define HIST_SUB_BITS   4
+#define HIST_SUB        (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS   40          // ~18 minutes, larger values land in the last bucket
+#define HIST_BUCKETS    ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[HIST_BUCKETS];
+} Histogram;
+
+// Phases of the connect lifecycle timed by db_thread_function()
+typedef enum {
+    PH_ENV_MNG,         // OCIEnvNlsCreate(OCI_DEFAULT)
+    PH_ENV,             // OCIEnvNlsCreate(OCI_THREADED)
+    PH_ALLOC_ERROR,     // OCIHandleAlloc(OCI_HTYPE_ERROR)
+    PH_ALLOC_SERVER,    // OCIHandleAlloc(OCI_HTYPE_SERVER)
+    PH_ALLOC_SVCCTX,    // OCIHandleAlloc(OCI_HTYPE_SVCCTX)
+    PH_ALLOC_SESSION,   // OCIHandleAlloc(OCI_HTYPE_SESSION)
+    PH_ATTACH,          // OCIServerAttach
+    PH_SESSION_BEGIN,   // OCISessionBegin
+    PH_PING,            // OCIPing
+    PH_SESSION_END,     // OCISessionEnd
+    PH_DETACH,          // OCIServerDetach
+    PH_FREE,            // OCIHandleFree (all handles)
+    PH_SESSION_GET,     // OCISessionGet from the session pool
+    PH_SESSION_RELEASE, // OCISessionRelease back to the session pool
+    PH_SELECT,          // OCIStmtExecute(SELECT 1 FROM DUAL)
+    PH_CONNECT,         // db_connect() as a whole, successful connects only
+    PH_CYCLE,           // the whole cycle
+    PH_QUEUE,           // -r: intended start to actual start
+    PH_RESPONSE,        // -r: intended start to completion (coordinated omission corrected)
+    PH_ALL_CONNECTED,   // -R: loop start to the last thread logged in, once per loop
+    PH_STMT_PREPARE,    // -W stmt: OCIStmtPrepare2, a statement cache hit or a fresh parse
+    PH_STMT_EXECUTE,    // -W stmt: OCIStmtExecute, with the first prefetch batch or the DML array
+    PH_STMT_FETCH,      // -W stmt: OCIStmtFetch2 of one define array
+    PH_STATEMENT,       // -W stmt: one statement of the mix from prepare to release
+    PH_EXPORT,          // -W export: execute to the output file closed
+    PH_COUNT
+} Phase;
+
+static const char* phase_names[PH_COUNT] = {
+    "env_create_mng", "env_create", "alloc_error", "alloc_server",
+    "alloc_svcctx", "alloc_session", "server_attach", "session_begin",
+    "ping", "session_end", "server_detach", "handle_free", "session_get",
+    "session_release", "select", "connect", "cycle", "queue_wait", "response",
+    "all_connected", "stmt_prepare", "stmt_execute", "stmt_fetch", "statement",
+    "export"
+};
+
+// Environments behind a dedicated connection (-e)
+typedef enum {
+    TOPO_TWO,           // OCI_DEFAULT mng_env + OCI_THREADED envhp per connection, as DBD::Oracle
+    TOPO_ONE,           // OCI_THREADED envhp per connection
+    TOPO_SHARED,        // one process-wide OCI_THREADED env for every connection
+    TOPO_COUNT
+} EnvTopology;
+
+static const char* topology_names[TOPO_COUNT] = { "two", "one", "shared" };
+
+// Connect pacing profiles (-R)
+typedef enum {
+    RAMP_BURST,         // no pacing: every thread connects at once (counted only)
+    RAMP_BUCKET,        // token bucket refilled at a constant rate
+    RAMP_LINEAR,        // refill rate grows by rate every step seconds
+    RAMP_EXP,           // refill rate doubles every step seconds
+    RAMP_COUNT
+} RampProfile;
+
+static const char* ramp_names[RAMP_COUNT] = { "burst", "bucket", "linear", "exp" };
+
+// One -R setting, e.g. linear,rate=20,burst=4,step=0.5,retries=3,backoff=50
+typedef struct {
+    const char* spec;           // as given, for the report
+    RampProfile profile;
+    double      rate;           // tokens per second at the start of a loop
+    double      burst;          // bucket depth, also the tokens available at the start
+    double      step;           // seconds, linear/exp growth period
+    int         retries;        // further attempts after a failed connect
+    double      backoff;        // msec, first backoff ceiling (full jitter, doubling)
+} RampSpec;
+
+// One statement of the -W stmt mix
+typedef struct {
+    int         weight;         // runs this many times per pass over the mix
+    char*       sql;
+    int         is_query;       // SELECT/WITH: array fetch, anything else: array DML
+    int         binds;          // :N placeholders, bound as arrays
+} SqlStmt;
+
+typedef struct {
+    SqlStmt*    stmts;
+    int         count;
+    int         total;          // sum of the weights
+} SqlMix;
+
+// One -Q setting, e.g. cache=20,prefetch=100,prefmem=0,array=50
+typedef struct {
+    const char* spec;           // as given, for the report
+    ub4         cache;          // OCI_ATTR_STMTCACHESIZE, 0 = no statement cache
+    ub4         prefetch;       // OCI_ATTR_PREFETCH_ROWS
+    ub4         prefmem;        // OCI_ATTR_PREFETCH_MEMORY, bytes
+    ub4         array;          // rows per define/bind array
+} StmtSpec;
+
+// -F path[,layout=prefixed|columnar][,width=N]
+typedef struct {
+    const char*  spec;          // as given, for the report
+    char*        path;          // one file per thread: path.N when there are several
+    ExportLayout layout;
+    ub4          width;         // columnar slot bytes, also the define size
+} ExportSpec;
+
+// -K mode[,rate=N]
+typedef struct {
+    const char* spec;           // as given, for the report
+    SigMode     mode;
+    double      rate;           // signals injected per second, 0 = none
+} SigSpec;
+
+// -D name[,weight=N]: one database of a multi-target run
+typedef struct {
+    const char* spec;           // as given, for the report
+    char*       dbname;         // connect string for OCIServerAttach and the session pool
+    double      weight;         // share of the -t slots (default 1)
+} TargetSpec;
+
+// Token bucket shared by every thread of a run, reset at the start of each loop
+typedef struct {
+    const RampSpec* spec;
+    pthread_mutex_t lock;
+    uint64_t        started;    // now_ns() the loop started
+    uint64_t        refilled;   // now_ns() tokens were last topped up
+    double          tokens;
+    uint64_t        last_connected;
+    long            connected;  // this loop
+    long            attempts;   // whole run
+    long            failed_attempts;
+    long            gave_up;    // threads that ran out of retries
+} Ramp;
+
+// Per connection slot timings and env allocator counters, merged once the run is over
+typedef struct {
+    Histogram     phase[PH_COUNT];
+    EnvAllocStats alloc;
+} PhaseStats;
+
+// The slots of one -D target, totalled after the run
+typedef struct {
+    const TargetSpec* spec;
+    int         threads;        // slots assigned to it
+    long        cycles;
+    long        failed;
+    long        ops;            // -W ping/select round trips, -W stmt statements
+    PhaseStats  stats;
+} TargetStats;
+
+// One process-wide OCI_THREADED environment and session pool (-m pool)
+typedef struct {
+    OCIEnv*      envhp;
+    OCIError*    errhp;
+    OCISPool*    spoolhp;
+    OCIAuthInfo* authp;
+    OraText*     name;          // pool name returned by OCISessionPoolCreate
+    ub4          name_len;
+    ub4          min;
+    ub4          max;
+    ub4          incr;
+    EnvAlloc*    alloc;         // -A: allocator behind envhp
+} SessionPool;
+
+// Handles of one connection, dedicated or borrowed from the session pool
+typedef struct {
+    OCIEnv*     mng_env;    // OCI environment handle (OCIEnvNlsCreate)
+    OCIEnv*     envhp;      // OCI environment handle (OCIEnvNlsCreate)
+    OCIError*   errhp;      // OCI error handle
+    OCIServer*  srvhp;      // OCI server handle
+    OCISvcCtx*  svchp;      // OCI service context handle
+    OCISession* seshp;      // OCI session handle
+    EnvAlloc*   mng_alloc;  // -A: allocators behind mng_env and envhp
+    EnvAlloc*   alloc;
+    int         attached;
+    int         logged_on;
+    int         shared_env; // envhp belongs to the process (-e shared)
+    int         borrowed;   // svchp came from OCISessionGet
+    int         broken;     // a call on the session failed
+} Connection;
+
+// Structure to hold thread status; cache line aligned so the hot fields of
+// neighbouring threads never share a line
 typedef struct {
     int connection_status;
     int ping_status;
     char error_message[512];
-} ThreadStatus;
+    PhaseStats* stats;
+    SessionPool* pool;          // NULL for dedicated sessions
+    const TargetSpec* target;   // -D database this slot connects to
+    uint64_t deadline;          // -W ping/select: stop at this now_ns()
+    int use_select;             // -W select
+    long ops;                   // -W ping/select: completed round trips, -W stmt: statements
+    EnvAllocKind env_alloc;     // -A: memory callbacks for the dedicated environments
+    EnvTopology topology;       // -e
+    OCIEnv* shared_env;         // -e shared: the process-wide environment
+    Ramp* ramp;                 // -R: connect pacing, NULL = connect straight away
+    LiveSlot* live;             // -i: this slot's live counters, NULL = report after the join only
+    const StmtSpec* stmt;       // -W stmt: cache, prefetch and array settings, NULL otherwise
+    const SqlMix* mix;          // -W stmt: statements to run
+    long rows;                  // -W stmt: rows fetched or affected
+    long round_trips;           // -W stmt: SQL*Net round trips of the statements, -1 = unknown
+    const ExportSpec* export;   // -W export: output file, NULL otherwise
+    int slot;                   // index of this status in the run
+    int threads;                // slots in the run
+    ExportMapStats exported;    // -W export
+} __attribute__((aligned(LIVE_CACHE_LINE))) ThreadStatus;
 
-// Thread function
-void* db_thread_function(void* arg)
+// Totals printed at the end of a run
+typedef struct {
+    const char* mode;
+    const char* sessions;
+    int         threads;
+    int         loops;
+    long        cycles;
+    long        failed;
+    double      elapsed;
+    const char* workload;   // cycle, ping or select
+    const char* env_alloc;  // -A allocator name
+    const char* topology;   // -e environments per connection
+    long        envs;       // OCIEnvNlsCreate calls made for the run
+    long        rss_start;  // bytes, before the run
+    long        rss_peak;   // bytes, VmHWM at the end of the run
+    long        vm_start;   // bytes, VmSize before the run
+    long        vm_peak;    // bytes, VmPeak - process lifetime, it cannot be reset
+    long        held_max;   // most sessions logged on at once
+    int         os_threads; // threads that drove the connections
+    double      rate;       // -r ops/sec requested, 0 = closed loop
+    long        issued;     // -r operations released on schedule
+    double      window;     // -r seconds over which they were released
+    long        backlog_max; // -r most operations waiting for a worker at once
+    const char* ramp;       // -R setting, NULL without pacing
+    long        attempts;   // -R connect attempts, retries included
+    long        failed_attempts;
+    long        gave_up;    // -R threads that exhausted their retries
+    long        ops;        // -W ping/select round trips, all threads
+    long        ops_min;    // fewest round trips by one thread
+    long        ops_max;
+    double      fairness;   // Jain's index over per-thread round trips, 1 = even
+    const char* stmt;       // -Q setting, NULL unless -W stmt
+    long        rows;       // -W stmt rows fetched or affected
+    long        round_trips; // -W stmt SQL*Net round trips, -1 if v$mystat was not readable
+    const char* export;     // -F setting, NULL unless -W export
+    long        bytes;      // -W export bytes written, all files
+    long        truncated;  // -W export columnar values cut to the slot width
+    double      export_time; // -W export seconds from execute to file closed, summed over threads
+    const char* signals;    // -K setting, NULL without signal routing
+    long        sig_sent;   // -K signals injected
+    long        sig_refused; // -K sigqueue() failures, the pending queue was full
+    long        sig_handled;
+    long        sig_elsewhere; // -K handlers run off the main thread
+    double      sig_p50;    // usec from sigqueue() to the handler
+    double      sig_p99;
+    double      sig_max;
+    const char* soak;       // -M setting, NULL without memory tracking
+    MemTrend    trend;      // -M growth per connect cycle
+    const TargetStats* targets; // -D per database totals of the last run, NULL with one target
+    int         num_targets;
+} RunSummary;
+
+// Command line settings, shared by every run of a -t sweep
+typedef struct {
+    int         num_loops;
+    double      duration;
+    int         use_pool;       // -w
+    double      rate;           // -r open loop arrivals per second, 0 = closed loop
+    int         quiet;
+    int         session_pool;   // -m pool
+    ub4         pool_min;       // -n
+    ub4         pool_max;
+    ub4         pool_incr;
+    const char* workload;       // -W
+    int         steady;
+    EnvAllocKind env_alloc;     // -A
+    EnvTopology topology;       // -e
+    const RampSpec* ramp;       // -R
+    double      live_interval;  // -i seconds, 0 = no live reporter
+    int         ev_loops;       // -L non-blocking event loop threads, 0 = thread per connection
+    const StmtSpec* stmt;       // -Q, -W stmt only
+    const SqlMix* mix;          // -S
+    const ExportSpec* export;   // -F, -W export only
+    const SigSpec* signals;     // -K
+    const MemSpec* soak;        // -M, -W cycle closed loop only
+    const TargetSpec* targets;  // -D, default one target from ORA_DBNAME
+    int         num_targets;
+    const char* schema;
+    const char* passwd;
+} Config;
+
+// Shared job queue feeding the persistent worker pool (-w)
+typedef struct {
+    void*         (*job)(void*); // thread function run for each job
+    pthread_mutex_t lock;
+    pthread_cond_t  ready;      // a job was queued or the pool is shutting down
+    pthread_cond_t  idle;       // the last outstanding job completed
+    ThreadStatus**  jobs;       // ring of queued jobs
+    int             capacity;
+    int             head;
+    int             count;      // queued
+    int             pending;    // queued + running
+    int             shutdown;
+} JobQueue;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int hist_bucket(uint64_t v)
+{
+    int msb;
+
+    if (v < HIST_SUB)
+        return (int)v;
+    msb = 63 - __builtin_clzll(v);
+    if (msb >= HIST_MAX_BITS)
+        return HIST_BUCKETS - 1;
+    return (msb - HIST_SUB_BITS + 1) * HIST_SUB + (int)((v >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+// Midpoint of the values that fall into bucket b
+static uint64_t hist_value(int b)
+{
+    int      g = b / HIST_SUB;
+    uint64_t width;
+
+    if (g == 0)
+        return (uint64_t)b;
+    width = 1ull << (g - 1);
+    return ((uint64_t)(HIST_SUB + b % HIST_SUB) << (g - 1)) + width / 2;
+}
+
+void hist_record(Histogram* h, uint64_t v)
+{
+    if (h->count == 0 || v < h->min)
+        h->min = v;
+    if (v > h->max)
+        h->max = v;
+    h->count++;
+    h->sum += v;
+    h->buckets[hist_bucket(v)]++;
+}
+
+void hist_merge(Histogram* into, const Histogram* from)
+{
+    if (from->count == 0)
+        return;
+    if (into->count == 0 || from->min < into->min)
+        into->min = from->min;
+    if (from->max > into->max)
+        into->max = from->max;
+    into->count += from->count;
+    into->sum   += from->sum;
+    for (int b = 0; b < HIST_BUCKETS; b++)
+        into->buckets[b] += from->buckets[b];
+}
+
+// Value at quantile q (0..1), accurate to within half a bucket
+uint64_t hist_percentile(const Histogram* h, double q)
+{
+    uint64_t rank, seen = 0;
+
+    if (h->count == 0)
+        return 0;
+    rank = (uint64_t)(q * h->count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank >= h->count)
+        return h->max;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen >= rank) {
+            uint64_t v = hist_value(b);
+            return v < h->min ? h->min : v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+// Time one OCI call into the given phase of the slot's histograms
+#define TIMED(ts, ph, call) ({                                  \
+        uint64_t t0_ = now_ns();                                \
+        sword    s_  = (call);                                  \
+        hist_record(&(ts)->stats->phase[ph], now_ns() - t0_);   \
+        s_;                                                     \
+    })
+
+// Sessions logged on right now, process wide, and the most at any one time
+static long sessions_held;
+static long sessions_held_max;
+
+static void sessions_held_add(long delta)
+{
+    long held = __atomic_add_fetch(&sessions_held, delta, __ATOMIC_RELAXED);
+    long max  = __atomic_load_n(&sessions_held_max, __ATOMIC_RELAXED);
+
+    while (held > max && !__atomic_compare_exchange_n(&sessions_held_max, &max, held, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+// Dedicated connection up to, not including, OCISessionBegin: environments,
+// handles, server attach and credentials.  -1 on failure; db_disconnect()
+// tears down whatever was set up.
+int db_attach(ThreadStatus* t_status, Connection* conn)
 {
-    ThreadStatus* t_status = (ThreadStatus*)arg;
-    OCIEnv*     mng_env = NULL; // OCI environment handle (OCIEnvNlsCreate)
-    OCIEnv*     envhp   = NULL; // OCI environment handle (OCIEnvNlsCreate)
-    OCIError*   errhp   = NULL; // OCI error handle
-    OCIServer*  srvhp   = NULL; // OCI server handle
-    OCISvcCtx*  svchp   = NULL; // OCI service context handle
-    OCISession* seshp   = NULL; // OCI session handle
     sword status;
 
-    // Get credentials from environment variables
+    // Get credentials from environment variables, the database from -D
     const char* schema = getenv("ORA_SCHEMA");
     const char* passwd = getenv("ORA_PASSWD");
-    const char* dbname = getenv("ORA_DBNAME");
+    const char* dbname = t_status->target->dbname;
+
+    memset(conn, 0, sizeof(*conn));
 
 //  if (OCIEnvCreate(&env, OCI_THREADED, NULL, NULL, NULL, NULL, 0, NULL) != OCI_SUCCESS) {
 
-    // Initialize OCI environment - mimic what is seen in DBD::Oracle ->> OCI_DEFAULT
-    if (( status = OCIEnvNlsCreate(&mng_env, OCI_DEFAULT, 0, NULL, NULL, NULL, 0, NULL, 0, 0)) != OCI_SUCCESS) {
-        snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to initialize OCI (mng_env) environment");
-        t_status->connection_status = status;
-        pthread_exit(NULL);
-    }
+    if (t_status->topology == TOPO_SHARED) {
+        // Every connection hangs its handles off the one process-wide environment
+        conn->envhp = t_status->shared_env;
+        conn->shared_env = 1;
+    } else {
+        // Each environment gets its own allocator (-A); NULL keeps OCI's default heap
+        if (t_status->topology == TOPO_TWO)
+            conn->mng_alloc = env_alloc_create(t_status->env_alloc);
+        conn->alloc = env_alloc_create(t_status->env_alloc);
 
-    // DBD::Oracle uses this function. Works here OK ->> OCI_THREADED
-    if (( status = OCIEnvNlsCreate(&envhp, OCI_THREADED, 0, NULL, NULL, NULL, 0, NULL, 0, 0)) != OCI_SUCCESS) {
-        snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to initialize OCI environment");
-        t_status->connection_status = status;
-        pthread_exit(NULL);
+        // Initialize OCI environment - mimic what is seen in DBD::Oracle ->> OCI_DEFAULT
+        if (t_status->topology == TOPO_TWO &&
+            ( status = TIMED(t_status, PH_ENV_MNG, OCIEnvNlsCreate(&conn->mng_env, OCI_DEFAULT, ENV_ALLOC_CALLBACKS(conn->mng_alloc), 0, NULL, 0, 0))) != OCI_SUCCESS) {
+            snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to initialize OCI (mng_env) environment");
+            t_status->connection_status = status;
+            return -1;
+        }
+
+        // DBD::Oracle uses this function. Works here OK ->> OCI_THREADED
+        if (( status = TIMED(t_status, PH_ENV, OCIEnvNlsCreate(&conn->envhp, OCI_THREADED, ENV_ALLOC_CALLBACKS(conn->alloc), 0, NULL, 0, 0))) != OCI_SUCCESS) {
+            snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to initialize OCI environment");
+            t_status->connection_status = status;
+            return -1;
+        }
     }
 
     // Allocate error handle
-    if (( status = OCIHandleAlloc(envhp, (void**)&errhp, OCI_HTYPE_ERROR, 0, NULL)) != OCI_SUCCESS) {
+    if (( status = TIMED(t_status, PH_ALLOC_ERROR, OCIHandleAlloc(conn->envhp, (void**)&conn->errhp, OCI_HTYPE_ERROR, 0, NULL))) != OCI_SUCCESS) {
         snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to allocate OCI error handle");
         t_status->connection_status = status;
-        pthread_exit(NULL);
+        return -1;
     }
 
     // Allocate server handle
-    if (( status = OCIHandleAlloc(envhp, (void**)&srvhp, OCI_HTYPE_SERVER, 0, NULL)) != OCI_SUCCESS) {
+    if (( status = TIMED(t_status, PH_ALLOC_SERVER, OCIHandleAlloc(conn->envhp, (void**)&conn->srvhp, OCI_HTYPE_SERVER, 0, NULL))) != OCI_SUCCESS) {
         snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to allocate OCI server handle");
         t_status->connection_status = status;
-        pthread_exit(NULL);
+        return -1;
     }
 
     // CTX: Allocate service context handle
-    if (( status = OCIHandleAlloc(envhp, (void**)&svchp, OCI_HTYPE_SVCCTX, 0, NULL)) != OCI_SUCCESS) {
+    if (( status = TIMED(t_status, PH_ALLOC_SVCCTX, OCIHandleAlloc(conn->envhp, (void**)&conn->svchp, OCI_HTYPE_SVCCTX, 0, NULL))) != OCI_SUCCESS) {
         snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to allocate OCI service handle");
         t_status->connection_status = status;
-        pthread_exit(NULL);
+        return -1;
     }
 
     // Allocate session handle (dbdcnx.c, #339)
-    if (( status = OCIHandleAlloc(envhp, (void**)&seshp, OCI_HTYPE_SESSION, 0, NULL)) != OCI_SUCCESS) {
+    if (( status = TIMED(t_status, PH_ALLOC_SESSION, OCIHandleAlloc(conn->envhp, (void**)&conn->seshp, OCI_HTYPE_SESSION, 0, NULL))) != OCI_SUCCESS) {
         snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to allocate OCI session handle");
         t_status->connection_status = status;
-        pthread_exit(NULL);
+        return -1;
     }
 
     // Attach to the server (dbdcnx.c, :#346)
-    if (( status = OCIServerAttach(srvhp, errhp, (OraText*)dbname, strlen(dbname), OCI_DEFAULT)) != OCI_SUCCESS) {
-        OCIErrorGet(errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
+    if (( status = TIMED(t_status, PH_ATTACH, OCIServerAttach(conn->srvhp, conn->errhp, (OraText*)dbname, strlen(dbname), OCI_DEFAULT))) != OCI_SUCCESS) {
+        OCIErrorGet(conn->errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
         t_status->connection_status = -1;
-        goto cleanup;
+        return -1;
     }
+    conn->attached = 1;
 
     // Set the server handle in the service context (dbdcnx.c, L#353)
-    if (( status = OCIAttrSet(svchp, OCI_HTYPE_SVCCTX, srvhp, 0, OCI_ATTR_SERVER, errhp)) != OCI_SUCCESS) {
+    if (( status = OCIAttrSet(conn->svchp, OCI_HTYPE_SVCCTX, conn->srvhp, 0, OCI_ATTR_SERVER, conn->errhp)) != OCI_SUCCESS) {
         snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to set server handle in service context");
         t_status->connection_status = status;
-        pthread_exit(NULL);
+        return -1;
     }
 
     // SET USERNAME (dbdcnx.c, L#368)
-    if (( status = OCIAttrSet(seshp, OCI_HTYPE_SESSION, (void*)schema, strlen(schema), OCI_ATTR_USERNAME, errhp)) != OCI_SUCCESS) {
+    if (( status = OCIAttrSet(conn->seshp, OCI_HTYPE_SESSION, (void*)schema, strlen(schema), OCI_ATTR_USERNAME, conn->errhp)) != OCI_SUCCESS) {
         snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to set username in session handle");
         t_status->connection_status = status;
-        pthread_exit(NULL);
+        return -1;
     }
 
     // SET PASSWORD (dbdcnx.c, L#379)
-    if (( status = OCIAttrSet(seshp, OCI_HTYPE_SESSION, (void*)passwd, strlen(passwd), OCI_ATTR_PASSWORD, errhp)) != OCI_SUCCESS) {
+    if (( status = OCIAttrSet(conn->seshp, OCI_HTYPE_SESSION, (void*)passwd, strlen(passwd), OCI_ATTR_PASSWORD, conn->errhp)) != OCI_SUCCESS) {
         snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to set password in session handle");
         t_status->connection_status = status;
-        pthread_exit(NULL);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Log in on a dedicated server/session pair, or borrow a session from the
+// shared pool (-m pool).  Whatever was set up is torn down by db_disconnect(),
+// which must be called whether or not this succeeded.
+int db_connect(ThreadStatus* t_status, Connection* conn)
+{
+    uint64_t started = now_ns();
+    sword status;
+
+    memset(conn, 0, sizeof(*conn));
+
+    if (t_status->pool) {
+        SessionPool* pool = t_status->pool;
+
+        // Allocate error handle (from the shared environment)
+        if (( status = TIMED(t_status, PH_ALLOC_ERROR, OCIHandleAlloc(pool->envhp, (void**)&conn->errhp, OCI_HTYPE_ERROR, 0, NULL))) != OCI_SUCCESS) {
+            snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to allocate OCI error handle");
+            t_status->connection_status = status;
+            return -1;
+        }
+
+        // Borrow a session - the pool only logs in when it has to grow
+        if (( status = TIMED(t_status, PH_SESSION_GET, OCISessionGet(pool->envhp, conn->errhp, &conn->svchp, pool->authp, pool->name, pool->name_len,
+                                                                     NULL, 0, NULL, NULL, NULL, OCI_SESSGET_SPOOL))) != OCI_SUCCESS) {
+            OCIErrorGet(conn->errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
+            t_status->connection_status = status;
+            conn->svchp = NULL;
+            return -1;
+        }
+        conn->borrowed = 1;
+        sessions_held_add(1);
+        hist_record(&t_status->stats->phase[PH_CONNECT], now_ns() - started);
+        return 0;
     }
 
+    if (db_attach(t_status, conn) != 0)
+        return -1;
+
     // Connect to the database using OCISessionBegin (dbdcnx.c, L#405)
-    if (( status = OCISessionBegin(svchp, errhp, seshp, OCI_CRED_RDBMS, OCI_DEFAULT)) != OCI_SUCCESS) {
-        OCIErrorGet(errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
+    if (( status = TIMED(t_status, PH_SESSION_BEGIN, OCISessionBegin(conn->svchp, conn->errhp, conn->seshp, OCI_CRED_RDBMS, OCI_DEFAULT))) != OCI_SUCCESS) {
+        OCIErrorGet(conn->errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
         t_status->connection_status = status;
-        goto cleanup;
+        return -1;
     }
+    conn->logged_on = 1;
+    sessions_held_add(1);
 
     // Set the session handle in the service context (dbdcnx.c, L#410)
-    if (( status = OCIAttrSet(svchp, OCI_HTYPE_SVCCTX, seshp, 0, OCI_ATTR_SESSION, errhp)) != OCI_SUCCESS) {
+    if (( status = OCIAttrSet(conn->svchp, OCI_HTYPE_SVCCTX, conn->seshp, 0, OCI_ATTR_SESSION, conn->errhp)) != OCI_SUCCESS) {
         snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to set session handle in service context");
         t_status->connection_status = status;
-        pthread_exit(NULL);
+        return -1;
     }
 
     // status = OCILogon(envhp, errhp, &svchp, (OraText*)schema, strlen(schema),
@@ -125,25 +597,40 @@ void* db_thread_function(void* arg)
     // }
     // t_status->connection_status = 0;
 
-    // Perform ping
-    status = OCIPing(svchp, errhp, OCI_DEFAULT);
-    if (status != OCI_SUCCESS) {
-        OCIErrorGet(errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
-        t_status->ping_status = status;
-        goto cleanup;
-    }
-    t_status->ping_status = 0;
+    hist_record(&t_status->stats->phase[PH_CONNECT], now_ns() - started);
+    return 0;
+}
 
-cleanup:
+// Undo db_connect(): end/detach what was established (so a failed attach
+// keeps its own message) or hand a borrowed session back, then free handles
+void db_disconnect(ThreadStatus* t_status, Connection* conn)
+{
+    uint64_t t0;
+    sword status;
+
+    if (conn->borrowed || conn->logged_on)
+        sessions_held_add(-1);
+
+    if (conn->borrowed) {
+        // A session whose last call failed is dropped, not handed to the next worker
+        ub4 release = conn->broken ? OCI_SESSRLS_DROP : OCI_DEFAULT;
+
+        if (( status = TIMED(t_status, PH_SESSION_RELEASE, OCISessionRelease(conn->svchp, conn->errhp, NULL, 0, release))) != OCI_SUCCESS) {
+            OCIErrorGet(conn->errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
+            t_status->connection_status = status;
+        }
+        conn->borrowed = 0;
+        conn->svchp = NULL;
+    }
 
     // Disconnect and clean up using OCISessionEnd && OCIServerDetach
-    if (seshp && (status = OCISessionEnd(svchp, errhp, seshp, OCI_DEFAULT)) != OCI_SUCCESS) {
-        OCIErrorGet(errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
+    if (conn->logged_on && (status = TIMED(t_status, PH_SESSION_END, OCISessionEnd(conn->svchp, conn->errhp, conn->seshp, OCI_DEFAULT))) != OCI_SUCCESS) {
+        OCIErrorGet(conn->errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
         t_status->connection_status = status;
     }
 
-    if (srvhp && (status = OCIServerDetach(srvhp, errhp, OCI_DEFAULT)) != OCI_SUCCESS) {
-        OCIErrorGet(errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
+    if (conn->attached && (status = TIMED(t_status, PH_DETACH, OCIServerDetach(conn->srvhp, conn->errhp, OCI_DEFAULT))) != OCI_SUCCESS) {
+        OCIErrorGet(conn->errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
         t_status->connection_status = status;
     }
 
@@ -151,87 +638,2768 @@ cleanup:
     // if (svchp && (status = OCILogoff(svchp, errhp)) != OCI_SUCCESS )
     //     fprintf(stderr, "OCILogOff(svc,errhp) returned %d\n", status);
 
-    if (seshp && (status = OCIHandleFree(seshp, OCI_HTYPE_SESSION)) != OCI_SUCCESS )
+    t0 = now_ns();
+    if (conn->seshp && (status = OCIHandleFree(conn->seshp, OCI_HTYPE_SESSION)) != OCI_SUCCESS )
         fprintf(stderr, "OCIHandleFree(seshp, OCI_HTYPE_SESSION) returned %d\n", status);
-    if (errhp && (status = OCIHandleFree(errhp, OCI_HTYPE_ERROR)) != OCI_SUCCESS )
+    if (conn->errhp && (status = OCIHandleFree(conn->errhp, OCI_HTYPE_ERROR)) != OCI_SUCCESS )
         fprintf(stderr, "OCIHandleFree(errhp, OCI_HTYPE_ERROR) returned %d\n", status);
-    if (envhp && (status = OCIHandleFree(envhp, OCI_HTYPE_ENV)) != OCI_SUCCESS )
+    if (conn->shared_env) {
+        // Freeing our env would take these with it, the shared one outlives us
+        if (conn->svchp && (status = OCIHandleFree(conn->svchp, OCI_HTYPE_SVCCTX)) != OCI_SUCCESS )
+            fprintf(stderr, "OCIHandleFree(svchp, OCI_HTYPE_SVCCTX) returned %d\n", status);
+        if (conn->srvhp && (status = OCIHandleFree(conn->srvhp, OCI_HTYPE_SERVER)) != OCI_SUCCESS )
+            fprintf(stderr, "OCIHandleFree(srvhp, OCI_HTYPE_SERVER) returned %d\n", status);
+        conn->envhp = NULL;
+    }
+    if (conn->envhp && (status = OCIHandleFree(conn->envhp, OCI_HTYPE_ENV)) != OCI_SUCCESS )
         fprintf(stderr, "OCIHandleFree(envhp, OCI_HTYPE_ENV) returned %d\n", status);
-    if (mng_env && (status = OCIHandleFree(mng_env, OCI_HTYPE_ENV)) != OCI_SUCCESS )
+    if (conn->mng_env && (status = OCIHandleFree(conn->mng_env, OCI_HTYPE_ENV)) != OCI_SUCCESS )
         fprintf(stderr, "OCIHandleFree(mng_env, OCI_HTYPE_ENV) returned %d\n", status);
+    env_alloc_destroy(conn->alloc, &t_status->stats->alloc);
+    env_alloc_destroy(conn->mng_alloc, &t_status->stats->alloc);
+    hist_record(&t_status->stats->phase[PH_FREE], now_ns() - t0);
 
-    pthread_exit(NULL);
+    memset(conn, 0, sizeof(*conn));
 }
 
-int main(int argc, char* argv[]) {
-    int num_threads = 1; // Default number of threads
-    int opt;
+static void sleep_ns(uint64_t ns)
+{
+    struct timespec ts = { ns / 1000000000ull, ns % 1000000000ull };
 
-    // Parse command-line arguments
-    while ((opt = getopt(argc, argv, "t:")) != -1) {
-        switch (opt) {
-            case 't':
-                num_threads = atoi(optarg);
-                if (num_threads <= 0) {
-                    fprintf(stderr, "Invalid number of threads: %s\n", optarg);
-                    return EXIT_FAILURE;
-                }
-                break;
-            default:
-                fprintf(stderr, "Usage: %s [-t threads]\n", argv[0]);
-                return EXIT_FAILURE;
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+        ;
+}
+
+// Refill rate of the bucket t seconds into the loop
+static double ramp_rate(const RampSpec* spec, double t)
+{
+    switch (spec->profile) {
+        case RAMP_LINEAR: return spec->rate * (1 + t / spec->step);
+        case RAMP_EXP:    return spec->rate * pow(2, t / spec->step);
+        default:          return spec->rate;
+    }
+}
+
+void ramp_reset(Ramp* r)
+{
+    pthread_mutex_lock(&r->lock);
+    r->started = r->refilled = now_ns();
+    r->tokens = r->spec->burst;
+    r->last_connected = 0;
+    r->connected = 0;
+    pthread_mutex_unlock(&r->lock);
+}
+
+// Block until the bucket hands out a token
+void ramp_acquire(Ramp* r)
+{
+    pthread_mutex_lock(&r->lock);
+    r->attempts++;
+    while (r->spec->profile != RAMP_BURST) {
+        uint64_t now = now_ns();
+        double   rate;
+
+        // Refill at the rate of the middle of the interval, good enough for smooth profiles
+        rate = ramp_rate(r->spec, ((r->refilled + now) / 2 - r->started) / 1e9);
+        r->tokens += rate * (now - r->refilled) / 1e9;
+        if (r->tokens > r->spec->burst)
+            r->tokens = r->spec->burst;
+        r->refilled = now;
+
+        if (r->tokens >= 1) {
+            r->tokens -= 1;
+            break;
         }
+
+        // Sleep until the next token is due; anyone else waiting races for it afterwards
+        pthread_mutex_unlock(&r->lock);
+        sleep_ns((uint64_t)((1 - r->tokens) / rate * 1e9) + 1);
+        pthread_mutex_lock(&r->lock);
     }
+    pthread_mutex_unlock(&r->lock);
+}
 
-    // Validate environment variables
-    const char* schema = getenv("ORA_SCHEMA");
-    const char* passwd = getenv("ORA_PASSWD");
-    const char* dbname = getenv("ORA_DBNAME");
+// db_connect() behind the -R token bucket, retrying a failed login after a
+// full-jitter exponential backoff.  Same contract: call db_disconnect() after.
+int db_connect_paced(ThreadStatus* t_status, Connection* conn)
+{
+    Ramp*        r = t_status->ramp;
+    unsigned int seed = (unsigned int)(now_ns() ^ (uintptr_t)t_status);
 
-    if (!schema || !passwd || !dbname) {
-        fprintf(stderr, "Error: ORA_SCHEMA, ORA_PASSWD, and ORA_DBNAME environment variables must be defined.\n");
-        return EXIT_FAILURE;
+    if (!r)
+        return db_connect(t_status, conn);
+
+    for (int attempt = 0; ; attempt++) {
+        ramp_acquire(r);
+        if (db_connect(t_status, conn) == 0) {
+            pthread_mutex_lock(&r->lock);
+            r->connected++;
+            r->last_connected = now_ns();
+            pthread_mutex_unlock(&r->lock);
+            return 0;
+        }
+
+        pthread_mutex_lock(&r->lock);
+        r->failed_attempts++;
+        if (attempt == r->spec->retries)
+            r->gave_up++;
+        pthread_mutex_unlock(&r->lock);
+        if (attempt == r->spec->retries)
+            return -1;
+
+        // Keep the last error for the report, start the next attempt from scratch
+        db_disconnect(t_status, conn);
+        t_status->connection_status = 0;
+        sleep_ns((uint64_t)(r->spec->backoff * 1e6 * (1 << (attempt < 20 ? attempt : 20)) * rand_r(&seed) / ((double)RAND_MAX + 1)));
     }
+}
 
-    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
-    ThreadStatus* statuses = malloc(num_threads * sizeof(ThreadStatus));
+// Thread function - one connect/ping/disconnect cycle
+void* db_thread_function(void* arg)
+{
+    ThreadStatus* t_status = (ThreadStatus*)arg;
+    Connection  conn;
+    uint64_t    started = now_ns();
+    sword status;
 
-    if (!threads || !statuses) {
-        perror("Failed to allocate memory");
-        free(threads);
-        free(statuses);
-        return EXIT_FAILURE;
+    live_op_begin(t_status->live);
+    if (db_connect_paced(t_status, &conn) == 0) {
+        // Perform ping
+        status = TIMED(t_status, PH_PING, OCIPing(conn.svchp, conn.errhp, OCI_DEFAULT));
+        if (status != OCI_SUCCESS) {
+            OCIErrorGet(conn.errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
+            t_status->ping_status = status;
+            conn.broken = 1;
+        }
     }
 
-    for ( int l = 1 ; l < 33 ; l ++ )
-    {
+    db_disconnect(t_status, &conn);
+    hist_record(&t_status->stats->phase[PH_CYCLE], now_ns() - started);
 
-        // Create threads
-        for (int i = 0; i < num_threads; i++) {
-            memset(&statuses[i], 0, sizeof(ThreadStatus));
-            if (pthread_create(&threads[i], NULL, db_thread_function, &statuses[i]) != 0) {
-                perror("Failed to create thread");
-                num_threads = i; // Adjust the number of threads to join
-                break;
-            }
+    live_op_end(t_status->live, t_status->connection_status == 0 && t_status->ping_status == 0);
+    if (t_status->live && (t_status->connection_status != 0 || t_status->ping_status != 0))
+        live_event(t_status->live, t_status->connection_status ? t_status->connection_status : t_status->ping_status,
+                   t_status->error_message);
+
+    return NULL;
+}
+
+// Thread function - keep one session open and ping it (or run SELECT 1 FROM
+// DUAL, -W select) back to back until the deadline
+void* db_ping_function(void* arg)
+{
+    ThreadStatus* t_status = (ThreadStatus*)arg;
+    static const char sql[] = "SELECT 1 FROM DUAL";
+    Connection  conn;
+    OCIStmt*    stmthp = NULL;
+    OCIDefine*  defnp  = NULL;
+    int         value  = 0;
+    sb2         ind    = 0;
+    Phase       phase  = t_status->use_select ? PH_SELECT : PH_PING;
+    uint64_t    t0, t1;
+    sword status = OCI_SUCCESS;
+
+    if (db_connect_paced(t_status, &conn) != 0) {
+        // A login that never happened counts as one failed operation
+        live_op_end(t_status->live, 0);
+        if (t_status->live)
+            live_event(t_status->live, t_status->connection_status, t_status->error_message);
+        goto cleanup;
+    }
+
+    if (t_status->use_select) {
+        if (( status = OCIStmtPrepare2(conn.svchp, &stmthp, conn.errhp, (const OraText*)sql, sizeof(sql) - 1,
+                                       NULL, 0, OCI_NTV_SYNTAX, OCI_DEFAULT)) != OCI_SUCCESS ||
+            ( status = OCIDefineByPos(stmthp, &defnp, conn.errhp, 1, &value, sizeof(value), SQLT_INT,
+                                      &ind, NULL, NULL, OCI_DEFAULT)) != OCI_SUCCESS) {
+            OCIErrorGet(conn.errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
+            t_status->ping_status = status;
+            goto cleanup;
         }
+    }
 
-        // Wait for threads to complete
-        for (int i = 0; i < num_threads; i++) {
-            pthread_join(threads[i], NULL);
-            printf(" INFO: LOOP %d Thread %d", l, i + 1);
-            if (statuses[i].connection_status == 0 && statuses[i].ping_status == 0) {
-                printf(" Database connection and ping successful.\n");
-            } else {
-                printf(" Error: %s\n", statuses[i].error_message);
-            }
+    for (t0 = now_ns(); t0 < t_status->deadline; t0 = t1) {
+        live_op_begin(t_status->live);
+        if (stmthp)
+            status = OCIStmtExecute(conn.svchp, stmthp, conn.errhp, 1, 0, NULL, NULL, OCI_DEFAULT);
+        else
+            status = OCIPing(conn.svchp, conn.errhp, OCI_DEFAULT);
+        t1 = now_ns();
+        hist_record(&t_status->stats->phase[phase], t1 - t0);
+        live_op_end(t_status->live, status == OCI_SUCCESS);
+
+        if (status != OCI_SUCCESS) {
+            OCIErrorGet(conn.errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
+            t_status->ping_status = status;
+            conn.broken = 1;
+            if (t_status->live)
+                live_event(t_status->live, status, t_status->error_message);
+            break;
         }
+        t_status->ops++;
     }
 
-    free(threads);
-    free(statuses);
+cleanup:
+
+    if (stmthp)
+        OCIStmtRelease(stmthp, conn.errhp, NULL, 0, OCI_DEFAULT);
+    db_disconnect(t_status, &conn);
+
+    return NULL;
+}
+
+#define STMT_MAX_COLS   16      // columns defined per query, the rest are not fetched
+#define STMT_COL_WIDTH  256     // bytes per fetched value, longer values come back truncated
+#define STMT_BIND_WIDTH 32      // bytes per bound string value
+
+// Define and bind arrays of one -W stmt thread, sized for -Q array rows
+typedef struct {
+    char*   cols;               // STMT_MAX_COLS arrays of array values
+    sb2*    ind;
+    ub2*    rlen;
+    int*    ids;                // first bind: 1, 2, 3 ... continued across executes
+    char*   text;               // further binds
+} StmtBuffers;
+
+static const char round_trips_sql[] =
+    "SELECT m.value FROM v$mystat m, v$statname n"
+    " WHERE m.statistic# = n.statistic# AND n.name = 'SQL*Net roundtrips to/from client'";
+
+// SQL*Net round trips of the session so far, this query's own included; -1
+// if v$mystat is not readable
+static long db_round_trips(Connection* conn)
+{
+    OCIStmt*   stmthp = NULL;
+    OCIDefine* defnp = NULL;
+    long long  value = -1;
+    sb2        ind = 0;
+
+    if (OCIStmtPrepare2(conn->svchp, &stmthp, conn->errhp, (const OraText*)round_trips_sql, sizeof(round_trips_sql) - 1,
+                        NULL, 0, OCI_NTV_SYNTAX, OCI_DEFAULT) != OCI_SUCCESS)
+        return -1;
+    if (OCIDefineByPos(stmthp, &defnp, conn->errhp, 1, &value, sizeof(value), SQLT_INT, &ind, NULL, NULL, OCI_DEFAULT) != OCI_SUCCESS ||
+        OCIStmtExecute(conn->svchp, stmthp, conn->errhp, 1, 0, NULL, NULL, OCI_DEFAULT) != OCI_SUCCESS || ind != 0)
+        value = -1;
+    OCIStmtRelease(stmthp, conn->errhp, NULL, 0, OCI_DEFAULT);
+    return (long)value;
+}
+
+// Run one statement of the mix: prepare (from the statement cache when it is
+// on), execute DML once for the whole bind array or fetch a query to the end
+// an array at a time, then release it back to the cache.  Rows fetched or
+// affected, -1 on failure with the error in t_status.
+static long db_stmt_run(ThreadStatus* t_status, Connection* conn, const SqlStmt* sql, StmtBuffers* b)
+{
+    const StmtSpec* spec = t_status->stmt;
+    OCIStmt*   stmthp = NULL;
+    OCIBind*   bindp;
+    OCIDefine* defnp;
+    ub4        ncols = 0, fetched = 0, row_count = 0;
+    long       rows = 0;
+    sword      status;
+
+    if (( status = TIMED(t_status, PH_STMT_PREPARE, OCIStmtPrepare2(conn->svchp, &stmthp, conn->errhp, (const OraText*)sql->sql,
+                                                                    strlen(sql->sql), NULL, 0, OCI_NTV_SYNTAX, OCI_DEFAULT))) != OCI_SUCCESS) {
+        stmthp = NULL;
+        goto fail;
+    }
+
+    // :1 is a running number, any further placeholders a fixed string; a
+    // query only uses the first entry of each array
+    for (int k = 0; k < sql->binds; k++) {
+        if (( status = OCIBindByPos(stmthp, &bindp, conn->errhp, k + 1, k ? (void*)b->text : (void*)b->ids,
+                                    k ? STMT_BIND_WIDTH : (sb4)sizeof(int), k ? SQLT_STR : SQLT_INT,
+                                    NULL, NULL, NULL, 0, NULL, OCI_DEFAULT)) != OCI_SUCCESS)
+            goto fail;
+    }
+
+    if (!sql->is_query) {
+        for (ub4 i = 0; i < spec->array; i++)
+            b->ids[i] += spec->array;
+        if (( status = TIMED(t_status, PH_STMT_EXECUTE, OCIStmtExecute(conn->svchp, stmthp, conn->errhp, spec->array, 0,
+                                                                       NULL, NULL, OCI_COMMIT_ON_SUCCESS))) != OCI_SUCCESS)
+            goto fail;
+        OCIAttrGet(stmthp, OCI_HTYPE_STMT, &row_count, NULL, OCI_ATTR_ROW_COUNT, conn->errhp);
+        rows = row_count;
+        goto out;
+    }
+
+    // A cached statement keeps its attributes, set them every time anyway
+    if (( status = OCIAttrSet(stmthp, OCI_HTYPE_STMT, (void*)&spec->prefetch, 0, OCI_ATTR_PREFETCH_ROWS, conn->errhp)) != OCI_SUCCESS ||
+        ( status = OCIAttrSet(stmthp, OCI_HTYPE_STMT, (void*)&spec->prefmem, 0, OCI_ATTR_PREFETCH_MEMORY, conn->errhp)) != OCI_SUCCESS)
+        goto fail;
+
+    // Execute without fetching - the round trip still brings back the first
+    // prefetch batch - then define arrays over the described columns
+    if (( status = TIMED(t_status, PH_STMT_EXECUTE, OCIStmtExecute(conn->svchp, stmthp, conn->errhp, 0, 0, NULL, NULL, OCI_DEFAULT))) != OCI_SUCCESS ||
+        ( status = OCIAttrGet(stmthp, OCI_HTYPE_STMT, &ncols, NULL, OCI_ATTR_PARAM_COUNT, conn->errhp)) != OCI_SUCCESS)
+        goto fail;
+    if (ncols > STMT_MAX_COLS)
+        ncols = STMT_MAX_COLS;
+    for (ub4 c = 0; c < ncols; c++) {
+        size_t at = (size_t)c * spec->array;
+        if (( status = OCIDefineByPos(stmthp, &defnp, conn->errhp, c + 1, b->cols + at * STMT_COL_WIDTH, STMT_COL_WIDTH, SQLT_STR,
+                                      b->ind + at, b->rlen + at, NULL, OCI_DEFAULT)) != OCI_SUCCESS)
+            goto fail;
+    }
+
+    // The last call returns OCI_NO_DATA with whatever rows were left
+    do {
+        status = TIMED(t_status, PH_STMT_FETCH, OCIStmtFetch2(stmthp, conn->errhp, spec->array, OCI_FETCH_NEXT, 0, OCI_DEFAULT));
+        if (status != OCI_SUCCESS && status != OCI_SUCCESS_WITH_INFO && status != OCI_NO_DATA)
+            goto fail;
+        OCIAttrGet(stmthp, OCI_HTYPE_STMT, &fetched, NULL, OCI_ATTR_ROWS_FETCHED, conn->errhp);
+        rows += fetched;
+    } while (status != OCI_NO_DATA);
+
+out:
+    OCIStmtRelease(stmthp, conn->errhp, NULL, 0, OCI_DEFAULT);
+    return rows;
+
+fail:
+    OCIErrorGet(conn->errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
+    t_status->ping_status = status ? status : -1;
+    if (stmthp)
+        OCIStmtRelease(stmthp, conn->errhp, NULL, 0, OCI_DEFAULT);
+    return -1;
+}
+
+// Thread function - keep one session open and run the -S statement mix with
+// the -Q statement cache, prefetch and array settings until the deadline
+void* db_stmt_function(void* arg)
+{
+    ThreadStatus*   t_status = (ThreadStatus*)arg;
+    const StmtSpec* spec = t_status->stmt;
+    const SqlMix*   mix = t_status->mix;
+    Connection  conn;
+    StmtBuffers b = { 0 };
+    ub4         cache = spec->cache;
+    long        rt_start = -1, rt_end, rows;
+    int         pick = 0;
+    int         left = mix->stmts[0].weight;
+    uint64_t    t0, t1;
+    sword status;
+
+    t_status->round_trips = -1;
+
+    if (db_connect_paced(t_status, &conn) != 0) {
+        // A login that never happened counts as one failed operation
+        live_op_end(t_status->live, 0);
+        if (t_status->live)
+            live_event(t_status->live, t_status->connection_status, t_status->error_message);
+        goto cleanup;
+    }
+
+    b.cols = malloc((size_t)STMT_MAX_COLS * spec->array * STMT_COL_WIDTH);
+    b.ind  = malloc((size_t)STMT_MAX_COLS * spec->array * sizeof(sb2));
+    b.rlen = malloc((size_t)STMT_MAX_COLS * spec->array * sizeof(ub2));
+    b.ids  = malloc((size_t)spec->array * sizeof(int));
+    b.text = malloc((size_t)spec->array * STMT_BIND_WIDTH);
+    if (!b.cols || !b.ind || !b.rlen || !b.ids || !b.text) {
+        snprintf(t_status->error_message, sizeof(t_status->error_message), "Failed to allocate %u row arrays", spec->array);
+        t_status->ping_status = -1;
+        goto cleanup;
+    }
+    for (ub4 i = 0; i < spec->array; i++) {
+        b.ids[i] = (int)i + 1 - (int)spec->array;
+        snprintf(b.text + (size_t)i * STMT_BIND_WIDTH, STMT_BIND_WIDTH, "db-thread row %u", i + 1);
+    }
+
+    // The cache lives on the service context, a pooled session brings its own
+    if (( status = OCIAttrSet(conn.svchp, OCI_HTYPE_SVCCTX, &cache, 0, OCI_ATTR_STMTCACHESIZE, conn.errhp)) != OCI_SUCCESS) {
+        OCIErrorGet(conn.errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
+        t_status->ping_status = status;
+        goto cleanup;
+    }
+    rt_start = db_round_trips(&conn);
+
+    // Walk the mix in order, each statement weight times in a row
+    for (t0 = now_ns(); t0 < t_status->deadline; t0 = t1) {
+        if (left-- == 0) {
+            pick = (pick + 1) % mix->count;
+            left = mix->stmts[pick].weight - 1;
+        }
+        live_op_begin(t_status->live);
+        rows = db_stmt_run(t_status, &conn, &mix->stmts[pick], &b);
+        t1 = now_ns();
+        hist_record(&t_status->stats->phase[PH_STATEMENT], t1 - t0);
+        live_op_end(t_status->live, rows >= 0);
+
+        if (rows < 0) {
+            conn.broken = 1;
+            if (t_status->live)
+                live_event(t_status->live, t_status->ping_status, t_status->error_message);
+            break;
+        }
+        t_status->ops++;
+        t_status->rows += rows;
+    }
+
+    // Less the reading that closes the window
+    if (rt_start >= 0 && !conn.broken && (rt_end = db_round_trips(&conn)) >= 0)
+        t_status->round_trips = rt_end - rt_start - 1;
+
+cleanup:
+
+    free(b.cols);
+    free(b.ind);
+    free(b.rlen);
+    free(b.ids);
+    free(b.text);
+    db_disconnect(t_status, &conn);
+
+    return NULL;
+}
+
+#define EXPORT_VALUE_MAX 32767  // -W export prefixed: define size, longer values arrive in pieces
+
+// Per-thread state behind the -W export define callbacks
+typedef struct {
+    ExportMap*  map;
+    int         pending;        // a piece is out with OCI, its length not taken yet
+    ub4         alen;           // OCI writes the piece length and indicator here
+    sb2         ind;
+    ub2         rcode;
+} ExportSink;
+
+typedef struct {
+    ExportSink* sink;
+    ub4         col;
+} ExportColumn;
+
+static void export_sink_flush(ExportSink* x)
+{
+    if (x->pending)
+        export_piece_done(x->map, x->alen, x->ind == -1);
+    x->pending = 0;
+}
+
+// OCIDefineDynamic callback: account for the piece OCI just filled, then hand
+// out room for the next one straight from the mapped file.  OCI calls back as
+// each value arrives, so the previous piece is complete by the time this runs.
+static sb4 export_define_cb(void* octxp, OCIDefine* defnp, ub4 iter, void** bufpp, ub4** alenp,
+                            ub1* piecep, void** indp, ub2** rcodep)
+{
+    ExportColumn* c = octxp;
+    ExportSink*   x = c->sink;
+    uint32_t      room;
+    (void)defnp;
+
+    export_sink_flush(x);
+    if (!(*bufpp = export_piece(x->map, c->col, iter, *piecep == OCI_NEXT_PIECE, &room)))
+        return OCI_ERROR;
+    x->alen = room;
+    x->ind = 0;
+    x->rcode = 0;
+    x->pending = 1;
+    *alenp = &x->alen;
+    *indp = &x->ind;
+    *rcodep = &x->rcode;
+    return OCI_CONTINUE;
+}
+
+// Thread function - log in once and stream the first statement of the mix
+// into a memory-mapped file through dynamic defines, one fetch array at a time
+void* db_export_function(void* arg)
+{
+    ThreadStatus*     t_status = (ThreadStatus*)arg;
+    const ExportSpec* spec = t_status->export;
+    const StmtSpec*   fetch = t_status->stmt;
+    const char*       sql = t_status->mix->stmts[0].sql;
+    Connection    conn;
+    OCIStmt*      stmthp = NULL;
+    OCIDefine*    defnp;
+    ExportSink    sink = { 0 };
+    ExportColumn* cols = NULL;
+    char          path[4096];
+    ub4           ncols = 0, fetched = 0;
+    uint64_t      started;
+    sword status = OCI_SUCCESS;
+
+    if (db_connect_paced(t_status, &conn) != 0) {
+        // A login that never happened counts as one failed operation
+        live_op_end(t_status->live, 0);
+        if (t_status->live)
+            live_event(t_status->live, t_status->connection_status, t_status->error_message);
+        goto cleanup;
+    }
+
+    live_op_begin(t_status->live);
+    started = now_ns();
+    if (( status = TIMED(t_status, PH_STMT_PREPARE, OCIStmtPrepare2(conn.svchp, &stmthp, conn.errhp, (const OraText*)sql, strlen(sql),
+                                                                    NULL, 0, OCI_NTV_SYNTAX, OCI_DEFAULT))) != OCI_SUCCESS) {
+        stmthp = NULL;
+        goto fail;
+    }
+    if (( status = OCIAttrSet(stmthp, OCI_HTYPE_STMT, (void*)&fetch->prefetch, 0, OCI_ATTR_PREFETCH_ROWS, conn.errhp)) != OCI_SUCCESS ||
+        ( status = OCIAttrSet(stmthp, OCI_HTYPE_STMT, (void*)&fetch->prefmem, 0, OCI_ATTR_PREFETCH_MEMORY, conn.errhp)) != OCI_SUCCESS ||
+        ( status = TIMED(t_status, PH_STMT_EXECUTE, OCIStmtExecute(conn.svchp, stmthp, conn.errhp, 0, 0, NULL, NULL, OCI_DEFAULT))) != OCI_SUCCESS ||
+        ( status = OCIAttrGet(stmthp, OCI_HTYPE_STMT, &ncols, NULL, OCI_ATTR_PARAM_COUNT, conn.errhp)) != OCI_SUCCESS)
+        goto fail;
+
+    if (t_status->threads > 1)
+        snprintf(path, sizeof(path), "%s.%d", spec->path, t_status->slot + 1);
+    else
+        snprintf(path, sizeof(path), "%s", spec->path);
+    if (!(cols = calloc(ncols, sizeof(ExportColumn))) ||
+        !(sink.map = export_map_open(path, spec->layout, ncols, fetch->array, spec->width))) {
+        snprintf(t_status->error_message, sizeof(t_status->error_message), "%.400s: %s", path, strerror(errno));
+        t_status->ping_status = -1;
+        goto out;
+    }
+
+    // No buffers of our own: every value is placed by export_define_cb()
+    for (ub4 c = 0; c < ncols; c++) {
+        cols[c].sink = &sink;
+        cols[c].col = c;
+        if (( status = OCIDefineByPos(stmthp, &defnp, conn.errhp, c + 1, NULL,
+                                      spec->layout == EXPORT_COLUMNAR ? (sb4)spec->width : EXPORT_VALUE_MAX, SQLT_CHR,
+                                      NULL, NULL, NULL, OCI_DYNAMIC_FETCH)) != OCI_SUCCESS ||
+            ( status = OCIDefineDynamic(defnp, conn.errhp, &cols[c], export_define_cb)) != OCI_SUCCESS)
+            goto fail;
+    }
+
+    do {
+        if (export_block_begin(sink.map) != 0) {
+            snprintf(t_status->error_message, sizeof(t_status->error_message), "%.400s: %s", path, strerror(errno));
+            t_status->ping_status = -1;
+            goto out;
+        }
+        status = TIMED(t_status, PH_STMT_FETCH, OCIStmtFetch2(stmthp, conn.errhp, fetch->array, OCI_FETCH_NEXT, 0, OCI_DEFAULT));
+        export_sink_flush(&sink);
+        fetched = 0;
+        OCIAttrGet(stmthp, OCI_HTYPE_STMT, &fetched, NULL, OCI_ATTR_ROWS_FETCHED, conn.errhp);
+        export_block_end(sink.map, fetched);
+        if (status != OCI_SUCCESS && status != OCI_SUCCESS_WITH_INFO && status != OCI_NO_DATA)
+            goto fail;
+    } while (status != OCI_NO_DATA);
+    goto out;
+
+fail:
+    OCIErrorGet(conn.errhp, 1, NULL, &status, (OraText*)t_status->error_message, sizeof(t_status->error_message), OCI_HTYPE_ERROR);
+    t_status->ping_status = status ? status : -1;
+    conn.broken = 1;
+
+out:
+    if (sink.map && export_map_close(sink.map, &t_status->exported) != 0 && t_status->ping_status == 0) {
+        snprintf(t_status->error_message, sizeof(t_status->error_message), "%.400s: %s", path, strerror(errno));
+        t_status->ping_status = -1;
+    }
+    if (stmthp)
+        OCIStmtRelease(stmthp, conn.errhp, NULL, 0, OCI_DEFAULT);
+    hist_record(&t_status->stats->phase[PH_EXPORT], now_ns() - started);
+    live_op_end(t_status->live, t_status->ping_status == 0);
+    if (t_status->ping_status == 0) {
+        t_status->ops = 1;
+        t_status->rows = (long)t_status->exported.rows;
+    } else if (t_status->live) {
+        live_event(t_status->live, t_status->ping_status, t_status->error_message);
+    }
+
+cleanup:
+
+    free(cols);
+    db_disconnect(t_status, &conn);
+
+    return NULL;
+}
+
+// Non-blocking event loop (-L): one thread drives many sessions through
+// login, back to back pings until the deadline, and logout.  The servers are
+// switched to OCI_ATTR_NONBLOCKING_MODE after the (blocking) attach, calls
+// that return OCI_STILL_EXECUTING are simply repeated on the next pass.
+#define EV_IDLE_NS  50000           // nap when a whole pass made no progress
+
+typedef enum {
+    EV_BEGIN,           // OCISessionBegin in progress
+    EV_PING,            // OCIPing in progress or due
+    EV_END,             // OCISessionEnd in progress
+    EV_DETACH,          // OCIServerDetach in progress
+    EV_DONE
+} EvState;
+
+typedef struct {
+    ThreadStatus* status;
+    Connection    conn;
+    EvState       state;
+    uint64_t      connect;      // now_ns() the connect started
+    uint64_t      call;         // now_ns() the current call was first issued
+    int           issued;       // the current call has returned OCI_STILL_EXECUTING
+} EvSession;
+
+typedef struct {
+    ThreadStatus* statuses;     // this loop's share of the slots
+    int           count;
+} EvLoop;
+
+// Issue or poll one call; 1 while still executing
+static int ev_pending(EvSession* s, sword status)
+{
+    if (status == OCI_STILL_EXECUTING) {
+        s->issued = 1;
+        return 1;
+    }
+    s->issued = 0;
+    return 0;
+}
+
+static void ev_error(EvSession* s, sword status, int* where)
+{
+    OCIErrorGet(s->conn.errhp, 1, NULL, &status, (OraText*)s->status->error_message, sizeof(s->status->error_message), OCI_HTYPE_ERROR);
+    *where = status;
+    if (s->status->live)
+        live_event(s->status->live, status, s->status->error_message);
+}
+
+// Advance one session as far as it will go without blocking; 1 if it moved
+static int ev_step(EvSession* s, uint64_t now)
+{
+    ThreadStatus* t_status = s->status;
+    Connection*   conn = &s->conn;
+    sword         status;
+
+    if (!s->issued)
+        s->call = now;
+
+    switch (s->state) {
+        case EV_BEGIN:
+            if (ev_pending(s, status = OCISessionBegin(conn->svchp, conn->errhp, conn->seshp, OCI_CRED_RDBMS, OCI_DEFAULT)))
+                return 0;
+            hist_record(&t_status->stats->phase[PH_SESSION_BEGIN], now_ns() - s->call);
+            if (status != OCI_SUCCESS) {
+                ev_error(s, status, &t_status->connection_status);
+                s->state = EV_DETACH;
+                return 1;
+            }
+            conn->logged_on = 1;
+            sessions_held_add(1);
+            if (( status = OCIAttrSet(conn->svchp, OCI_HTYPE_SVCCTX, conn->seshp, 0, OCI_ATTR_SESSION, conn->errhp)) != OCI_SUCCESS) {
+                ev_error(s, status, &t_status->connection_status);
+                s->state = EV_END;
+                return 1;
+            }
+            hist_record(&t_status->stats->phase[PH_CONNECT], now_ns() - s->connect);
+            s->state = EV_PING;
+            return 1;
+
+        case EV_PING:
+            if (!s->issued && now >= t_status->deadline) {
+                s->state = EV_END;
+                return 1;
+            }
+            if (!s->issued)
+                live_op_begin(t_status->live);
+            if (ev_pending(s, status = OCIPing(conn->svchp, conn->errhp, OCI_DEFAULT)))
+                return 0;
+            hist_record(&t_status->stats->phase[PH_PING], now_ns() - s->call);
+            live_op_end(t_status->live, status == OCI_SUCCESS);
+            if (status != OCI_SUCCESS) {
+                ev_error(s, status, &t_status->ping_status);
+                conn->broken = 1;
+                s->state = EV_END;
+                return 1;
+            }
+            t_status->ops++;
+            return 1;
+
+        case EV_END:
+            if (ev_pending(s, status = OCISessionEnd(conn->svchp, conn->errhp, conn->seshp, OCI_DEFAULT)))
+                return 0;
+            hist_record(&t_status->stats->phase[PH_SESSION_END], now_ns() - s->call);
+            if (status != OCI_SUCCESS)
+                ev_error(s, status, &t_status->connection_status);
+            conn->logged_on = 0;
+            sessions_held_add(-1);
+            s->state = EV_DETACH;
+            return 1;
+
+        case EV_DETACH:
+            if (ev_pending(s, status = OCIServerDetach(conn->srvhp, conn->errhp, OCI_DEFAULT)))
+                return 0;
+            hist_record(&t_status->stats->phase[PH_DETACH], now_ns() - s->call);
+            if (status != OCI_SUCCESS)
+                ev_error(s, status, &t_status->connection_status);
+            conn->attached = 0;
+            db_disconnect(t_status, conn);
+            s->state = EV_DONE;
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
+void* event_loop_function(void* arg)
+{
+    EvLoop*    ev = (EvLoop*)arg;
+    EvSession* sessions = calloc(ev->count, sizeof(EvSession));
+    int        active = 0;
+
+    if (!sessions) {
+        for (int i = 0; i < ev->count; i++) {
+            snprintf(ev->statuses[i].error_message, sizeof(ev->statuses[i].error_message), "Failed to allocate memory");
+            ev->statuses[i].connection_status = -1;
+        }
+        return NULL;
+    }
+
+    // Environments, handles and attach still block; everything after is polled
+    for (int i = 0; i < ev->count; i++) {
+        EvSession* s = &sessions[i];
+        sword      status;
+
+        s->status = &ev->statuses[i];
+        s->connect = now_ns();
+        if (db_attach(s->status, &s->conn) != 0) {
+            db_disconnect(s->status, &s->conn);
+            s->state = EV_DONE;
+            continue;
+        }
+        if (( status = OCIAttrSet(s->conn.srvhp, OCI_HTYPE_SERVER, NULL, 0, OCI_ATTR_NONBLOCKING_MODE, s->conn.errhp)) != OCI_SUCCESS) {
+            ev_error(s, status, &s->status->connection_status);
+            s->state = EV_DETACH;
+        }
+        active++;
+    }
+
+    while (active > 0) {
+        uint64_t now = now_ns();
+        int      moved = 0;
+
+        for (int i = 0; i < ev->count; i++) {
+            if (sessions[i].state == EV_DONE)
+                continue;
+            moved += ev_step(&sessions[i], now);
+            if (sessions[i].state == EV_DONE)
+                active--;
+        }
+        if (!moved)
+            sleep_ns(EV_IDLE_NS);
+    }
+
+    free(sessions);
+    return NULL;
+}
+
+void session_pool_error(SessionPool* sp, const char* what)
+{
+    char  msg[512] = "";
+    sb4   code = 0;
+
+    if (sp->errhp)
+        OCIErrorGet(sp->errhp, 1, NULL, &code, (OraText*)msg, sizeof(msg), OCI_HTYPE_ERROR);
+    fprintf(stderr, "Error: %s failed %s\n", what, msg);
+}
+
+void session_pool_destroy(SessionPool* sp, EnvAllocStats* alloc_stats)
+{
+    sword status;
+
+    if (sp->name && (status = OCISessionPoolDestroy(sp->spoolhp, sp->errhp, OCI_DEFAULT)) != OCI_SUCCESS)
+        session_pool_error(sp, "OCISessionPoolDestroy");
+    if (sp->authp)
+        OCIHandleFree(sp->authp, OCI_HTYPE_AUTHINFO);
+    if (sp->spoolhp)
+        OCIHandleFree(sp->spoolhp, OCI_HTYPE_SPOOL);
+    if (sp->errhp)
+        OCIHandleFree(sp->errhp, OCI_HTYPE_ERROR);
+    if (sp->envhp)
+        OCIHandleFree(sp->envhp, OCI_HTYPE_ENV);
+    env_alloc_destroy(sp->alloc, alloc_stats);
+    memset(sp, 0, sizeof(*sp));
+}
+
+// Create the shared OCI_THREADED environment and a homogeneous session pool
+int session_pool_create(SessionPool* sp, EnvAllocKind env_alloc, const char* schema, const char* passwd, const char* dbname)
+{
+    ub1 getmode = OCI_SPOOL_ATTRVAL_WAIT;
+
+    sp->alloc = env_alloc_create(env_alloc);
+    if (OCIEnvNlsCreate(&sp->envhp, OCI_THREADED, ENV_ALLOC_CALLBACKS(sp->alloc), 0, NULL, 0, 0) != OCI_SUCCESS) {
+        fprintf(stderr, "Error: Failed to initialize OCI (pool) environment\n");
+        return -1;
+    }
+    if (OCIHandleAlloc(sp->envhp, (void**)&sp->errhp,   OCI_HTYPE_ERROR,    0, NULL) != OCI_SUCCESS ||
+        OCIHandleAlloc(sp->envhp, (void**)&sp->spoolhp, OCI_HTYPE_SPOOL,    0, NULL) != OCI_SUCCESS ||
+        OCIHandleAlloc(sp->envhp, (void**)&sp->authp,   OCI_HTYPE_AUTHINFO, 0, NULL) != OCI_SUCCESS) {
+        fprintf(stderr, "Error: Failed to allocate OCI session pool handles\n");
+        session_pool_destroy(sp, NULL);
+        return -1;
+    }
+
+    if (OCISessionPoolCreate(sp->envhp, sp->errhp, sp->spoolhp, &sp->name, &sp->name_len,
+                             (const OraText*)dbname, strlen(dbname), sp->min, sp->max, sp->incr,
+                             (OraText*)schema, strlen(schema), (OraText*)passwd, strlen(passwd),
+                             OCI_SPC_HOMOGENEOUS) != OCI_SUCCESS) {
+        session_pool_error(sp, "OCISessionPoolCreate");
+        sp->name = NULL;
+        session_pool_destroy(sp, NULL);
+        return -1;
+    }
+
+    // Workers queue for a session rather than fail when the pool is at max
+    if (OCIAttrSet(sp->spoolhp, OCI_HTYPE_SPOOL, &getmode, sizeof(getmode), OCI_ATTR_SPOOL_GETMODE, sp->errhp) != OCI_SUCCESS ||
+        OCIAttrSet(sp->authp, OCI_HTYPE_AUTHINFO, (void*)schema, strlen(schema), OCI_ATTR_USERNAME, sp->errhp) != OCI_SUCCESS ||
+        OCIAttrSet(sp->authp, OCI_HTYPE_AUTHINFO, (void*)passwd, strlen(passwd), OCI_ATTR_PASSWORD, sp->errhp) != OCI_SUCCESS) {
+        session_pool_error(sp, "OCIAttrSet");
+        session_pool_destroy(sp, NULL);
+        return -1;
+    }
+
+    return 0;
+}
+
+int job_queue_init(JobQueue* q, int capacity, void* (*fn)(void*))
+{
+    memset(q, 0, sizeof(*q));
+    q->job = fn;
+    if (!(q->jobs = calloc(capacity, sizeof(ThreadStatus*))))
+        return -1;
+    q->capacity = capacity;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->ready, NULL);
+    pthread_cond_init(&q->idle, NULL);
+    return 0;
+}
+
+void job_queue_destroy(JobQueue* q)
+{
+    pthread_cond_destroy(&q->idle);
+    pthread_cond_destroy(&q->ready);
+    pthread_mutex_destroy(&q->lock);
+    free(q->jobs);
+}
+
+// Queue one connect/ping/disconnect job (the queue holds at most one job per status slot)
+void job_queue_push(JobQueue* q, ThreadStatus* job)
+{
+    pthread_mutex_lock(&q->lock);
+    q->jobs[(q->head + q->count) % q->capacity] = job;
+    q->count++;
+    q->pending++;
+    pthread_cond_signal(&q->ready);
+    pthread_mutex_unlock(&q->lock);
+}
+
+// Block until every queued job has been run
+void job_queue_wait_idle(JobQueue* q)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->pending > 0)
+        pthread_cond_wait(&q->idle, &q->lock);
+    pthread_mutex_unlock(&q->lock);
+}
+
+void job_queue_shutdown(JobQueue* q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->shutdown = 1;
+    pthread_cond_broadcast(&q->ready);
+    pthread_mutex_unlock(&q->lock);
+}
+
+// Open loop schedule (-r): the dispatcher queues intended start times at a
+// fixed rate whether or not the workers keep up, so a slow login shows as
+// queueing delay instead of quietly lowering the offered load
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  ready;      // an arrival was queued or the schedule ended
+    uint64_t*       due;        // ring of intended start times (now_ns)
+    long            capacity;
+    long            head;
+    long            count;
+    long            backlog_max;
+    int             done;       // no more arrivals
+} Arrivals;
+
+// One open loop worker: runs a full cycle per arrival on its own stats slot
+typedef struct {
+    Arrivals*     arrivals;
+    ThreadStatus  status;       // template copied for every operation
+    int           id;
+    int           quiet;
+    long          completed;
+    long          failed;
+} OpenLoopWorker;
+
+int arrivals_push(Arrivals* a, uint64_t due)
+{
+    pthread_mutex_lock(&a->lock);
+    if (a->count == a->capacity) {
+        // Unbounded backlog: the point is to see how far behind the workers fall
+        long      capacity = a->capacity * 2;
+        uint64_t* grown = malloc(capacity * sizeof(uint64_t));
+
+        if (!grown) {
+            pthread_mutex_unlock(&a->lock);
+            return -1;
+        }
+        for (long i = 0; i < a->count; i++)
+            grown[i] = a->due[(a->head + i) % a->capacity];
+        free(a->due);
+        a->due = grown;
+        a->capacity = capacity;
+        a->head = 0;
+    }
+    a->due[(a->head + a->count) % a->capacity] = due;
+    if (++a->count > a->backlog_max)
+        a->backlog_max = a->count;
+    pthread_cond_signal(&a->ready);
+    pthread_mutex_unlock(&a->lock);
+    return 0;
+}
+
+void* open_loop_worker(void* arg)
+{
+    OpenLoopWorker* w = (OpenLoopWorker*)arg;
+    Arrivals*       a = w->arrivals;
+    ThreadStatus    t_status;
+    uint64_t        due, started, finished;
+
+    for (;;) {
+        pthread_mutex_lock(&a->lock);
+        while (a->count == 0 && !a->done)
+            pthread_cond_wait(&a->ready, &a->lock);
+        if (a->count == 0) {
+            pthread_mutex_unlock(&a->lock);
+            break;
+        }
+        due = a->due[a->head];
+        a->head = (a->head + 1) % a->capacity;
+        a->count--;
+        pthread_mutex_unlock(&a->lock);
+
+        started = now_ns();
+        t_status = w->status;
+        db_thread_function(&t_status);
+        finished = now_ns();
+
+        // Charge the wait for a free worker to the operation, not just its service time
+        hist_record(&t_status.stats->phase[PH_QUEUE], started - due);
+        hist_record(&t_status.stats->phase[PH_RESPONSE], finished - due);
+        w->completed++;
+        if (t_status.connection_status != 0 || t_status.ping_status != 0) {
+            w->failed++;
+            if (!t_status.live)
+                printf(" INFO: OPEN LOOP Thread %d Error: %s\n", w->id + 1, t_status.error_message);
+        } else if (!w->quiet && !t_status.live) {
+            printf(" INFO: OPEN LOOP Thread %d Database connection and ping successful.\n", w->id + 1);
+        }
+    }
+
+    return NULL;
+}
+
+// Release arrivals every 1/rate seconds from started until deadline, one
+// worker thread per status slot; fills the -r fields of sum and the counts of targets
+int open_loop_run(const Config* cfg, int num_threads, ThreadStatus* statuses, pthread_t* threads,
+                  uint64_t started, uint64_t deadline, RunSummary* sum, TargetStats* targets)
+{
+    Arrivals        a = { 0 };
+    OpenLoopWorker* workers = aligned_alloc(LIVE_CACHE_LINE, num_threads * sizeof(OpenLoopWorker));
+    int             running = 0;
+    uint64_t        due = started;
+    long            k;
+
+    if (workers)
+        memset(workers, 0, num_threads * sizeof(OpenLoopWorker));
+    a.capacity = 1024;
+    a.due = malloc(a.capacity * sizeof(uint64_t));
+    if (!workers || !a.due) {
+        perror("Failed to allocate memory");
+        free(workers);
+        free(a.due);
+        return -1;
+    }
+    pthread_mutex_init(&a.lock, NULL);
+    pthread_cond_init(&a.ready, NULL);
+
+    for (running = 0; running < num_threads; running++) {
+        workers[running].arrivals = &a;
+        workers[running].status = statuses[running];
+        workers[running].id = running;
+        workers[running].quiet = cfg->quiet;
+        if (pthread_create(&threads[running], NULL, open_loop_worker, &workers[running]) != 0) {
+            perror("Failed to create thread");
+            break;
+        }
+    }
+
+    // Schedule from the start time rather than the previous wake-up so a
+    // late dispatcher catches up instead of drifting
+    for (k = 0; running > 0; k++) {
+        struct timespec ts;
+
+        due = started + (uint64_t)(k * 1e9 / cfg->rate);
+        if (due >= deadline)
+            break;
+        ts.tv_sec  = due / 1000000000ull;
+        ts.tv_nsec = due % 1000000000ull;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+        if (arrivals_push(&a, due) != 0) {
+            perror("Failed to allocate memory");
+            break;
+        }
+    }
+    sum->issued = k;
+    sum->window = (due - started) / 1e9;
+
+    pthread_mutex_lock(&a.lock);
+    a.done = 1;
+    pthread_cond_broadcast(&a.ready);
+    pthread_mutex_unlock(&a.lock);
+
+    for (int i = 0; i < running; i++) {
+        pthread_join(threads[i], NULL);
+        sum->cycles += workers[i].completed;
+        sum->failed += workers[i].failed;
+        targets[statuses[i].target - cfg->targets].cycles += workers[i].completed;
+        targets[statuses[i].target - cfg->targets].failed += workers[i].failed;
+    }
+    sum->backlog_max = a.backlog_max;
+
+    pthread_cond_destroy(&a.ready);
+    pthread_mutex_destroy(&a.lock);
+    free(a.due);
+    free(workers);
+    return running > 0 ? 0 : -1;
+}
+
+// Persistent worker - runs jobs until the queue is shut down
+void* pool_worker(void* arg)
+{
+    JobQueue*     q = (JobQueue*)arg;
+    ThreadStatus* job;
+
+    for (;;) {
+        pthread_mutex_lock(&q->lock);
+        while (q->count == 0 && !q->shutdown)
+            pthread_cond_wait(&q->ready, &q->lock);
+        if (q->count == 0) {
+            pthread_mutex_unlock(&q->lock);
+            break;
+        }
+        job = q->jobs[q->head];
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+        pthread_mutex_unlock(&q->lock);
+
+        q->job(job);
+
+        pthread_mutex_lock(&q->lock);
+        if (--q->pending == 0)
+            pthread_cond_broadcast(&q->idle);
+        pthread_mutex_unlock(&q->lock);
+    }
+
+    return NULL;
+}
+
+// Percentiles reported for every phase
+static const double report_q[]     = { 0.50, 0.90, 0.99, 0.999 };
+static const char*  report_q_name[] = { "p50", "p90", "p99", "p99.9" };
+static const char*  report_q_key[]  = { "p50", "p90", "p99", "p999" };
+#define REPORT_Q (int)(sizeof(report_q) / sizeof(report_q[0]))
+
+void print_report(const RunSummary* sum, const PhaseStats* merged)
+{
+    printf(" INFO: Thread count: %d (%s, %s sessions)\n", sum->threads, sum->mode, sum->sessions);
+    printf(" INFO: Loops: %d  Cycles: %ld  Failed: %ld\n", sum->loops, sum->cycles, sum->failed);
+    printf(" INFO: Elapsed: %.3fs  Cycles/sec: %.1f\n", sum->elapsed, sum->elapsed > 0 ? sum->cycles / sum->elapsed : 0.0);
+    printf(" INFO: Environments: %s  Created: %ld (%.1f/sec)\n", sum->topology, sum->envs, sum->elapsed > 0 ? sum->envs / sum->elapsed : 0.0);
+    printf(" INFO: Sessions held: max %ld on %d threads  Virtual: peak %.1f MiB (+%.1f KiB per connection)\n",
+           sum->held_max, sum->os_threads, sum->vm_peak / 1048576.0, (sum->vm_peak - sum->vm_start) / 1024.0 / sum->threads);
+    printf(" INFO: RSS: start %.1f MiB  peak %.1f MiB  (+%.1f KiB per thread)\n", sum->rss_start / 1048576.0,
+           sum->rss_peak / 1048576.0, (sum->rss_peak - sum->rss_start) / 1024.0 / sum->threads);
+    if (sum->rate > 0) {
+        printf(" INFO: Open loop: requested %.1f/sec  issued %.1f/sec  completed %.1f/sec  max backlog %ld\n",
+               sum->rate, sum->window > 0 ? sum->issued / sum->window : 0.0,
+               sum->elapsed > 0 ? sum->cycles / sum->elapsed : 0.0, sum->backlog_max);
+        printf(" INFO: response is measured from the scheduled start, queue_wait is the part spent waiting for a worker\n");
+    }
+    if (sum->ramp) {
+        const Histogram* h = &merged->phase[PH_ALL_CONNECTED];
+        printf(" INFO: Ramp: %s  Connect attempts: %ld  Failed attempts: %ld  Gave up: %ld\n",
+               sum->ramp, sum->attempts, sum->failed_attempts, sum->gave_up);
+        if (h->count > 0)
+            printf(" INFO: Time to all connected: mean %.3fms  max %.3fms over %llu loops\n",
+                   h->sum / 1e6 / h->count, h->max / 1e6, (unsigned long long)h->count);
+        if (h->count < (uint64_t)sum->loops)
+            printf(" INFO: Loops that never had every thread connected: %llu of %d\n",
+                   (unsigned long long)(sum->loops - h->count), sum->loops);
+    }
+    if (sum->ops > 0) {
+        printf(" INFO: Workload: %s  %s: %ld  Per sec: %.1f\n", sum->workload, sum->stmt ? "Statements" : "Round trips",
+               sum->ops, sum->elapsed > 0 ? sum->ops / sum->elapsed : 0.0);
+        printf(" INFO: Per thread: min %ld  mean %.1f  max %ld  fairness (Jain) %.4f\n",
+               sum->ops_min, (double)sum->ops / sum->threads, sum->ops_max, sum->fairness);
+    }
+    if (sum->export) {
+        printf(" INFO: Export: %s  %s  Rows: %ld  Written: %.1f MiB  Truncated values: %ld\n", sum->export, sum->stmt,
+               sum->rows, sum->bytes / 1048576.0, sum->truncated);
+        printf(" INFO: MB/s: %.1f over the run, %.1f per thread while fetching  Peak RSS: %.1f MiB\n",
+               sum->elapsed > 0 ? sum->bytes / 1e6 / sum->elapsed : 0.0, sum->export_time > 0 ? sum->bytes / 1e6 / sum->export_time : 0.0,
+               sum->rss_peak / 1048576.0);
+    } else if (sum->stmt) {
+        printf(" INFO: Statements: %s  Rows: %ld  Rows/sec: %.1f  Rows/statement: %.1f\n", sum->stmt, sum->rows,
+               sum->elapsed > 0 ? sum->rows / sum->elapsed : 0.0, sum->ops > 0 ? (double)sum->rows / sum->ops : 0.0);
+        if (sum->round_trips >= 0)
+            printf(" INFO: SQL*Net round trips: %ld  per statement %.3f  per row %.4f\n", sum->round_trips,
+                   sum->ops > 0 ? (double)sum->round_trips / sum->ops : 0.0, sum->rows > 0 ? (double)sum->round_trips / sum->rows : 0.0);
+        else
+            printf(" INFO: SQL*Net round trips: not available (no access to v$mystat)\n");
+    }
+    if (sum->signals) {
+        printf(" INFO: Signals: %s  Injected: %ld (%.1f/sec)  Refused: %ld  Handled: %ld  Off the main thread: %ld\n",
+               sum->signals, sum->sig_sent, sum->elapsed > 0 ? sum->sig_sent / sum->elapsed : 0.0, sum->sig_refused,
+               sum->sig_handled, sum->sig_elsewhere);
+        if (sum->sig_handled > 0)
+            printf(" INFO: Handler latency: p50 %.1fus  p99 %.1fus  max %.1fus (from sigqueue(), within a factor of two)\n",
+                   sum->sig_p50, sum->sig_p99, sum->sig_max);
+    }
+    if (sum->soak) {
+        const MemTrend* t = &sum->trend;
+        printf(" INFO: Soak: %s  Samples: %d  Fitted: %d over %ld cycles  Leak: %s\n", sum->soak, t->samples,
+               t->fitted, t->cycles, t->fitted < 3 ? "not enough samples" : t->leak ? "YES" : "no");
+        if (t->fitted >= 3) {
+            printf("\n %-16s %12s %12s %8s %14s %5s\n", "GROWTH", "PER CYCLE", "+/- 2 SE", "R^2", "OVER FIT", "LEAK");
+            for (int m = 0; m < MEM_METRICS; m++)
+                printf(" %-16s %12.1f %12.1f %8.3f %14.0f %5s\n", mem_metric_name(m), t->m[m].slope, 2 * t->m[m].se,
+                       t->m[m].r2, t->m[m].growth, t->m[m].leak ? "YES" : "-");
+            printf(" (bytes, blocks for blocks; rss is VmRSS, arena and in_use come from mallinfo2, live and blocks\n"
+                   "  from the malloc interposer - a flagged slope is above the threshold by more than two SE)\n");
+        }
+    }
+    if (merged->alloc.envs > 0) {
+        const EnvAllocStats* a = &merged->alloc;
+        printf(" INFO: Env allocator: %s  Environments: %llu  Callbacks per env: %.1f alloc, %.1f free, %.1f realloc\n",
+               sum->env_alloc, (unsigned long long)a->envs, (double)a->allocs / a->envs,
+               (double)a->frees / a->envs, (double)a->reallocs / a->envs);
+        printf(" INFO: Bytes per env: %.0f requested, %.0f from malloc in %.1f calls, peak %lld, %.0f unfreed at teardown\n",
+               (double)a->bytes / a->envs, (double)a->reserved / a->envs, (double)a->blocks / a->envs,
+               (long long)a->peak, (double)a->live / a->envs);
+    }
+
+    if (sum->targets) {
+        // Same run, same clock: the targets only differ in where their slots connected
+        Phase op = sum->rate > 0 ? PH_RESPONSE : sum->export ? PH_EXPORT : sum->stmt ? PH_STATEMENT :
+                   strcmp(sum->workload, "ping") == 0 ? PH_PING : strcmp(sum->workload, "select") == 0 ? PH_SELECT : PH_CYCLE;
+
+        printf("\n %-20s %6s %7s %9s %7s %10s %10s %10s %10s %10s %10s\n", "TARGET", "WEIGHT", "THREADS", "CYCLES", "FAILED",
+               "CYCLES/S", "OPS/S", "CONN p50", "CONN p99", "OP p50", "OP p99");
+        for (int t = 0; t < sum->num_targets; t++) {
+            const TargetStats* ts = &sum->targets[t];
+            printf(" %-20s %6.1f %7d %9ld %7ld %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", ts->spec->dbname,
+                   ts->spec->weight, ts->threads, ts->cycles, ts->failed,
+                   sum->elapsed > 0 ? ts->cycles / sum->elapsed : 0.0, sum->elapsed > 0 ? ts->ops / sum->elapsed : 0.0,
+                   hist_percentile(&ts->stats.phase[PH_CONNECT], 0.50) / 1e3, hist_percentile(&ts->stats.phase[PH_CONNECT], 0.99) / 1e3,
+                   hist_percentile(&ts->stats.phase[op], 0.50) / 1e3, hist_percentile(&ts->stats.phase[op], 0.99) / 1e3);
+        }
+        printf(" (latencies in usec; OP is the %s phase)\n", phase_names[op]);
+    }
+
+    printf("\n %-16s %9s", "PHASE (usec)", "COUNT");
+    for (int q = 0; q < REPORT_Q; q++)
+        printf(" %10s", report_q_name[q]);
+    printf(" %10s\n", "max");
+
+    for (int p = 0; p < PH_COUNT; p++) {
+        const Histogram* h = &merged->phase[p];
+        if (h->count == 0)
+            continue;
+        printf(" %-16s %9llu", phase_names[p], (unsigned long long)h->count);
+        for (int q = 0; q < REPORT_Q; q++)
+            printf(" %10.1f", hist_percentile(h, report_q[q]) / 1e3);
+        printf(" %10.1f\n", h->max / 1e3);
+    }
+}
+
+#define REPORT_STR_RING 8       // report_str() results usable in one fprintf() call
+#define REPORT_STR_MAX  1024    // escaped bytes kept, longer values are cut short
+
+// A user supplied string (-D, -R, -Q, -F, -K, -M) made safe inside the
+// quotes of a JSON string or a CSV field; NULL reads as "".  Main thread
+// only: the result lives until REPORT_STR_RING more calls have been made
+static const char* report_str(const char* s, int json)
+{
+    static char     ring[REPORT_STR_RING][REPORT_STR_MAX];
+    static unsigned next;
+    char*           out = ring[next++ % REPORT_STR_RING];
+    size_t          n = 0;
+
+    for (; s && *s; s++) {
+        char esc[8];
+        int  len;
+
+        if (!json)
+            len = *s == '"' ? snprintf(esc, sizeof(esc), "\"\"") : snprintf(esc, sizeof(esc), "%c", *s);
+        else if (*s == '"' || *s == '\\')
+            len = snprintf(esc, sizeof(esc), "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            len = snprintf(esc, sizeof(esc), "\\u%04x", (unsigned char)*s);
+        else
+            len = snprintf(esc, sizeof(esc), "%c", *s);
+        if (n + len >= REPORT_STR_MAX)
+            break;
+        memcpy(out + n, esc, len);
+        n += len;
+    }
+    out[n] = '\0';
+    return out;
+}
+
+// Machine readable copy of the report; JSON for *.json, CSV otherwise
+int write_report(const char* path, const RunSummary* sum, const PhaseStats* merged)
+{
+    size_t len  = strlen(path);
+    int    json = len >= 5 && strcmp(path + len - 5, ".json") == 0;
+    int    first = 1;
+    FILE*  f;
+
+    if (!(f = fopen(path, "w"))) {
+        perror(path);
+        return -1;
+    }
+
+    if (json) {
+        fprintf(f, "{\n  \"mode\": \"%s\",\n  \"sessions\": \"%s\",\n", sum->mode, sum->sessions);
+        fprintf(f, "  \"threads\": %d,\n  \"loops\": %d,\n", sum->threads, sum->loops);
+        fprintf(f, "  \"cycles\": %ld,\n  \"failed\": %ld,\n  \"elapsed_sec\": %.6f,\n", sum->cycles, sum->failed, sum->elapsed);
+        fprintf(f, "  \"cycles_per_sec\": %.3f,\n  \"workload\": \"%s\",\n", sum->elapsed > 0 ? sum->cycles / sum->elapsed : 0.0, sum->workload);
+        fprintf(f, "  \"topology\": \"%s\",\n  \"envs\": %ld,\n  \"envs_per_sec\": %.3f,\n", sum->topology, sum->envs,
+                sum->elapsed > 0 ? sum->envs / sum->elapsed : 0.0);
+        fprintf(f, "  \"rss_start\": %ld,\n  \"rss_peak\": %ld,\n", sum->rss_start, sum->rss_peak);
+        fprintf(f, "  \"vm_start\": %ld,\n  \"vm_peak\": %ld,\n  \"sessions_held_max\": %ld,\n  \"os_threads\": %d,\n",
+                sum->vm_start, sum->vm_peak, sum->held_max, sum->os_threads);
+        if (sum->rate > 0)
+            fprintf(f, "  \"open_loop\": { \"requested_per_sec\": %.3f, \"issued\": %ld, \"issued_per_sec\": %.3f, \"backlog_max\": %ld },\n",
+                    sum->rate, sum->issued, sum->window > 0 ? sum->issued / sum->window : 0.0, sum->backlog_max);
+        if (sum->ramp) {
+            const Histogram* h = &merged->phase[PH_ALL_CONNECTED];
+            fprintf(f, "  \"ramp\": { \"spec\": \"%s\", \"attempts\": %ld, \"failed_attempts\": %ld, \"gave_up\": %ld,"
+                       " \"all_connected_loops\": %llu, \"all_connected_mean_ms\": %.3f, \"all_connected_max_ms\": %.3f },\n",
+                    report_str(sum->ramp, 1), sum->attempts, sum->failed_attempts, sum->gave_up, (unsigned long long)h->count,
+                    h->count ? h->sum / 1e6 / h->count : 0.0, h->max / 1e6);
+        }
+        if (sum->ops > 0) {
+            fprintf(f, "  \"ops\": %ld,\n  \"ops_per_sec\": %.3f,\n", sum->ops, sum->elapsed > 0 ? sum->ops / sum->elapsed : 0.0);
+            fprintf(f, "  \"ops_per_thread\": { \"min\": %ld, \"mean\": %.3f, \"max\": %ld, \"jain_fairness\": %.6f },\n",
+                    sum->ops_min, (double)sum->ops / sum->threads, sum->ops_max, sum->fairness);
+        }
+        if (sum->export)
+            fprintf(f, "  \"export\": { \"spec\": \"%s\", \"fetch\": \"%s\", \"rows\": %ld, \"bytes\": %ld, \"truncated\": %ld,"
+                       " \"mb_per_sec\": %.3f, \"mb_per_sec_per_thread\": %.3f },\n",
+                    report_str(sum->export, 1), report_str(sum->stmt, 1), sum->rows, sum->bytes, sum->truncated,
+                    sum->elapsed > 0 ? sum->bytes / 1e6 / sum->elapsed : 0.0, sum->export_time > 0 ? sum->bytes / 1e6 / sum->export_time : 0.0);
+        else if (sum->stmt)
+            fprintf(f, "  \"stmt\": { \"spec\": \"%s\", \"rows\": %ld, \"rows_per_sec\": %.3f, \"round_trips\": %ld,"
+                       " \"round_trips_per_op\": %.6f },\n",
+                    report_str(sum->stmt, 1), sum->rows, sum->elapsed > 0 ? sum->rows / sum->elapsed : 0.0, sum->round_trips,
+                    sum->ops > 0 && sum->round_trips >= 0 ? (double)sum->round_trips / sum->ops : -1.0);
+        if (sum->signals)
+            fprintf(f, "  \"signals\": { \"spec\": \"%s\", \"sent\": %ld, \"refused\": %ld, \"handled\": %ld,"
+                       " \"off_main_thread\": %ld, \"latency_p50_us\": %.3f, \"latency_p99_us\": %.3f, \"latency_max_us\": %.3f },\n",
+                    report_str(sum->signals, 1), sum->sig_sent, sum->sig_refused, sum->sig_handled, sum->sig_elsewhere,
+                    sum->sig_p50, sum->sig_p99, sum->sig_max);
+        if (sum->soak) {
+            const MemTrend* t = &sum->trend;
+            fprintf(f, "  \"soak\": { \"spec\": \"%s\", \"samples\": %d, \"fitted\": %d, \"cycles\": %ld, \"leak\": %s,\n",
+                    report_str(sum->soak, 1), t->samples, t->fitted, t->cycles, t->leak ? "true" : "false");
+            for (int m = 0; m < MEM_METRICS; m++)
+                fprintf(f, "            \"%s\": { \"per_cycle\": %.3f, \"se\": %.3f, \"r2\": %.6f, \"growth\": %.0f, \"leak\": %s }%s\n",
+                        mem_metric_name(m), t->m[m].slope, t->m[m].se, t->m[m].r2, t->m[m].growth,
+                        t->m[m].leak ? "true" : "false", m + 1 < MEM_METRICS ? "," : " },");
+        }
+        if (merged->alloc.envs > 0) {
+            const EnvAllocStats* a = &merged->alloc;
+            fprintf(f, "  \"env_alloc\": { \"kind\": \"%s\", \"envs\": %llu, \"allocs\": %llu, \"frees\": %llu, \"reallocs\": %llu,\n",
+                    sum->env_alloc, (unsigned long long)a->envs, (unsigned long long)a->allocs,
+                    (unsigned long long)a->frees, (unsigned long long)a->reallocs);
+            fprintf(f, "                 \"bytes\": %llu, \"peak\": %lld, \"unfreed\": %lld, \"blocks\": %llu, \"reserved\": %llu },\n",
+                    (unsigned long long)a->bytes, (long long)a->peak, (long long)a->live,
+                    (unsigned long long)a->blocks, (unsigned long long)a->reserved);
+        }
+        if (sum->targets) {
+            fprintf(f, "  \"targets\": [");
+            for (int t = 0; t < sum->num_targets; t++) {
+                const TargetStats* ts = &sum->targets[t];
+                fprintf(f, "%s\n    { \"dbname\": \"%s\", \"weight\": %.3f, \"threads\": %d, \"cycles\": %ld, \"failed\": %ld,"
+                           " \"cycles_per_sec\": %.3f, \"ops\": %ld, \"ops_per_sec\": %.3f,\n      \"phases\": {",
+                        t ? "," : "", report_str(ts->spec->dbname, 1), ts->spec->weight, ts->threads, ts->cycles, ts->failed,
+                        sum->elapsed > 0 ? ts->cycles / sum->elapsed : 0.0, ts->ops, sum->elapsed > 0 ? ts->ops / sum->elapsed : 0.0);
+                first = 1;
+                for (int p = 0; p < PH_COUNT; p++) {
+                    const Histogram* h = &ts->stats.phase[p];
+                    if (h->count == 0)
+                        continue;
+                    fprintf(f, "%s\n        \"%s\": { \"count\": %llu, \"mean_us\": %.3f", first ? "" : ",", phase_names[p],
+                            (unsigned long long)h->count, h->sum / 1e3 / h->count);
+                    for (int q = 0; q < REPORT_Q; q++)
+                        fprintf(f, ", \"%s_us\": %.3f", report_q_key[q], hist_percentile(h, report_q[q]) / 1e3);
+                    fprintf(f, ", \"max_us\": %.3f }", h->max / 1e3);
+                    first = 0;
+                }
+                fprintf(f, "%s} }", first ? "" : "\n      ");
+            }
+            fprintf(f, "\n  ],\n");
+            first = 1;
+        }
+        fprintf(f, "  \"phases\": [");
+    } else {
+        fprintf(f, "phase,count,mean_us");
+        for (int q = 0; q < REPORT_Q; q++)
+            fprintf(f, ",%s_us", report_q_key[q]);
+        fprintf(f, ",max_us\n");
+    }
+
+    for (int p = 0; p < PH_COUNT; p++) {
+        const Histogram* h = &merged->phase[p];
+        if (h->count == 0)
+            continue;
+        if (json) {
+            fprintf(f, "%s\n    { \"phase\": \"%s\", \"count\": %llu, \"mean_us\": %.3f",
+                    first ? "" : ",", phase_names[p], (unsigned long long)h->count, h->sum / 1e3 / h->count);
+            for (int q = 0; q < REPORT_Q; q++)
+                fprintf(f, ", \"%s_us\": %.3f", report_q_key[q], hist_percentile(h, report_q[q]) / 1e3);
+            fprintf(f, ", \"max_us\": %.3f }", h->max / 1e3);
+        } else {
+            fprintf(f, "%s,%llu,%.3f", phase_names[p], (unsigned long long)h->count, h->sum / 1e3 / h->count);
+            for (int q = 0; q < REPORT_Q; q++)
+                fprintf(f, ",%.3f", hist_percentile(h, report_q[q]) / 1e3);
+            fprintf(f, ",%.3f\n", h->max / 1e3);
+        }
+        first = 0;
+    }
+
+    if (json)
+        fprintf(f, "\n  ]\n}\n");
+    return fclose(f);
+}
+
+void usage(const char* prog)
+{
+    fprintf(stderr, "Usage: %s [-t threads] [-l loops] [-d seconds] [-w] [-q] [-m dedicated|pool] [-n min,max,incr]\n"
+                    "          [-W cycle|ping|select|stmt|export] [-A none|malloc|arena|pool] [-e two|one|shared] [-r rate] [-R ramp] [-i seconds] [-L loops]\n"
+                    "          [-Q statement settings] [-S sql-mix-file] [-F export-file] [-K signals] [-M soak] [-D dbname[,weight=N]]\n"
+                    "          [-o report.json|report.csv]\n", prog);
+    fprintf(stderr, "  -t threads   connections per loop (default 1); a list such as 1,8,64 or a doubling\n");
+    fprintf(stderr, "               range such as 1-256 runs once per entry and prints a sweep table\n");
+    fprintf(stderr, "  -l loops     number of loops, 0 = until -d expires (default %d)\n", DEFAULT_LOOPS);
+    fprintf(stderr, "  -d seconds   stop starting new loops after this long\n");
+    fprintf(stderr, "  -w           run loops on a persistent worker pool fed from a job queue\n");
+    fprintf(stderr, "               instead of creating and joining threads every loop\n");
+    fprintf(stderr, "  -q           only report failed connections\n");
+    fprintf(stderr, "  -m mode      dedicated: every connection logs in with its own environments (default)\n");
+    fprintf(stderr, "               pool: connections borrow sessions from one shared OCI session pool\n");
+    fprintf(stderr, "  -n min,max,incr  session pool sizing (default 1,<threads>,1)\n");
+    fprintf(stderr, "  -W workload  cycle: connect, ping once, disconnect every loop (default)\n");
+    fprintf(stderr, "               ping: each thread logs in once and pings back to back for -d seconds (default 10)\n");
+    fprintf(stderr, "               select: as ping, but runs SELECT 1 FROM DUAL\n");
+    fprintf(stderr, "               stmt: as ping, but runs the -S statement mix with the -Q settings\n");
+    fprintf(stderr, "               export: each thread logs in and streams the first -S query (default: a million\n");
+    fprintf(stderr, "               rows from DUAL) once into the -F file through dynamic defines; -Q array= and\n");
+    fprintf(stderr, "               prefetch= apply (default array=1000,prefetch=1000)\n");
+    fprintf(stderr, "  -A alloc     memory callbacks for every OCIEnvNlsCreate: none (default), malloc (counted),\n");
+    fprintf(stderr, "               arena (bump allocation, released with the env) or pool (size-class free lists)\n");
+    fprintf(stderr, "  -e envs      environments behind a dedicated connection: two (OCI_DEFAULT + OCI_THREADED\n");
+    fprintf(stderr, "               per connection, as DBD::Oracle - default), one (OCI_THREADED per connection)\n");
+    fprintf(stderr, "               or shared (one OCI_THREADED environment for the whole process)\n");
+    fprintf(stderr, "  -L loops     -W ping only: drive the -t sessions from this many threads, each multiplexing\n");
+    fprintf(stderr, "               its share in OCI non-blocking mode, instead of one blocked thread per session\n");
+    fprintf(stderr, "  -i seconds   print ops/sec, errors and in-flight operations every interval while the\n");
+    fprintf(stderr, "               run is going; errors are streamed as they happen instead of after each join\n");
+    fprintf(stderr, "  -o file      also write the per-phase latency report as JSON (*.json) or CSV;\n");
+    fprintf(stderr, "               with a -t, -r, -R, -Q or -K sweep, the sweep table\n");
+    fprintf(stderr, "  -r rate      open loop: start cycles at this many per second on a fixed schedule for -d\n");
+    fprintf(stderr, "               seconds (default 10) using -t workers; latency counts from the scheduled start.\n");
+    fprintf(stderr, "               A list or doubling range such as 50-3200 sweeps the rate\n");
+    fprintf(stderr, "  -R ramp      pace logins through a token bucket: profile[,rate=N][,burst=N][,step=sec]\n");
+    fprintf(stderr, "               [,retries=N][,backoff=msec]; profile is burst (no pacing), bucket (constant\n");
+    fprintf(stderr, "               rate), linear (rate grows by rate per step) or exp (rate doubles per step).\n");
+    fprintf(stderr, "               Defaults rate=10 burst=1 step=1 retries=3 backoff=10; failed logins retry after\n");
+    fprintf(stderr, "               a random wait of up to backoff*2^attempt.  Repeat -R to compare profiles\n");
+    fprintf(stderr, "  -Q settings  -W stmt: [cache=N][,prefetch=rows][,prefmem=bytes][,array=rows] - statement cache\n");
+    fprintf(stderr, "               size, OCI_ATTR_PREFETCH_ROWS/MEMORY and rows per bind/define array (default\n");
+    fprintf(stderr, "               cache=20,prefetch=1,prefmem=0,array=1).  Repeat -Q to compare settings\n");
+    fprintf(stderr, "  -S file      -W stmt: statement mix, one \"[weight] SQL\" per line (default: three queries\n");
+    fprintf(stderr, "               on DUAL of 1, 100 and 1000 rows).  Queries are fetched an array at a time;\n");
+    fprintf(stderr, "               DML runs once per array with :1 bound to a running number, other binds to text\n");
+    fprintf(stderr, "  -F path[,layout=prefixed|columnar][,width=bytes]  -W export output, path.N per thread with\n");
+    fprintf(stderr, "               several.  Rows are fetched straight into the pages of the memory-mapped file:\n");
+    fprintf(stderr, "               prefixed writes a 4 byte length before every value (default), columnar a block\n");
+    fprintf(stderr, "               per fetch with fixed width slots (default width=64, longer values truncated)\n");
+    fprintf(stderr, "  -K mode[,rate=N]  signal handling for the run: async (a plain handler on whatever thread the\n");
+    fprintf(stderr, "               kernel picks, OCI threads included) or route (asynchronous signals blocked in\n");
+    fprintf(stderr, "               every thread and read from a signalfd by one handler thread).  rate= injects\n");
+    fprintf(stderr, "               that many queued signals per second and reports their handler latency.\n");
+    fprintf(stderr, "               Repeat -K to compare, e.g. -K async,rate=20000 -K route,rate=20000\n");
+    fprintf(stderr, "  -M every[,warmup=cycles][,leak=bytes][,file=path]  soak: sample RSS, mallinfo2 and malloc counts\n");
+    fprintf(stderr, "               after every that many connect cycles (-W cycle, closed loop), fit the growth per\n");
+    fprintf(stderr, "               cycle past the warm-up (default the first 10%%) and flag a leak when it exceeds\n");
+    fprintf(stderr, "               leak bytes (default %d) per cycle; file= writes the samples as CSV.  For hours:\n", SOAK_LEAK);
+    fprintf(stderr, "               -l 0 -d 14400 -q -M 1000,file=soak.csv\n");
+    fprintf(stderr, "  -D dbname[,weight=N]  connect to this database instead of ORA_DBNAME.  Repeat -D to spread the\n");
+    fprintf(stderr, "               -t slots over several in proportion to their weights (default 1), interleaved,\n");
+    fprintf(stderr, "               and report each target's share of the run side by side, e.g.\n");
+    fprintf(stderr, "               -t 8 -D ORA19C,weight=3 -D ORA21CPDB; -m pool creates a session pool per target\n");
+}
+
+// Resident set size (VmRSS) or its high-water mark (VmHWM) in bytes
+long proc_rss(const char* key)
+{
+    char  line[128];
+    long  kb = 0;
+    size_t len = strlen(key);
+    FILE* f = fopen("/proc/self/status", "r");
+
+    if (!f)
+        return 0;
+    while (fgets(line, sizeof(line), f))
+        if (strncmp(line, key, len) == 0 && line[len] == ':') {
+            kb = atol(line + len + 1);
+            break;
+        }
+    fclose(f);
+    return kb * 1024;
+}
+
+// Restart VmHWM from the current RSS so each run of a sweep gets its own peak
+void reset_peak_rss(void)
+{
+    FILE* f = fopen("/proc/self/clear_refs", "w");
+
+    if (f) {
+        fputs("5", f);
+        fclose(f);
+    }
+}
+
+// Fresh status for one connection slot
+void status_init(ThreadStatus* st, const Config* cfg, PhaseStats* stats, SessionPool* pool, const TargetSpec* target,
+                 OCIEnv* shared_env, Ramp* ramp, LiveSlot* live, int slot, int threads, uint64_t deadline)
+{
+    memset(st, 0, sizeof(ThreadStatus));
+    st->stats = stats;
+    st->pool = pool;
+    st->target = target;
+    st->deadline = deadline;
+    st->use_select = strcmp(cfg->workload, "select") == 0;
+    st->env_alloc = cfg->env_alloc;
+    st->topology = cfg->topology;
+    st->shared_env = shared_env;
+    st->ramp = ramp;
+    st->live = live;
+    st->stmt = cfg->stmt;
+    st->mix = cfg->mix;
+    st->export = cfg->export;
+    st->slot = slot;
+    st->threads = threads;
+}
+
+// -M: take and print one sample; NULL when out of memory
+static const MemSample* soak_sample(MemTrack* mt, long cycles)
+{
+    const MemSample* s = mem_track_sample(mt, cycles);
+
+    if (!s) {
+        perror("Failed to allocate memory");
+        return NULL;
+    }
+    printf(" SOAK: cycles %ld  %.0fs  RSS %.2f MiB  arena %.2f MiB  in use %.2f MiB  live %.2f MiB  blocks %.0f\n",
+           s->cycles, s->elapsed, s->v[MEM_RSS] / 1048576.0, s->v[MEM_ARENA] / 1048576.0, s->v[MEM_IN_USE] / 1048576.0,
+           s->v[MEM_LIVE] / 1048576.0, s->v[MEM_BLOCKS]);
+    return s;
+}
+
+// -D: deal the slots out by weight, smooth weighted round robin style - each
+// slot goes to the target furthest behind its share, so 3:1 runs A A B A A A B A
+// and any prefix of the slots (an event loop's share, a short sweep run) is mixed
+static void assign_targets(const Config* cfg, int num_threads, int* slot_target, TargetStats* targets)
+{
+    double credit[cfg->num_targets];
+    double total = 0;
+
+    for (int t = 0; t < cfg->num_targets; t++) {
+        credit[t] = 0;
+        total += cfg->targets[t].weight;
+    }
+    for (int i = 0; i < num_threads; i++) {
+        int best = 0;
+        for (int t = 0; t < cfg->num_targets; t++) {
+            credit[t] += cfg->targets[t].weight;
+            if (credit[t] > credit[best])
+                best = t;
+        }
+        credit[best] -= total;
+        slot_target[i] = best;
+        targets[best].threads++;
+    }
+}
+
+// One run at num_threads: fills sum, merged and the per -D totals in targets; -1 if it could not start
+int run_benchmark(const Config* cfg, int num_threads, RunSummary* sum, PhaseStats* merged, TargetStats* targets)
+{
+    SessionPool* pools = calloc(cfg->num_targets, sizeof(SessionPool));
+    OCIEnv*     shared_env = NULL;
+    EnvAlloc*   shared_alloc = NULL;
+    EnvAllocStats pool_alloc = { 0 };
+    Ramp        ramp = { cfg->ramp };
+    LiveStats*  live = NULL;
+    SigRoute*   route = NULL;
+    SigStats    sig = { 0 };
+    MemTrack*   soak = NULL;
+    MemTrend    trend = { 0 };
+    long        next_sample = 0;
+    long        envs = 0;
+
+    reset_peak_rss();
+    long rss_start = proc_rss("VmRSS");
+    long vm_start = proc_rss("VmSize");
+    int  ev_loops = cfg->ev_loops < num_threads ? cfg->ev_loops : num_threads;
+
+    sessions_held = sessions_held_max = 0;
+
+    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    ThreadStatus* statuses = aligned_alloc(LIVE_CACHE_LINE, num_threads * sizeof(ThreadStatus));
+    PhaseStats* stats = calloc(num_threads, sizeof(PhaseStats));
+    int* slot_target = malloc(num_threads * sizeof(int));
+
+    if (!pools || !threads || !statuses || !stats || !slot_target) {
+        perror("Failed to allocate memory");
+        free(pools);
+        free(threads);
+        free(statuses);
+        free(stats);
+        free(slot_target);
+        return -1;
+    }
+
+    for (int t = 0; t < cfg->num_targets; t++)
+        targets[t].spec = &cfg->targets[t];
+    assign_targets(cfg, num_threads, slot_target, targets);
+
+    pthread_mutex_init(&ramp.lock, NULL);
+
+    void*  (*job)(void*) = cfg->export ? db_export_function : cfg->stmt ? db_stmt_function :
+                           cfg->steady ? db_ping_function : db_thread_function;
+    JobQueue queue;
+    int      workers = 0;
+    int      rc = -1;
+
+    // Ahead of every other thread of the run, the session pool's included, so they all inherit the mask
+    if (cfg->signals && !(route = sig_route_start(cfg->signals->mode, cfg->signals->rate))) {
+        perror("Failed to set up signal handling");
+        goto out;
+    }
+
+    if (cfg->session_pool) {
+        // A pool is bound to one database: one per -D target, sized for its slots
+        for (int t = 0; t < cfg->num_targets; t++) {
+            SessionPool* pool = &pools[t];
+            uint64_t     t0 = now_ns();
+
+            if (targets[t].threads == 0)
+                continue;
+            pool->min  = cfg->pool_min;
+            pool->max  = cfg->pool_max ? cfg->pool_max : (ub4)targets[t].threads;
+            pool->incr = cfg->pool_incr ? cfg->pool_incr : 1;
+            if (pool->min == 0)
+                pool->min = 1;
+            if (pool->min > pool->max)
+                pool->min = pool->max;
+            if (session_pool_create(pool, cfg->env_alloc, cfg->schema, cfg->passwd, cfg->targets[t].dbname) != 0)
+                goto out;
+            envs++;
+            printf(" INFO: Session pool %.*s on %s min %u max %u incr %u created in %.3fms\n", (int)pool->name_len, pool->name,
+                   cfg->targets[t].dbname, pool->min, pool->max, pool->incr, (now_ns() - t0) / 1e6);
+        }
+    } else if (cfg->topology == TOPO_SHARED) {
+        shared_alloc = env_alloc_create(cfg->env_alloc);
+        if (OCIEnvNlsCreate(&shared_env, OCI_THREADED, ENV_ALLOC_CALLBACKS(shared_alloc), 0, NULL, 0, 0) != OCI_SUCCESS) {
+            fprintf(stderr, "Error: Failed to initialize OCI (shared) environment\n");
+            env_alloc_destroy(shared_alloc, NULL);
+            goto out;
+        }
+        envs++;
+    }
+
+    if (cfg->live_interval > 0) {
+        if (!(live = live_stats_create(num_threads, cfg->live_interval)) || live_stats_start(live) != 0) {
+            perror("Failed to start the live reporter");
+            goto out;
+        }
+    }
+
+    if (cfg->use_pool) {
+        if (job_queue_init(&queue, num_threads, job) != 0) {
+            perror("Failed to allocate memory");
+            goto out;
+        }
+
+        // Start the persistent workers once; every loop reuses them
+        for (workers = 0; workers < num_threads; workers++) {
+            if (pthread_create(&threads[workers], NULL, pool_worker, &queue) != 0) {
+                perror("Failed to create thread");
+                break;
+            }
+        }
+        if (workers == 0) {
+            job_queue_destroy(&queue);
+            goto out;
+        }
+    }
+
+    // Baseline once everything that lives for the whole run is set up
+    if (cfg->soak) {
+        if (!(soak = mem_track_create(cfg->soak))) {
+            perror(cfg->soak->path ? cfg->soak->path : "Failed to allocate memory");
+            goto out;
+        }
+        soak_sample(soak, 0);
+        next_sample = cfg->soak->every;
+    }
+
+    uint64_t started = now_ns();
+    uint64_t deadline = cfg->duration > 0 ? started + (uint64_t)(cfg->duration * 1e9) : 0;
+    long     cycles = 0;
+    long     failed = 0;
+    long     ops = 0, ops_min = -1, ops_max = 0;
+    long     rows = 0, round_trips = 0, bytes = 0, truncated = 0;
+    double   ops_sq = 0;
+    int      l;
+
+    RunSummary open = { 0 };
+
+    if (cfg->rate > 0) {
+        // Open loop: one long run of -t workers fed on a fixed schedule
+        for (int i = 0; i < num_threads; i++)
+            status_init(&statuses[i], cfg, &stats[i], cfg->session_pool ? &pools[slot_target[i]] : NULL,
+                        &cfg->targets[slot_target[i]], shared_env, cfg->ramp ? &ramp : NULL,
+                        live_stats_slot(live, i), i, num_threads, deadline);
+        if (open_loop_run(cfg, num_threads, statuses, threads, started, deadline, &open, targets) != 0)
+            goto out;
+        cycles = open.cycles;
+        failed = open.failed;
+        l = 2;
+    } else {
+        for ( l = 1 ; cfg->num_loops == 0 || l <= cfg->num_loops ; l ++ )
+        {
+            if (deadline && now_ns() >= deadline)
+                break;
+
+            for (int i = 0; i < num_threads; i++)
+                status_init(&statuses[i], cfg, &stats[i], cfg->session_pool ? &pools[slot_target[i]] : NULL,
+                            &cfg->targets[slot_target[i]], shared_env, cfg->ramp ? &ramp : NULL,
+                            live_stats_slot(live, i), i, num_threads, deadline);
+
+            if (cfg->ramp)
+                ramp_reset(&ramp);
+
+            if (cfg->use_pool) {
+                // Hand this loop's connections to the pool and wait for them all
+                for (int i = 0; i < num_threads; i++)
+                    job_queue_push(&queue, &statuses[i]);
+                job_queue_wait_idle(&queue);
+            } else if (ev_loops) {
+                // Split the connections evenly over the event loops
+                EvLoop ev[ev_loops];
+                int    started_loops;
+
+                for (started_loops = 0; started_loops < ev_loops; started_loops++) {
+                    int first = (int)((long)num_threads * started_loops / ev_loops);
+                    ev[started_loops].statuses = &statuses[first];
+                    ev[started_loops].count = (int)((long)num_threads * (started_loops + 1) / ev_loops) - first;
+                    if (pthread_create(&threads[started_loops], NULL, event_loop_function, &ev[started_loops]) != 0) {
+                        perror("Failed to create thread");
+                        break;
+                    }
+                }
+                for (int i = 0; i < started_loops; i++)
+                    pthread_join(threads[i], NULL);
+            } else {
+                // Create threads
+                for (int i = 0; i < num_threads; i++) {
+                    if (pthread_create(&threads[i], NULL, job, &statuses[i]) != 0) {
+                        perror("Failed to create thread");
+                        num_threads = i; // Adjust the number of threads to join
+                        break;
+                    }
+                }
+
+                // Wait for threads to complete
+                for (int i = 0; i < num_threads; i++)
+                    pthread_join(threads[i], NULL);
+            }
+
+            // A loop counts as warmed up when its last thread got a session; one
+            // where a thread gave up never was, and is only counted in the report
+            if (cfg->ramp && ramp.connected == num_threads)
+                hist_record(&stats[0].phase[PH_ALL_CONNECTED], ramp.last_connected - ramp.started);
+
+            for (int i = 0; i < num_threads; i++) {
+                int ok = statuses[i].connection_status == 0 && statuses[i].ping_status == 0;
+                TargetStats* ts = &targets[slot_target[i]];
+                cycles++;
+                failed += !ok;
+                ts->cycles++;
+                ts->failed += !ok;
+                ts->ops += statuses[i].ops;
+                ops += statuses[i].ops;
+                ops_sq += (double)statuses[i].ops * statuses[i].ops;
+                if (ops_min < 0 || statuses[i].ops < ops_min)
+                    ops_min = statuses[i].ops;
+                if (statuses[i].ops > ops_max)
+                    ops_max = statuses[i].ops;
+                rows += statuses[i].rows;
+                if (round_trips >= 0)
+                    round_trips = statuses[i].round_trips < 0 ? -1 : round_trips + statuses[i].round_trips;
+                bytes += (long)statuses[i].exported.bytes;
+                truncated += (long)statuses[i].exported.truncated;
+                if ((ok && cfg->quiet) || live)
+                    continue;
+                printf(" INFO: LOOP %d Thread %d", l, i + 1);
+                if (ok) {
+                    printf(" Database connection and ping successful.\n");
+                } else {
+                    printf(" Error: %s\n", statuses[i].error_message);
+                }
+            }
+
+            // Between loops no session is open, so what is still held was kept
+            // Out of memory for samples ends the run, the fit uses what there is
+            if (soak && cycles >= next_sample) {
+                if (!soak_sample(soak, cycles))
+                    break;
+                next_sample = cycles + cfg->soak->every;
+            }
+        }
+
+        // The tail of the run, when it ended between two samples
+        if (soak && cycles > next_sample - cfg->soak->every)
+            soak_sample(soak, cycles);
+    }
+
+    double elapsed = (now_ns() - started) / 1e9;
+    live_stats_stop(live);
+    long   rss_peak = proc_rss("VmHWM");
+
+    for (int t = 0; cfg->session_pool && t < cfg->num_targets; t++) {
+        ub4 open_count = 0;
+        if (!pools[t].name)
+            continue;
+        OCIAttrGet(pools[t].spoolhp, OCI_HTYPE_SPOOL, &open_count, NULL, OCI_ATTR_SPOOL_OPEN_COUNT, pools[t].errhp);
+        printf(" INFO: Session pool on %s held %u open sessions at the end of the run\n", cfg->targets[t].dbname, open_count);
+    }
+
+    if (cfg->use_pool) {
+        job_queue_shutdown(&queue);
+        for (int i = 0; i < workers; i++)
+            pthread_join(threads[i], NULL);
+        job_queue_destroy(&queue);
+    }
+
+    sig_route_stop(route, &sig);
+    route = NULL;
+
+    if (soak)
+        mem_track_fit(soak, &trend);
+
+    // Merge the per-slot histograms, overall and per target
+    for (int i = 0; i < num_threads; i++) {
+        PhaseStats* ts = &targets[slot_target[i]].stats;
+        for (int p = 0; p < PH_COUNT; p++) {
+            hist_merge(&merged->phase[p], &stats[i].phase[p]);
+            hist_merge(&ts->phase[p], &stats[i].phase[p]);
+        }
+        env_alloc_stats_merge(&merged->alloc, &stats[i].alloc);
+        env_alloc_stats_merge(&ts->alloc, &stats[i].alloc);
+    }
+    envs += merged->phase[PH_ENV_MNG].count + merged->phase[PH_ENV].count;
+
+    RunSummary summary = { cfg->use_pool ? "persistent workers" : "spawn per loop", cfg->session_pool ? "pooled" : "dedicated",
+                           num_threads, l - 1, cycles, failed, elapsed, cfg->workload,
+                           env_alloc_name(cfg->env_alloc), cfg->session_pool ? "pool" : topology_names[cfg->topology],
+                           envs, rss_start, rss_peak, vm_start, proc_rss("VmPeak"), sessions_held_max,
+                           cfg->use_pool ? workers : ev_loops ? ev_loops : num_threads, cfg->rate, open.issued, open.window, open.backlog_max,
+                           cfg->ramp ? cfg->ramp->spec : NULL, ramp.attempts, ramp.failed_attempts, ramp.gave_up,
+                           ops, ops_min, ops_max, ops_sq > 0 ? (double)ops * ops / (num_threads * ops_sq) : 0.0,
+                           cfg->stmt ? cfg->stmt->spec : NULL, rows, round_trips,
+                           cfg->export ? cfg->export->spec : NULL, bytes, truncated,
+                           merged->phase[PH_EXPORT].sum / 1e9,
+                           cfg->signals ? cfg->signals->spec : NULL, (long)sig.sent, (long)sig.refused,
+                           (long)sig.handled, (long)sig.elsewhere, sig_stats_percentile(&sig, 0.50) / 1e3,
+                           sig_stats_percentile(&sig, 0.99) / 1e3, sig.lat_max / 1e3,
+                           cfg->soak ? cfg->soak->spec : NULL, trend,
+                           cfg->num_targets > 1 ? targets : NULL, cfg->num_targets };
+    if (cfg->rate > 0)
+        summary.mode = "open loop";
+    if (ev_loops)
+        summary.mode = "non-blocking event loop";
+    *sum = summary;
+    rc = 0;
+
+out:
+    sig_route_stop(route, NULL);
+    mem_track_destroy(soak);
+
+    // The shared/pool environment's allocator counters go into the totals with the rest
+    for (int t = 0; cfg->session_pool && t < cfg->num_targets; t++)
+        session_pool_destroy(&pools[t], &pool_alloc);
+    if (shared_env)
+        OCIHandleFree(shared_env, OCI_HTYPE_ENV);
+    env_alloc_destroy(shared_alloc, &pool_alloc);
+    env_alloc_stats_merge(&merged->alloc, &pool_alloc);
+
+    live_stats_destroy(live);
+    pthread_mutex_destroy(&ramp.lock);
+    free(pools);
+    free(threads);
+    free(statuses);
+    free(stats);
+    free(slot_target);
+
+    return rc;
+}
+
+// One row of the -t sweep table
+typedef struct {
+    RunSummary sum;
+    double     env_p50, env_p99;        // usec, OCI_THREADED env creation
+    double     connect_p50, connect_p99;
+    double     resp_p50, resp_p99;      // -r, from the scheduled start
+    double     all_conn_mean, all_conn_max; // -R, msec
+    double     stmt_p50, stmt_p99;      // -W stmt, whole statements
+    double     fetch_p50, fetch_p99;    // -W export, one fetch array
+} SweepRow;
+
+void print_sweep(const SweepRow* rows, int n)
+{
+    int open = rows[0].sum.rate > 0;
+    int ramp = rows[0].sum.ramp != NULL;
+    int export = rows[0].sum.export != NULL;
+    int stmt = rows[0].sum.stmt != NULL && !export;
+    int sig = rows[0].sum.signals != NULL;
+    int soak = rows[0].sum.soak != NULL;
+
+    printf("\n %7s", "THREADS");
+    if (open)
+        printf(" %9s", "RATE");
+    printf(" %10s %8s %9s %9s %9s %10s %10s", "CYCLES/S", "ENVS", "ENVS/S",
+           "ENV p50", "ENV p99", "CONN p50", "CONN p99");
+    if (open)
+        printf(" %10s %10s %8s", "RESP p50", "RESP p99", "BACKLOG");
+    if (ramp)
+        printf(" %8s %8s %6s %10s %10s", "ATTEMPTS", "RETRIED", "GAVEUP", "ALL mean", "ALL max");
+    if (stmt)
+        printf(" %10s %11s %8s %10s %10s", "STMTS/S", "ROWS/S", "RT/STMT", "STMT p50", "STMT p99");
+    if (export)
+        printf(" %11s %9s %9s %10s %10s", "ROWS/S", "MiB", "MB/S/THR", "FETCH p50", "FETCH p99");
+    if (sig)
+        printf(" %10s %9s %9s %9s %9s %8s", "OPS/S", "SIG/S", "SIG p50", "SIG p99", "SIG max", "REFUSED");
+    if (soak)
+        printf(" %10s %10s %10s %5s", "RSS B/C", "LIVE B/C", "BLOCKS/C", "LEAK");
+    printf(" %6s %6s", "HELD", "OS THR");
+    printf(" %9s %10s %7s%s%s%s\n", "RSS MiB", "KiB/THR", "FAILED", ramp ? "  RAMP" : "", stmt || export ? "  STATEMENTS" : "",
+           sig ? "  SIGNALS" : "");
+    for (int i = 0; i < n; i++) {
+        const RunSummary* s = &rows[i].sum;
+        printf(" %7d", s->threads);
+        if (open)
+            printf(" %9.1f", s->rate);
+        printf(" %10.1f %8ld %9.1f %9.1f %9.1f %10.1f %10.1f",
+               s->elapsed > 0 ? s->cycles / s->elapsed : 0.0, s->envs, s->elapsed > 0 ? s->envs / s->elapsed : 0.0,
+               rows[i].env_p50, rows[i].env_p99, rows[i].connect_p50, rows[i].connect_p99);
+        if (open)
+            printf(" %10.1f %10.1f %8ld", rows[i].resp_p50, rows[i].resp_p99, s->backlog_max);
+        if (ramp)
+            printf(" %8ld %8ld %6ld %10.1f %10.1f", s->attempts, s->failed_attempts, s->gave_up,
+                   rows[i].all_conn_mean, rows[i].all_conn_max);
+        if (stmt)
+            printf(" %10.1f %11.1f %8.3f %10.1f %10.1f", s->elapsed > 0 ? s->ops / s->elapsed : 0.0,
+                   s->elapsed > 0 ? s->rows / s->elapsed : 0.0, s->round_trips >= 0 && s->ops > 0 ? (double)s->round_trips / s->ops : -1.0,
+                   rows[i].stmt_p50, rows[i].stmt_p99);
+        if (export)
+            printf(" %11.1f %9.1f %9.1f %10.1f %10.1f", s->elapsed > 0 ? s->rows / s->elapsed : 0.0, s->bytes / 1048576.0,
+                   s->export_time > 0 ? s->bytes / 1e6 / s->export_time : 0.0, rows[i].fetch_p50, rows[i].fetch_p99);
+        if (sig)
+            printf(" %10.1f %9.1f %9.1f %9.1f %9.1f %8ld", s->elapsed > 0 ? s->ops / s->elapsed : 0.0,
+                   s->elapsed > 0 ? s->sig_sent / s->elapsed : 0.0, s->sig_p50, s->sig_p99, s->sig_max, s->sig_refused);
+        if (soak)
+            printf(" %10.1f %10.1f %10.3f %5s", s->trend.m[MEM_RSS].slope, s->trend.m[MEM_LIVE].slope,
+                   s->trend.m[MEM_BLOCKS].slope, s->trend.fitted < 3 ? "?" : s->trend.leak ? "YES" : "-");
+        printf(" %6ld %6d", s->held_max, s->os_threads);
+        printf(" %9.1f %10.1f %7ld", s->rss_peak / 1048576.0, (s->rss_peak - s->rss_start) / 1024.0 / s->threads, s->failed);
+        if (ramp)
+            printf("  %s", s->ramp);
+        if (stmt || export)
+            printf("  %s", s->stmt);
+        if (sig)
+            printf("  %s", s->signals);
+        printf("\n");
+    }
+    if (stmt)
+        printf(" (RT/STMT = SQL*Net round trips per statement, -1 without access to v$mystat)\n");
+    if (soak)
+        printf(" (B/C = bytes of growth per connect cycle, fitted after the warm-up; ? = too few samples)\n");
+    printf(" (latencies in usec, ALL = time to all connected in msec; RSS is the peak of each run)\n");
+}
+
+// Sweep table as JSON (*.json) or CSV
+int write_sweep(const char* path, const SweepRow* rows, int n)
+{
+    size_t len  = strlen(path);
+    int    json = len >= 5 && strcmp(path + len - 5, ".json") == 0;
+    FILE*  f;
+
+    if (!(f = fopen(path, "w"))) {
+        perror(path);
+        return -1;
+    }
+
+    if (json)
+        fprintf(f, "{\n  \"topology\": \"%s\",\n  \"env_alloc\": \"%s\",\n  \"runs\": [", rows[0].sum.topology, rows[0].sum.env_alloc);
+    else
+        fprintf(f, "threads,topology,cycles,failed,elapsed_sec,cycles_per_sec,envs,envs_per_sec,"
+                   "env_p50_us,env_p99_us,connect_p50_us,connect_p99_us,rss_start,rss_peak,"
+                   "rate,issued,response_p50_us,response_p99_us,backlog_max,"
+                   "ramp,attempts,failed_attempts,gave_up,all_connected_mean_ms,all_connected_max_ms,"
+                   "vm_start,sessions_held_max,os_threads,"
+                   "stmt,ops,rows,round_trips,stmt_p50_us,stmt_p99_us,"
+                   "export,bytes,truncated,export_sec,fetch_p50_us,fetch_p99_us,"
+                   "signals,sig_sent,sig_refused,sig_handled,sig_off_main,sig_p50_us,sig_p99_us,sig_max_us,"
+                   "soak,soak_fitted,rss_per_cycle,in_use_per_cycle,live_per_cycle,blocks_per_cycle,leak\n");
+
+    for (int i = 0; i < n; i++) {
+        const RunSummary* s = &rows[i].sum;
+        double cps = s->elapsed > 0 ? s->cycles / s->elapsed : 0.0;
+        double eps = s->elapsed > 0 ? s->envs / s->elapsed : 0.0;
+
+        if (json)
+            fprintf(f, "%s\n    { \"threads\": %d, \"cycles\": %ld, \"failed\": %ld, \"elapsed_sec\": %.6f, \"cycles_per_sec\": %.3f,"
+                       " \"envs\": %ld, \"envs_per_sec\": %.3f, \"env_p50_us\": %.3f, \"env_p99_us\": %.3f,"
+                       " \"connect_p50_us\": %.3f, \"connect_p99_us\": %.3f, \"rss_start\": %ld, \"rss_peak\": %ld,"
+                       " \"rate\": %.3f, \"issued\": %ld, \"response_p50_us\": %.3f, \"response_p99_us\": %.3f, \"backlog_max\": %ld,"
+                       " \"ramp\": \"%s\", \"attempts\": %ld, \"failed_attempts\": %ld, \"gave_up\": %ld,"
+                       " \"all_connected_mean_ms\": %.3f, \"all_connected_max_ms\": %.3f,"
+                       " \"vm_start\": %ld, \"sessions_held_max\": %ld, \"os_threads\": %d,"
+                       " \"stmt\": \"%s\", \"ops\": %ld, \"rows\": %ld, \"round_trips\": %ld,"
+                       " \"stmt_p50_us\": %.3f, \"stmt_p99_us\": %.3f,"
+                       " \"export\": \"%s\", \"bytes\": %ld, \"truncated\": %ld, \"export_sec\": %.6f,"
+                       " \"fetch_p50_us\": %.3f, \"fetch_p99_us\": %.3f,"
+                       " \"signals\": \"%s\", \"sig_sent\": %ld, \"sig_refused\": %ld, \"sig_handled\": %ld, \"sig_off_main\": %ld,"
+                       " \"sig_p50_us\": %.3f, \"sig_p99_us\": %.3f, \"sig_max_us\": %.3f,"
+                       " \"soak\": \"%s\", \"soak_fitted\": %d, \"rss_per_cycle\": %.3f, \"in_use_per_cycle\": %.3f,"
+                       " \"live_per_cycle\": %.3f, \"blocks_per_cycle\": %.3f, \"leak\": %s }",
+                    i ? "," : "", s->threads, s->cycles, s->failed, s->elapsed, cps, s->envs, eps,
+                    rows[i].env_p50, rows[i].env_p99, rows[i].connect_p50, rows[i].connect_p99, s->rss_start, s->rss_peak,
+                    s->rate, s->issued, rows[i].resp_p50, rows[i].resp_p99, s->backlog_max,
+                    report_str(s->ramp, 1), s->attempts, s->failed_attempts, s->gave_up, rows[i].all_conn_mean, rows[i].all_conn_max,
+                    s->vm_start, s->held_max, s->os_threads,
+                    report_str(s->stmt, 1), s->ops, s->rows, s->round_trips, rows[i].stmt_p50, rows[i].stmt_p99,
+                    report_str(s->export, 1), s->bytes, s->truncated, s->export_time, rows[i].fetch_p50, rows[i].fetch_p99,
+                    report_str(s->signals, 1), s->sig_sent, s->sig_refused, s->sig_handled, s->sig_elsewhere,
+                    s->sig_p50, s->sig_p99, s->sig_max,
+                    report_str(s->soak, 1), s->trend.fitted, s->trend.m[MEM_RSS].slope, s->trend.m[MEM_IN_USE].slope,
+                    s->trend.m[MEM_LIVE].slope, s->trend.m[MEM_BLOCKS].slope, s->trend.leak ? "true" : "false");
+        else
+            fprintf(f, "%d,%s,%ld,%ld,%.6f,%.3f,%ld,%.3f,%.3f,%.3f,%.3f,%.3f,%ld,%ld,%.3f,%ld,%.3f,%.3f,%ld,\"%s\",%ld,%ld,%ld,%.3f,%.3f,"
+                       "%ld,%ld,%d,\"%s\",%ld,%ld,%ld,%.3f,%.3f,\"%s\",%ld,%ld,%.6f,%.3f,%.3f,"
+                       "\"%s\",%ld,%ld,%ld,%ld,%.3f,%.3f,%.3f,\"%s\",%d,%.3f,%.3f,%.3f,%.3f,%d\n",
+                    s->threads, s->topology,
+                    s->cycles, s->failed, s->elapsed, cps, s->envs, eps, rows[i].env_p50, rows[i].env_p99,
+                    rows[i].connect_p50, rows[i].connect_p99, s->rss_start, s->rss_peak,
+                    s->rate, s->issued, rows[i].resp_p50, rows[i].resp_p99, s->backlog_max,
+                    report_str(s->ramp, 0), s->attempts, s->failed_attempts, s->gave_up, rows[i].all_conn_mean, rows[i].all_conn_max,
+                    s->vm_start, s->held_max, s->os_threads,
+                    report_str(s->stmt, 0), s->ops, s->rows, s->round_trips, rows[i].stmt_p50, rows[i].stmt_p99,
+                    report_str(s->export, 0), s->bytes, s->truncated, s->export_time, rows[i].fetch_p50, rows[i].fetch_p99,
+                    report_str(s->signals, 0), s->sig_sent, s->sig_refused, s->sig_handled, s->sig_elsewhere,
+                    s->sig_p50, s->sig_p99, s->sig_max,
+                    report_str(s->soak, 0), s->trend.fitted, s->trend.m[MEM_RSS].slope, s->trend.m[MEM_IN_USE].slope,
+                    s->trend.m[MEM_LIVE].slope, s->trend.m[MEM_BLOCKS].slope, s->trend.leak);
+    }
+
+    if (json)
+        fprintf(f, "\n  ]\n}\n");
+    return fclose(f);
+}
+
+// -t 8, -t 1,2,4,8 or -t 1-256 (doubling from 1 up to 256); returns the count or -1
+int parse_thread_list(const char* arg, int** list)
+{
+    int   n = 0, cap = 16;
+    int*  out = malloc(cap * sizeof(int));
+    char* copy = strdup(arg);
+    char* save = NULL;
+
+    if (!out || !copy) {
+        free(out);
+        free(copy);
+        return -1;
+    }
+
+    for (char* tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        int lo, hi;
+        char dash;
+        int fields = sscanf(tok, "%d%c%d", &lo, &dash, &hi);
+
+        if (fields == 1) {
+            hi = lo;
+        } else if (fields != 3 || dash != '-' || hi < lo) {
+            n = -1;
+            break;
+        }
+        if (lo <= 0) {
+            n = -1;
+            break;
+        }
+        for (int t = lo; ; t = t * 2 > hi && t < hi ? hi : t * 2) {
+            if (n == cap) {
+                int* grown = realloc(out, (cap *= 2) * sizeof(int));
+                if (!grown) {
+                    n = -1;
+                    break;
+                }
+                out = grown;
+            }
+            out[n++] = t;
+            if (t >= hi)
+                break;
+        }
+        if (n < 0)
+            break;
+    }
+
+    free(copy);
+    if (n <= 0) {
+        free(out);
+        return -1;
+    }
+    *list = out;
+    return n;
+}
+
+// -R profile[,rate=N][,burst=N][,step=sec][,retries=N][,backoff=msec]; 0 or -1
+int parse_ramp(const char* arg, RampSpec* spec)
+{
+    char* const keys[] = { "rate", "burst", "step", "retries", "backoff", NULL };
+    char*       copy = strdup(arg);
+    char*       opts;
+    char*       value;
+    int         p, rc = -1;
+
+    spec->spec = arg;
+    spec->rate = 10;
+    spec->burst = 1;
+    spec->step = 1;
+    spec->retries = 3;
+    spec->backoff = 10;
+
+    if (!copy)
+        return -1;
+    if ((opts = strchr(copy, ',')))
+        *opts++ = '\0';
+    for (p = 0; p < RAMP_COUNT && strcmp(copy, ramp_names[p]) != 0; p++)
+        ;
+    if (p == RAMP_COUNT)
+        goto out;
+    spec->profile = p;
+
+    while (opts && *opts) {
+        switch (getsubopt(&opts, keys, &value)) {
+            case 0: spec->rate    = value ? atof(value) : 0; break;
+            case 1: spec->burst   = value ? atof(value) : 0; break;
+            case 2: spec->step    = value ? atof(value) : 0; break;
+            case 3: spec->retries = value ? atoi(value) : -1; break;
+            case 4: spec->backoff = value ? atof(value) : -1; break;
+            default: goto out;
+        }
+    }
+    if (spec->rate > 0 && spec->burst >= 1 && spec->step > 0 && spec->retries >= 0 && spec->backoff >= 0)
+        rc = 0;
+
+out:
+    free(copy);
+    return rc;
+}
+
+// -Q [cache=N][,prefetch=N][,prefmem=bytes][,array=N]; 0 or -1
+int parse_stmt_spec(const char* arg, StmtSpec* spec)
+{
+    char* const keys[] = { "cache", "prefetch", "prefmem", "array", NULL };
+    char*       copy = strdup(arg);
+    char*       opts = copy;
+    char*       value;
+    long        v;
+    int         key, rc = -1;
+
+    spec->spec = arg;
+    spec->cache = 20;
+    spec->prefetch = 1;
+    spec->prefmem = 0;
+    spec->array = 1;
+
+    if (!copy)
+        return -1;
+    while (*opts) {
+        if ((key = getsubopt(&opts, keys, &value)) < 0 || !value || (v = atol(value)) < 0)
+            goto out;
+        switch (key) {
+            case 0: spec->cache    = (ub4)v; break;
+            case 1: spec->prefetch = (ub4)v; break;
+            case 2: spec->prefmem  = (ub4)v; break;
+            case 3: spec->array    = (ub4)v; break;
+        }
+    }
+    if (spec->array >= 1 && spec->array <= 65536)
+        rc = 0;
+
+out:
+    free(copy);
+    return rc;
+}
+
+// -K mode[,rate=N]; 0 or -1
+int parse_signals(const char* arg, SigSpec* spec)
+{
+    char* const keys[] = { "rate", NULL };
+    char*       copy = strdup(arg);
+    char*       opts;
+    char*       value;
+    int         m, rc = -1;
+
+    spec->spec = arg;
+    spec->rate = 0;
+
+    if (!copy)
+        return -1;
+    if ((opts = strchr(copy, ',')))
+        *opts++ = '\0';
+    if ((m = sig_mode_parse(copy)) < 0)
+        goto out;
+    spec->mode = m;
+
+    while (opts && *opts) {
+        switch (getsubopt(&opts, keys, &value)) {
+            case 0: spec->rate = value ? atof(value) : -1; break;
+            default: goto out;
+        }
+    }
+    if (spec->rate >= 0)
+        rc = 0;
+
+out:
+    free(copy);
+    return rc;
+}
+
+// -M every[,warmup=cycles][,leak=bytes][,file=path]; 0 or -1
+int parse_soak(const char* arg, MemSpec* spec)
+{
+    char* const keys[] = { "warmup", "leak", "file", NULL };
+    char*       copy = strdup(arg);
+    char*       opts;
+    char*       value;
+    char*       end;
+    int         rc = -1;
+
+    spec->spec = arg;
+    spec->warmup = -1;
+    spec->leak = SOAK_LEAK;
+    spec->path = NULL;
+
+    if (!copy)
+        return -1;
+    if ((opts = strchr(copy, ',')))
+        *opts++ = '\0';
+    spec->every = strtol(copy, &end, 10);
+    if (end == copy || *end || spec->every <= 0)
+        goto out;
+
+    while (opts && *opts) {
+        switch (getsubopt(&opts, keys, &value)) {
+            case 0: spec->warmup = value ? atol(value) : -2; break;
+            case 1: spec->leak = value ? atof(value) : -1; break;
+            case 2:
+                free(spec->path);
+                spec->path = value && *value ? strdup(value) : NULL;
+                if (!spec->path)
+                    goto out;
+                break;
+            default: goto out;
+        }
+    }
+    if (spec->warmup >= -1 && spec->leak >= 0)
+        rc = 0;
+
+out:
+    free(copy);
+    if (rc != 0) {
+        free(spec->path);
+        spec->path = NULL;
+    }
+    return rc;
+}
+
+// -D dbname[,weight=N]; 0 or -1
+int parse_target(const char* arg, TargetSpec* spec)
+{
+    char* const keys[] = { "weight", NULL };
+    char*       opts;
+    char*       value;
+
+    spec->spec = arg;
+    spec->weight = 1;
+
+    if (!(spec->dbname = strdup(arg)))
+        return -1;
+    if ((opts = strchr(spec->dbname, ',')))
+        *opts++ = '\0';
+
+    while (opts && *opts) {
+        switch (getsubopt(&opts, keys, &value)) {
+            case 0: spec->weight = value ? atof(value) : -1; break;
+            default: goto fail;
+        }
+    }
+    if (*spec->dbname && spec->weight > 0)
+        return 0;
+
+fail:
+    free(spec->dbname);
+    spec->dbname = NULL;
+    return -1;
+}
+
+// Fill in what the harness needs to know about a statement from its text
+static void sql_stmt_classify(SqlStmt* st)
+{
+    const char* s = st->sql;
+    int         quoted = 0;
+
+    while (*s == ' ' || *s == '\t' || *s == '(')
+        s++;
+    st->is_query = strncasecmp(s, "SELECT", 6) == 0 || strncasecmp(s, "WITH", 4) == 0;
+
+    // :1, :name - outside string literals
+    st->binds = 0;
+    for (s = st->sql; *s; s++) {
+        if (*s == '\'')
+            quoted = !quoted;
+        else if (!quoted && *s == ':' && (s[1] == '_' || (s[1] >= '0' && s[1] <= '9') ||
+                                          (s[1] >= 'a' && s[1] <= 'z') || (s[1] >= 'A' && s[1] <= 'Z')))
+            st->binds++;
+    }
+}
+
+// Built-in -W stmt mix: a single row, a page and a bulk read, all of them from DUAL
+static SqlStmt default_mix_stmts[] = {
+    { 10, "SELECT 1 FROM DUAL" },
+    { 3,  "SELECT LEVEL, RPAD('x', 32, 'x') FROM DUAL CONNECT BY LEVEL <= 100" },
+    { 1,  "SELECT LEVEL, RPAD('x', 32, 'x'), RPAD('y', 64, 'y') FROM DUAL CONNECT BY LEVEL <= 1000" },
+};
+
+// Built-in -W export query: a million rows of about 220 bytes
+static SqlStmt export_default_stmts[] = {
+    { 1,  "SELECT LEVEL, RPAD('x', 100, 'x'), RPAD('y', 100, 'y') FROM DUAL CONNECT BY LEVEL <= 1000000" },
+};
+
+// -F path[,layout=prefixed|columnar][,width=bytes]; 0 or -1
+int parse_export(const char* arg, ExportSpec* spec)
+{
+    char* const keys[] = { "layout", "width", NULL };
+    char*       opts;
+    char*       value;
+    int         rc = -1;
+
+    spec->spec = arg;
+    spec->layout = EXPORT_PREFIXED;
+    spec->width = 64;
+    if (!(spec->path = strdup(arg)))
+        return -1;
+    if ((opts = strchr(spec->path, ',')))
+        *opts++ = '\0';
+    if (!*spec->path)
+        goto out;
+
+    while (opts && *opts) {
+        switch (getsubopt(&opts, keys, &value)) {
+            case 0:
+                if (!value || (int)(spec->layout = export_layout_parse(value)) < 0)
+                    goto out;
+                break;
+            case 1:
+                if (!value || atol(value) <= 0 || atol(value) > EXPORT_VALUE_MAX)
+                    goto out;
+                spec->width = (ub4)atol(value);
+                break;
+            default:
+                goto out;
+        }
+    }
+    rc = 0;
+
+out:
+    if (rc != 0) {
+        free(spec->path);
+        spec->path = NULL;
+    }
+    return rc;
+}
+
+// -S file: one statement per line, optionally preceded by a weight, e.g.
+//     5 SELECT name FROM customers WHERE id = :1
+//     1 INSERT INTO audit_log (id, note) VALUES (:1, :2)
+// Blank lines and lines starting with # or -- are skipped.  0 or -1.
+int load_sql_mix(const char* path, SqlMix* mix)
+{
+    char  line[4096];
+    FILE* f = fopen(path, "r");
+    int   cap = 0;
+
+    memset(mix, 0, sizeof(*mix));
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char*   s = line;
+        char*   end;
+        long    weight = strtol(s, &end, 10);
+        size_t  len;
+
+        if (end != s && (*end == ' ' || *end == '\t'))
+            s = end;
+        else
+            weight = 1;
+        while (*s == ' ' || *s == '\t')
+            s++;
+        len = strlen(s);
+        while (len > 0 && (s[len - 1] == '\n' || s[len - 1] == '\r' || s[len - 1] == ' ' || s[len - 1] == ';'))
+            s[--len] = '\0';
+        if (len == 0 || *s == '#' || strncmp(s, "--", 2) == 0)
+            continue;
+        if (weight <= 0) {
+            fprintf(stderr, "%s: invalid weight for %s\n", path, s);
+            fclose(f);
+            return -1;
+        }
+
+        if (mix->count == cap) {
+            SqlStmt* grown = realloc(mix->stmts, (cap = cap ? cap * 2 : 16) * sizeof(SqlStmt));
+            if (!grown) {
+                perror("Failed to allocate memory");
+                fclose(f);
+                return -1;
+            }
+            mix->stmts = grown;
+        }
+        if (!(mix->stmts[mix->count].sql = strdup(s))) {
+            perror("Failed to allocate memory");
+            fclose(f);
+            return -1;
+        }
+        mix->stmts[mix->count].weight = (int)weight;
+        sql_stmt_classify(&mix->stmts[mix->count]);
+        mix->total += (int)weight;
+        mix->count++;
+    }
+    fclose(f);
+
+    if (mix->count == 0) {
+        fprintf(stderr, "%s: no statements\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    Config cfg = { 0 };
+    int* thread_list = NULL;
+    int* rate_list = NULL;
+    int  num_runs = 1;
+    int  num_rates = 0;
+    RampSpec ramps[16];
+    int  num_ramps = 0;
+    StmtSpec stmt_specs[16];
+    int  num_stmt_specs = 0;
+    SqlMix mix = { default_mix_stmts, sizeof(default_mix_stmts) / sizeof(default_mix_stmts[0]) };
+    const char* mix_path = NULL;
+    ExportSpec export_spec = { 0 };
+    SigSpec sig_specs[16];
+    int  num_sig_specs = 0;
+    MemSpec soak_spec = { 0 };
+    TargetSpec target_specs[16];
+    int  num_targets = 0;
+    int  topology_set = 0;
+    const char* report_path = NULL;
+    int opt;
+
+    cfg.num_loops = -1;         // -1 : not given
+    cfg.workload  = "cycle";
+    cfg.env_alloc = ENV_ALLOC_NONE;
+    cfg.topology  = TOPO_TWO;
+
+    // Parse command-line arguments
+    while ((opt = getopt(argc, argv, "t:l:d:wqo:m:n:W:A:e:r:R:i:L:Q:S:F:K:M:D:")) != -1) {
+        switch (opt) {
+            case 't':
+                free(thread_list);
+                if ((num_runs = parse_thread_list(optarg, &thread_list)) < 0) {
+                    fprintf(stderr, "Invalid number of threads: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'r':
+                free(rate_list);
+                if ((num_rates = parse_thread_list(optarg, &rate_list)) < 0) {
+                    fprintf(stderr, "Invalid rate: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'R':
+                if (num_ramps == sizeof(ramps) / sizeof(ramps[0]) || parse_ramp(optarg, &ramps[num_ramps]) != 0) {
+                    fprintf(stderr, "Invalid ramp: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                num_ramps++;
+                break;
+            case 'Q':
+                if (num_stmt_specs == sizeof(stmt_specs) / sizeof(stmt_specs[0]) || parse_stmt_spec(optarg, &stmt_specs[num_stmt_specs]) != 0) {
+                    fprintf(stderr, "Invalid statement settings: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                num_stmt_specs++;
+                break;
+            case 'S':
+                mix_path = optarg;
+                break;
+            case 'K':
+                if (num_sig_specs == sizeof(sig_specs) / sizeof(sig_specs[0]) || parse_signals(optarg, &sig_specs[num_sig_specs]) != 0) {
+                    fprintf(stderr, "Invalid signal handling: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                num_sig_specs++;
+                break;
+            case 'M':
+                free(soak_spec.path);
+                if (parse_soak(optarg, &soak_spec) != 0) {
+                    fprintf(stderr, "Invalid soak settings: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                cfg.soak = &soak_spec;
+                break;
+            case 'D':
+                if (num_targets == sizeof(target_specs) / sizeof(target_specs[0]) || parse_target(optarg, &target_specs[num_targets]) != 0) {
+                    fprintf(stderr, "Invalid target: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                num_targets++;
+                break;
+            case 'F':
+                free(export_spec.path);
+                if (parse_export(optarg, &export_spec) != 0) {
+                    fprintf(stderr, "Invalid export file: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'L':
+                cfg.ev_loops = atoi(optarg);
+                if (cfg.ev_loops <= 0) {
+                    fprintf(stderr, "Invalid number of event loops: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'i':
+                cfg.live_interval = atof(optarg);
+                if (cfg.live_interval <= 0) {
+                    fprintf(stderr, "Invalid live report interval: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'l':
+                cfg.num_loops = atoi(optarg);
+                if (cfg.num_loops < 0) {
+                    fprintf(stderr, "Invalid number of loops: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'd':
+                cfg.duration = atof(optarg);
+                if (cfg.duration <= 0) {
+                    fprintf(stderr, "Invalid duration: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'w':
+                cfg.use_pool = 1;
+                break;
+            case 'q':
+                cfg.quiet = 1;
+                break;
+            case 'o':
+                report_path = optarg;
+                break;
+            case 'm':
+                if (strcmp(optarg, "pool") == 0) {
+                    cfg.session_pool = 1;
+                } else if (strcmp(optarg, "dedicated") == 0) {
+                    cfg.session_pool = 0;
+                } else {
+                    fprintf(stderr, "Invalid session mode: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                if ((int)(cfg.env_alloc = env_alloc_parse(optarg)) < 0) {
+                    fprintf(stderr, "Invalid allocator: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'e':
+                for (cfg.topology = 0; cfg.topology < TOPO_COUNT && strcmp(optarg, topology_names[cfg.topology]) != 0; cfg.topology++)
+                    ;
+                if (cfg.topology == TOPO_COUNT) {
+                    fprintf(stderr, "Invalid environment topology: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                topology_set = 1;
+                break;
+            case 'W':
+                if (strcmp(optarg, "cycle") != 0 && strcmp(optarg, "ping") != 0 && strcmp(optarg, "select") != 0 &&
+                    strcmp(optarg, "stmt") != 0 && strcmp(optarg, "export") != 0) {
+                    fprintf(stderr, "Invalid workload: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                cfg.workload = optarg;
+                cfg.steady = strcmp(optarg, "cycle") != 0;
+                break;
+            case 'n':
+                if (sscanf(optarg, "%u,%u,%u", &cfg.pool_min, &cfg.pool_max, &cfg.pool_incr) < 2 || cfg.pool_max == 0 || cfg.pool_min > cfg.pool_max) {
+                    fprintf(stderr, "Invalid session pool sizing: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (!thread_list && (num_runs = parse_thread_list("1", &thread_list)) < 0) { // Default number of threads
+        perror("Failed to allocate memory");
+        return EXIT_FAILURE;
+    }
+
+    // The session pool brings its own shared environment
+    if (cfg.session_pool && topology_set) {
+        fprintf(stderr, "Error: -e does not apply to -m pool.\n");
+        return EXIT_FAILURE;
+    }
+
+    // The event loops only know how to log in, ping and log out on dedicated sessions;
+    // a -R token wait would stall every session of the loop, so they do not pace
+    if (cfg.ev_loops && (strcmp(cfg.workload, "ping") != 0 || cfg.session_pool || cfg.use_pool || rate_list || num_ramps)) {
+        fprintf(stderr, "Error: -L needs -W ping with dedicated sessions, without -w, -r or -R.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Open loop runs one schedule for -d seconds; sweep threads or rates, not both
+    if (rate_list) {
+        if (cfg.steady || cfg.use_pool || cfg.num_loops >= 0) {
+            fprintf(stderr, "Error: -r drives -W cycle on its own workers and does not combine with -l, -w or -W %s.\n", cfg.workload);
+            return EXIT_FAILURE;
+        }
+        if (cfg.duration <= 0)
+            cfg.duration = 10;
+        cfg.num_loops = 1;
+        if (num_ramps) {
+            fprintf(stderr, "Error: -R paces closed loop connects, it does not combine with -r.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // -Q and -S describe the statement workloads and nothing else
+    int export = strcmp(cfg.workload, "export") == 0;
+    if (export != (export_spec.path != NULL)) {
+        fprintf(stderr, "Error: -W export needs -F and -F only applies to -W export.\n");
+        return EXIT_FAILURE;
+    }
+    if (export || strcmp(cfg.workload, "stmt") == 0) {
+        if (!num_stmt_specs && parse_stmt_spec(export ? "cache=0,prefetch=1000,prefmem=0,array=1000" : "cache=20,prefetch=1,prefmem=0,array=1",
+                                               &stmt_specs[num_stmt_specs++]) != 0) {
+            perror("Failed to allocate memory");
+            return EXIT_FAILURE;
+        }
+        if (export && !mix_path) {
+            mix.stmts = export_default_stmts;
+            mix.count = 1;
+        }
+        if (mix_path && load_sql_mix(mix_path, &mix) != 0)
+            return EXIT_FAILURE;
+        for (int i = 0; !mix_path && i < mix.count; i++) {
+            sql_stmt_classify(&mix.stmts[i]);
+            mix.total += mix.stmts[i].weight;
+        }
+        if (export && !mix.stmts[0].is_query) {
+            fprintf(stderr, "Error: -W export fetches the first statement of -S, which is not a query.\n");
+            return EXIT_FAILURE;
+        }
+        cfg.mix = &mix;
+        if (export)
+            cfg.export = &export_spec;
+    } else if (num_stmt_specs || mix_path) {
+        fprintf(stderr, "Error: -Q and -S only apply to -W stmt and -W export.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Soak samples between closed loops of connect/disconnect cycles
+    if (cfg.soak && (cfg.steady || rate_list)) {
+        fprintf(stderr, "Error: -M samples between loops of -W cycle and does not combine with -r or -W %s.\n", cfg.workload);
+        return EXIT_FAILURE;
+    }
+
+    // Heap counting costs every thread an atomic update per malloc and free; only -M reads it
+    if (!cfg.soak)
+        malloc_count_enable(0);
+
+    // One sweep at a time: threads, rates, ramp profiles, statement settings or signal handling
+    if ((num_runs > 1) + (num_rates > 1) + (num_ramps > 1) + (num_stmt_specs > 1) + (num_sig_specs > 1) > 1) {
+        fprintf(stderr, "Error: sweep only one of -t, -r, -R, -Q and -K at a time.\n");
+        return EXIT_FAILURE;
+    }
+    int sweep_t = num_runs > 1;
+    if (num_rates > num_runs)
+        num_runs = num_rates;
+    if (num_ramps > num_runs)
+        num_runs = num_ramps;
+    if (num_stmt_specs > num_runs)
+        num_runs = num_stmt_specs;
+    if (num_sig_specs > num_runs)
+        num_runs = num_sig_specs;
+
+    // Steady-state workloads are one long loop: every thread holds its session until -d expires
+    if (cfg.steady) {
+        if (cfg.num_loops >= 0) {
+            fprintf(stderr, "Error: -l does not apply to -W %s, use -d.\n", cfg.workload);
+            return EXIT_FAILURE;
+        }
+        if (cfg.duration <= 0)
+            cfg.duration = 10;
+        cfg.num_loops = 1;
+    }
+
+    // A duration on its own runs as many loops as fit
+    if (cfg.num_loops < 0)
+        cfg.num_loops = cfg.duration > 0 ? 0 : DEFAULT_LOOPS;
+    if (cfg.num_loops == 0 && cfg.duration <= 0) {
+        fprintf(stderr, "Error: -l 0 needs a -d duration.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Validate environment variables; -D stands in for ORA_DBNAME
+    cfg.schema = getenv("ORA_SCHEMA");
+    cfg.passwd = getenv("ORA_PASSWD");
+
+    // ORA_DBNAME is taken verbatim, a connect descriptor may hold commas of its own
+    if (!num_targets && getenv("ORA_DBNAME")) {
+        target_specs[0].spec = getenv("ORA_DBNAME");
+        target_specs[0].dbname = strdup(target_specs[0].spec);
+        target_specs[0].weight = 1;
+        num_targets = 1;
+    }
+    if (!cfg.schema || !cfg.passwd || !num_targets || !target_specs[0].dbname) {
+        fprintf(stderr, "Error: ORA_SCHEMA, ORA_PASSWD, and ORA_DBNAME (or -D) must be defined.\n");
+        return EXIT_FAILURE;
+    }
+    cfg.targets = target_specs;
+    cfg.num_targets = num_targets;
+
+    for (int i = 0; cfg.mix && i < mix.count; i++)
+        printf(" INFO: Statement %d (%4.1f%%, %s, %d binds): %s\n", i + 1, 100.0 * mix.stmts[i].weight / mix.total,
+               mix.stmts[i].is_query ? "array fetch" : "array DML", mix.stmts[i].binds, mix.stmts[i].sql);
+
+    PhaseStats* merged = malloc(sizeof(PhaseStats));
+    TargetStats* targets = malloc(num_targets * sizeof(TargetStats));
+    SweepRow*   rows = calloc(num_runs, sizeof(SweepRow));
+    int         rc = EXIT_SUCCESS;
+
+    if (!merged || !targets || !rows) {
+        perror("Failed to allocate memory");
+        return EXIT_FAILURE;
+    }
+
+    for (int r = 0; r < num_runs && rc == EXIT_SUCCESS; r++) {
+        int threads = thread_list[sweep_t ? r : 0];
+
+        memset(merged, 0, sizeof(PhaseStats));
+        memset(targets, 0, num_targets * sizeof(TargetStats));
+        if (rate_list)
+            cfg.rate = rate_list[num_rates > 1 ? r : 0];
+        if (num_ramps)
+            cfg.ramp = &ramps[num_ramps > 1 ? r : 0];
+        if (num_stmt_specs)
+            cfg.stmt = &stmt_specs[num_stmt_specs > 1 ? r : 0];
+        if (num_sig_specs)
+            cfg.signals = &sig_specs[num_sig_specs > 1 ? r : 0];
+        if (num_runs > 1 && rate_list)
+            printf("\n INFO: Sweep run %d of %d: %d threads at %.0f/sec\n", r + 1, num_runs, threads, cfg.rate);
+        else if (num_runs > 1 && num_ramps > 1)
+            printf("\n INFO: Sweep run %d of %d: %d threads, ramp %s\n", r + 1, num_runs, threads, cfg.ramp->spec);
+        else if (num_runs > 1 && num_stmt_specs > 1)
+            printf("\n INFO: Sweep run %d of %d: %d threads, statements %s\n", r + 1, num_runs, threads, cfg.stmt->spec);
+        else if (num_runs > 1 && num_sig_specs > 1)
+            printf("\n INFO: Sweep run %d of %d: %d threads, signals %s\n", r + 1, num_runs, threads, cfg.signals->spec);
+        else if (num_runs > 1)
+            printf("\n INFO: Sweep run %d of %d: %d threads\n", r + 1, num_runs, threads);
+        if (run_benchmark(&cfg, threads, &rows[r].sum, merged, targets) != 0) {
+            rc = EXIT_FAILURE;
+            break;
+        }
+        rows[r].env_p50     = hist_percentile(&merged->phase[PH_ENV], 0.50) / 1e3;
+        rows[r].env_p99     = hist_percentile(&merged->phase[PH_ENV], 0.99) / 1e3;
+        rows[r].connect_p50 = hist_percentile(&merged->phase[PH_CONNECT], 0.50) / 1e3;
+        rows[r].connect_p99 = hist_percentile(&merged->phase[PH_CONNECT], 0.99) / 1e3;
+        rows[r].resp_p50    = hist_percentile(&merged->phase[PH_RESPONSE], 0.50) / 1e3;
+        rows[r].resp_p99    = hist_percentile(&merged->phase[PH_RESPONSE], 0.99) / 1e3;
+        rows[r].stmt_p50    = hist_percentile(&merged->phase[PH_STATEMENT], 0.50) / 1e3;
+        rows[r].stmt_p99    = hist_percentile(&merged->phase[PH_STATEMENT], 0.99) / 1e3;
+        rows[r].fetch_p50   = hist_percentile(&merged->phase[PH_STMT_FETCH], 0.50) / 1e3;
+        rows[r].fetch_p99   = hist_percentile(&merged->phase[PH_STMT_FETCH], 0.99) / 1e3;
+        if (merged->phase[PH_ALL_CONNECTED].count) {
+            rows[r].all_conn_mean = merged->phase[PH_ALL_CONNECTED].sum / 1e6 / merged->phase[PH_ALL_CONNECTED].count;
+            rows[r].all_conn_max  = merged->phase[PH_ALL_CONNECTED].max / 1e6;
+        }
+
+        print_report(&rows[r].sum, merged);
+        if (num_runs == 1 && report_path && write_report(report_path, &rows[r].sum, merged) != 0)
+            rc = EXIT_FAILURE;
+    }
+
+    if (rc == EXIT_SUCCESS && num_runs > 1) {
+        print_sweep(rows, num_runs);
+        if (report_path && write_sweep(report_path, rows, num_runs) != 0)
+            rc = EXIT_FAILURE;
+    }
+
+    free(merged);
+    free(targets);
+    free(rows);
+    free(thread_list);
+    free(rate_list);
+    for (int i = 0; mix_path && i < mix.count; i++)
+        free(mix.stmts[i].sql);
+    if (mix_path)
+        free(mix.stmts);
+    free(export_spec.path);
+    free(soak_spec.path);
+    for (int t = 0; t < num_targets; t++)
+        free(target_specs[t].dbname);
+
+    if (rc != EXIT_SUCCESS)
+        return rc;
 
-    printf(" INFO: Thread count: %d\n", num_threads);
     printf("\n EXIT SUCCESS\n\n");
 
     // printf(" INFO: OCI_DEFAULT : %d\n", OCI_DEFAULT);
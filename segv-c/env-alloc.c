@@ -0,0 +1,313 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "env-alloc.h"
+
+#define BLOCK_SIZE      (64 * 1024)         // arena/pool blocks taken from malloc
+#define LARGE_MIN       (16 * 1024)         // bigger requests get their own malloc
+#define POOL_MIN_SHIFT  4                   // smallest pool class is 16 bytes
+#define POOL_CLASSES    11                  // 16 .. 16384 bytes, powers of two
+#define CLS_ARENA       0xFFFE
+#define CLS_LARGE       0xFFFF
+#define ROUND16(n)      (((n) + 15) & ~(size_t)15)
+
+static const char* kind_names[ENV_ALLOC_COUNT] = { "none", "malloc", "arena", "pool" };
+
+// Start of every malloc'd block, 16 bytes so payloads stay aligned
+typedef struct Block {
+    struct Block* next;
+    size_t        size;
+} Block;
+
+// Own malloc for large requests (and every request of ENV_ALLOC_MALLOC),
+// linked so whatever OCI forgets to free is released with the allocator
+typedef struct Large {
+    struct Large* prev;
+    struct Large* next;
+} Large;
+
+// In front of every payload
+typedef struct {
+    uint32_t cls;       // pool class, CLS_ARENA or CLS_LARGE
+    uint32_t pad;
+    size_t   size;      // bytes requested
+} Hdr;
+
+typedef struct Free {
+    struct Free* next;
+} Free;
+
+struct EnvAlloc {
+    EnvAllocKind    kind;
+    pthread_mutex_t lock;       // an OCI_THREADED env may call back from any thread
+    EnvAllocStats   st;
+    Block*          blocks;
+    char*           cur;        // unused tail of the newest block
+    size_t          left;
+    Hdr*            last;       // arena: newest allocation, can grow or be undone in place
+    Free*           free[POOL_CLASSES];
+    Large*          large;
+};
+
+static int pool_class(size_t size)
+{
+    int cls = 0;
+
+    while (((size_t)1 << (cls + POOL_MIN_SHIFT)) < size)
+        cls++;
+    return cls;
+}
+
+static size_t pool_size(int cls)
+{
+    return (size_t)1 << (cls + POOL_MIN_SHIFT);
+}
+
+// Take need bytes (header included) from the current block
+static Hdr* carve(EnvAlloc* a, size_t need)
+{
+    Hdr* h;
+
+    if (a->left < need) {
+        Block* b = malloc(BLOCK_SIZE);
+        if (!b)
+            return NULL;
+        b->next   = a->blocks;
+        b->size   = BLOCK_SIZE;
+        a->blocks = b;
+        a->cur    = (char*)(b + 1);
+        a->left   = BLOCK_SIZE - sizeof(Block);
+        a->last   = NULL;
+        a->st.blocks++;
+        a->st.reserved += BLOCK_SIZE;
+    }
+    h = (Hdr*)a->cur;
+    a->cur  += need;
+    a->left -= need;
+    return h;
+}
+
+static Hdr* large_alloc(EnvAlloc* a, size_t size)
+{
+    Large* l = malloc(sizeof(Large) + sizeof(Hdr) + size);
+
+    if (!l)
+        return NULL;
+    l->prev = NULL;
+    l->next = a->large;
+    if (a->large)
+        a->large->prev = l;
+    a->large = l;
+    a->st.blocks++;
+    a->st.reserved += sizeof(Large) + sizeof(Hdr) + size;
+    return (Hdr*)(l + 1);
+}
+
+static void large_free(EnvAlloc* a, Hdr* h)
+{
+    Large* l = (Large*)h - 1;
+
+    if (l->prev)
+        l->prev->next = l->next;
+    else
+        a->large = l->next;
+    if (l->next)
+        l->next->prev = l->prev;
+    free(l);
+}
+
+// Allocate without touching the counters; called with a->lock held
+static void* raw_alloc(EnvAlloc* a, size_t size)
+{
+    Hdr* h;
+    int  cls = CLS_LARGE;
+
+    if (a->kind == ENV_ALLOC_MALLOC || size > LARGE_MIN) {
+        h = large_alloc(a, size);
+    } else if (a->kind == ENV_ALLOC_POOL) {
+        cls = pool_class(size);
+        if (a->free[cls]) {
+            h = (Hdr*)a->free[cls];
+            a->free[cls] = a->free[cls]->next;
+        } else {
+            h = carve(a, sizeof(Hdr) + pool_size(cls));
+        }
+    } else {
+        cls = CLS_ARENA;
+        if ((h = carve(a, sizeof(Hdr) + ROUND16(size))))
+            a->last = h;
+    }
+
+    if (!h)
+        return NULL;
+    h->cls  = cls;
+    h->size = size;
+    return h + 1;
+}
+
+static void raw_free(EnvAlloc* a, Hdr* h)
+{
+    if (h->cls == CLS_LARGE) {
+        large_free(a, h);
+    } else if (h->cls == CLS_ARENA) {
+        // Only the newest allocation can be handed back to the block
+        if (h == a->last) {
+            a->left += (size_t)(a->cur - (char*)h);
+            a->cur   = (char*)h;
+            a->last  = NULL;
+        }
+    } else {
+        // Free list links overlay the header, the class is known from the list
+        Free* f = (Free*)h;
+        int   cls = h->cls;
+        f->next = a->free[cls];
+        a->free[cls] = f;
+    }
+}
+
+static void count_live(EnvAlloc* a, int64_t delta)
+{
+    a->st.live += delta;
+    if (a->st.live > a->st.peak)
+        a->st.peak = a->st.live;
+}
+
+EnvAlloc* env_alloc_create(EnvAllocKind kind)
+{
+    EnvAlloc* a;
+
+    if (kind <= ENV_ALLOC_NONE || kind >= ENV_ALLOC_COUNT)
+        return NULL;
+    if (!(a = calloc(1, sizeof(*a))))
+        return NULL;
+    a->kind = kind;
+    pthread_mutex_init(&a->lock, NULL);
+    return a;
+}
+
+void env_alloc_destroy(EnvAlloc* a, EnvAllocStats* totals)
+{
+    if (!a)
+        return;
+
+    while (a->large) {
+        Large* l = a->large;
+        a->large = l->next;
+        free(l);
+    }
+    while (a->blocks) {
+        Block* b = a->blocks;
+        a->blocks = b->next;
+        free(b);
+    }
+
+    if (totals) {
+        a->st.envs = 1;
+        env_alloc_stats_merge(totals, &a->st);
+    }
+    pthread_mutex_destroy(&a->lock);
+    free(a);
+}
+
+void* env_alloc_malloc(void* ctxp, size_t size)
+{
+    EnvAlloc* a = ctxp;
+    void*     p;
+
+    pthread_mutex_lock(&a->lock);
+    if ((p = raw_alloc(a, size))) {
+        a->st.allocs++;
+        a->st.bytes += size;
+        count_live(a, (int64_t)size);
+    }
+    pthread_mutex_unlock(&a->lock);
+    return p;
+}
+
+void* env_alloc_realloc(void* ctxp, void* memptr, size_t newsize)
+{
+    EnvAlloc* a = ctxp;
+    Hdr*      h;
+    size_t    old;
+    void*     p;
+
+    if (!memptr)
+        return env_alloc_malloc(ctxp, newsize);
+    if (newsize == 0) {
+        env_alloc_free(ctxp, memptr);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&a->lock);
+    h   = (Hdr*)memptr - 1;
+    old = h->size;
+    a->st.reallocs++;
+
+    // Grow or shrink in place when the block allows it
+    if ((h->cls < POOL_CLASSES && newsize <= pool_size(h->cls))
+     || (h->cls == CLS_ARENA && newsize <= ROUND16(old))) {
+        p = memptr;
+    } else if (h->cls == CLS_ARENA && h == a->last && ROUND16(newsize) - ROUND16(old) <= a->left && newsize <= LARGE_MIN) {
+        a->cur  += ROUND16(newsize) - ROUND16(old);
+        a->left -= ROUND16(newsize) - ROUND16(old);
+        p = memptr;
+    } else if ((p = raw_alloc(a, newsize))) {
+        memcpy(p, memptr, old < newsize ? old : newsize);
+        raw_free(a, h);
+        a->st.bytes += newsize;
+    }
+
+    if (p) {
+        ((Hdr*)p - 1)->size = newsize;
+        count_live(a, (int64_t)newsize - (int64_t)old);
+    }
+    pthread_mutex_unlock(&a->lock);
+    return p;
+}
+
+void env_alloc_free(void* ctxp, void* memptr)
+{
+    EnvAlloc* a = ctxp;
+    Hdr*      h;
+
+    if (!memptr)
+        return;
+
+    pthread_mutex_lock(&a->lock);
+    h = (Hdr*)memptr - 1;
+    a->st.frees++;
+    count_live(a, -(int64_t)h->size);
+    raw_free(a, h);
+    pthread_mutex_unlock(&a->lock);
+}
+
+int env_alloc_parse(const char* name)
+{
+    for (int k = 0; k < ENV_ALLOC_COUNT; k++)
+        if (strcmp(name, kind_names[k]) == 0)
+            return k;
+    return -1;
+}
+
+const char* env_alloc_name(EnvAllocKind kind)
+{
+    return kind >= 0 && kind < ENV_ALLOC_COUNT ? kind_names[kind] : "?";
+}
+
+void env_alloc_stats_merge(EnvAllocStats* into, const EnvAllocStats* from)
+{
+    into->envs     += from->envs;
+    into->allocs   += from->allocs;
+    into->frees    += from->frees;
+    into->reallocs += from->reallocs;
+    into->bytes    += from->bytes;
+    into->live     += from->live;
+    into->blocks   += from->blocks;
+    into->reserved += from->reserved;
+    if (from->peak > into->peak)
+        into->peak = from->peak;
+}
+
+// vim: expandtab number tabstop=4 shiftwidth=4
+// END
@@ -0,0 +1,64 @@
+// env-alloc.h - per-environment allocators for the OCIEnvNlsCreate memory callbacks
+//
+// OCIEnvNlsCreate takes malocfp/ralocfp/mfreefp plus a context pointer and
+// routes every heap request made for that environment through them.  Give
+// each environment its own EnvAlloc and release the whole thing after the
+// env handle is freed:
+//
+//     EnvAlloc* a = env_alloc_create(ENV_ALLOC_ARENA);
+//     OCIEnvNlsCreate(&envhp, OCI_THREADED, ENV_ALLOC_CALLBACKS(a), 0, NULL, 0, 0);
+//     ...
+//     OCIHandleFree(envhp, OCI_HTYPE_ENV);
+//     env_alloc_destroy(a, &totals);
+#ifndef ENV_ALLOC_H
+#define ENV_ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    ENV_ALLOC_NONE,     // NULL callbacks - OCI uses its own (glibc) heap
+    ENV_ALLOC_MALLOC,   // callbacks forward to malloc, counted only
+    ENV_ALLOC_ARENA,    // bump allocation from large blocks, free is a no-op
+    ENV_ALLOC_POOL,     // size-class free lists carved from large blocks
+    ENV_ALLOC_COUNT
+} EnvAllocKind;
+
+typedef struct {
+    uint64_t envs;      // allocators destroyed into these totals
+    uint64_t allocs;    // malocfp calls (and ralocfp of NULL)
+    uint64_t frees;     // mfreefp calls
+    uint64_t reallocs;  // ralocfp calls on an existing block
+    uint64_t bytes;     // bytes requested, cumulative
+    int64_t  live;      // bytes requested and not freed when the env went away
+    int64_t  peak;      // largest live byte count of any one environment
+    uint64_t blocks;    // malloc calls the allocator itself made
+    uint64_t reserved;  // bytes obtained from malloc, cumulative
+} EnvAllocStats;
+
+typedef struct EnvAlloc EnvAlloc;
+
+// Callback arguments for OCIEnvNlsCreate/OCIEnvCreate: ctxp, malocfp, ralocfp, mfreefp
+#define ENV_ALLOC_CALLBACKS(a) (void*)(a), (a) ? env_alloc_malloc : NULL, \
+                               (a) ? env_alloc_realloc : NULL, (a) ? env_alloc_free : NULL
+
+// NULL for ENV_ALLOC_NONE or when out of memory
+EnvAlloc* env_alloc_create(EnvAllocKind kind);
+
+// Release every block and add this allocator's counters to totals (may be NULL)
+void env_alloc_destroy(EnvAlloc* a, EnvAllocStats* totals);
+
+void* env_alloc_malloc(void* ctxp, size_t size);
+void* env_alloc_realloc(void* ctxp, void* memptr, size_t newsize);
+void  env_alloc_free(void* ctxp, void* memptr);
+
+// Name <-> kind: none, malloc, arena, pool; -1 if unknown
+int         env_alloc_parse(const char* name);
+const char* env_alloc_name(EnvAllocKind kind);
+
+void env_alloc_stats_merge(EnvAllocStats* into, const EnvAllocStats* from);
+
+#endif // ENV_ALLOC_H
+
+// vim: expandtab number tabstop=4 shiftwidth=4
+// END
@@ -0,0 +1,213 @@
+#define _GNU_SOURCE             // mremap
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "export-map.h"
+
+#define HEADER_SIZE     32
+#define MAP_FIRST       (64ull << 20)       // first mapping, doubled up to MAP_STEP, then grown by MAP_STEP
+#define MAP_STEP        (1ull << 30)
+#define PIECE_ROOM      (1u << 20)          // prefixed: least room handed out for a piece
+#define ALIGN8(n)       (((n) + 7) & ~(uint64_t)7)
+
+static const char* layout_names[EXPORT_LAYOUT_COUNT] = { "prefixed", "columnar" };
+
+struct ExportMap {
+    int            fd;
+    ExportLayout   layout;
+    uint32_t       ncols;
+    uint32_t       block_rows;
+    uint32_t       width;
+    uint64_t       page;
+    char*          base;
+    uint64_t       mapped;      // bytes mapped, also the file size while open
+    uint64_t       pos;         // end of what has been written
+    uint64_t       released;    // pages below this were dropped from the mapping
+    uint64_t       block;       // columnar: start of the current block
+    uint64_t       col_size;    // columnar: bytes per column of a block
+    uint64_t       len_at;      // length word of the value being written
+    uint64_t       slot;        // columnar: its slot
+    uint32_t       value_len;   // bytes of it so far
+    int            discarding;  // columnar: the slot is full, pieces go to discard
+    ExportMapStats stats;
+    char           discard[4096];
+};
+
+static void put32(char* p, uint32_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static int map_grow(ExportMap* m, uint64_t need)
+{
+    uint64_t size = m->mapped;
+    char*    p;
+
+    if (need <= size)
+        return 0;
+    while (size < need)
+        size += size < MAP_STEP ? size : MAP_STEP;
+    if (ftruncate(m->fd, size) != 0)
+        return -1;
+    if ((p = mremap(m->base, m->mapped, size, MREMAP_MAYMOVE)) == MAP_FAILED)
+        return -1;
+    m->base = p;
+    m->mapped = size;
+    m->stats.grows++;
+    return 0;
+}
+
+// Drop fully written pages from the mapping - their data stays in the page
+// cache on its way to the file, it just stops counting as our RSS
+static void map_release(ExportMap* m)
+{
+    uint64_t upto = m->pos & ~(m->page - 1);
+
+    if (upto - m->released < EXPORT_RELEASE)
+        return;
+    msync(m->base + m->released, upto - m->released, MS_ASYNC);
+    madvise(m->base + m->released, upto - m->released, MADV_DONTNEED);
+    m->stats.released += upto - m->released;
+    m->released = upto;
+}
+
+ExportMap* export_map_open(const char* path, ExportLayout layout, uint32_t ncols, uint32_t block_rows, uint32_t width)
+{
+    ExportMap* m = calloc(1, sizeof(*m));
+
+    if (!m)
+        return NULL;
+    m->layout = layout;
+    m->ncols = ncols;
+    m->block_rows = block_rows ? block_rows : 1;
+    m->width = width;
+    m->page = (uint64_t)sysconf(_SC_PAGESIZE);
+    m->col_size = ALIGN8((uint64_t)m->block_rows * 4) + ALIGN8((uint64_t)m->block_rows * width);
+
+    if ((m->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+        free(m);
+        return NULL;
+    }
+    if (ftruncate(m->fd, MAP_FIRST) != 0 ||
+        (m->base = mmap(NULL, MAP_FIRST, PROT_READ | PROT_WRITE, MAP_SHARED, m->fd, 0)) == MAP_FAILED) {
+        close(m->fd);
+        unlink(path);
+        free(m);
+        return NULL;
+    }
+    m->mapped = MAP_FIRST;
+
+    memcpy(m->base, "DBXPORT1", 8);
+    put32(m->base + 8, layout);
+    put32(m->base + 12, ncols);
+    put32(m->base + 16, layout == EXPORT_COLUMNAR ? width : 0);
+    m->pos = HEADER_SIZE;
+    return m;
+}
+
+int export_block_begin(ExportMap* m)
+{
+    if (m->layout == EXPORT_COLUMNAR) {
+        m->block = m->pos;
+        return map_grow(m, m->pos + 8 + m->ncols * m->col_size);
+    }
+    return map_grow(m, m->pos + 4 + PIECE_ROOM);
+}
+
+void export_block_end(ExportMap* m, uint32_t rows)
+{
+    if (m->layout == EXPORT_COLUMNAR) {
+        put32(m->base + m->block, rows);
+        put32(m->base + m->block + 4, m->block_rows);
+        m->pos = m->block + 8 + m->ncols * m->col_size;
+    }
+    m->stats.rows += rows;
+    map_release(m);
+}
+
+char* export_piece(ExportMap* m, uint32_t col, uint32_t row, int continued, uint32_t* room)
+{
+    if (!continued) {
+        m->value_len = 0;
+        m->discarding = 0;
+        m->stats.values++;
+    }
+
+    if (m->layout == EXPORT_PREFIXED) {
+        if (!continued) {
+            m->len_at = m->pos;
+            m->pos += 4;
+        }
+        // The value's earlier pieces stay put, offsets survive a move of the mapping
+        if (map_grow(m, m->pos + PIECE_ROOM) != 0)
+            return NULL;
+        *room = m->mapped - m->pos > (1u << 30) ? (1u << 30) : (uint32_t)(m->mapped - m->pos);
+        return m->base + m->pos;
+    }
+
+    if (!continued) {
+        if (col >= m->ncols || row >= m->block_rows) {
+            m->discarding = 1;
+        } else {
+            uint64_t at = m->block + 8 + col * m->col_size;
+            m->len_at = at + (uint64_t)row * 4;
+            m->slot = at + ALIGN8((uint64_t)m->block_rows * 4) + (uint64_t)row * m->width;
+        }
+    }
+    if (!m->discarding && m->value_len < m->width) {
+        *room = m->width - m->value_len;
+        return m->base + m->slot + m->value_len;
+    }
+    if (!m->discarding)
+        m->stats.truncated++;
+    m->discarding = 1;
+    *room = sizeof(m->discard);
+    return m->discard;
+}
+
+void export_piece_done(ExportMap* m, uint32_t len, int null)
+{
+    if (m->discarding)
+        return;
+    m->value_len += len;
+    if (m->layout == EXPORT_PREFIXED)
+        m->pos += len;
+    if (null)
+        m->stats.nulls++;
+    put32(m->base + m->len_at, null ? EXPORT_NULL : m->value_len);
+}
+
+int export_map_close(ExportMap* m, ExportMapStats* stats)
+{
+    int rc = 0;
+
+    memcpy(m->base + 24, &m->stats.rows, sizeof(uint64_t));
+    if (munmap(m->base, m->mapped) != 0 || ftruncate(m->fd, m->pos) != 0)
+        rc = -1;
+    if (close(m->fd) != 0)
+        rc = -1;
+    m->stats.bytes = m->pos;
+    if (stats)
+        *stats = m->stats;
+    free(m);
+    return rc;
+}
+
+int export_layout_parse(const char* name)
+{
+    for (int l = 0; l < EXPORT_LAYOUT_COUNT; l++)
+        if (strcmp(name, layout_names[l]) == 0)
+            return l;
+    return -1;
+}
+
+const char* export_layout_name(ExportLayout layout)
+{
+    return layout < EXPORT_LAYOUT_COUNT ? layout_names[layout] : "?";
+}
+
+// vim: expandtab number tabstop=4 shiftwidth=4
+// END
@@ -0,0 +1,73 @@
+// export-map.h - memory-mapped output file that fetched values are written into in place
+//
+// The file is mapped MAP_SHARED and grown with ftruncate/mremap as it fills.
+// The caller asks for room for the next piece of a value, lets the fetch
+// copy straight into the mapped pages and then reports how much landed -
+// there is no per-row buffer in between.  Pages behind the write position
+// are handed back to the kernel every EXPORT_RELEASE bytes so the resident
+// set stays flat however large the file gets:
+//
+//     ExportMap* m = export_map_open("out.dbx", EXPORT_COLUMNAR, ncols, 1000, 64);
+//     for (;;) {
+//         export_block_begin(m);
+//         ... per value: p = export_piece(m, col, row, continued, &room); copy <= room; export_piece_done(m, len, null);
+//         export_block_end(m, rows);
+//     }
+//     export_map_close(m, &stats);
+//
+// Layouts, after a 32 byte header ("DBXPORT1", layout, ncols, width, rows):
+//   prefixed  every value as a 4 byte length (0xFFFFFFFF = NULL) and its bytes,
+//             row after row
+//   columnar  a block per fetch: rows and capacity (4 bytes each), then for each
+//             column capacity lengths and capacity fixed width slots, 8 byte
+//             aligned; longer values are truncated to the slot
+#ifndef EXPORT_MAP_H
+#define EXPORT_MAP_H
+
+#include <stdint.h>
+
+#define EXPORT_NULL     0xFFFFFFFFu
+#define EXPORT_RELEASE  (8u << 20)      // drop written pages from the mapping every 8 MiB
+
+typedef enum {
+    EXPORT_PREFIXED,
+    EXPORT_COLUMNAR,
+    EXPORT_LAYOUT_COUNT
+} ExportLayout;
+
+typedef struct {
+    uint64_t bytes;     // file size once closed
+    uint64_t rows;
+    uint64_t values;
+    uint64_t nulls;
+    uint64_t truncated; // columnar values cut to the slot width
+    uint64_t grows;     // ftruncate/mremap calls after the first mapping
+    uint64_t released;  // bytes of written pages dropped from the mapping
+} ExportMapStats;
+
+typedef struct ExportMap ExportMap;
+
+// NULL with errno set on failure; width only matters for EXPORT_COLUMNAR
+ExportMap* export_map_open(const char* path, ExportLayout layout, uint32_t ncols, uint32_t block_rows, uint32_t width);
+
+// Around every fetch call: make room for a whole block, then record its rows; -1 if the file cannot grow
+int  export_block_begin(ExportMap* m);
+void export_block_end(ExportMap* m, uint32_t rows);
+
+// Where the next piece of (col, row of the block) goes and how many bytes fit;
+// continued = more of the value the previous piece belonged to.  NULL if the
+// file cannot grow.  Every piece must be followed by export_piece_done().
+char* export_piece(ExportMap* m, uint32_t col, uint32_t row, int continued, uint32_t* room);
+void  export_piece_done(ExportMap* m, uint32_t len, int null);
+
+// Trim the file to what was written, unmap and close; 0 or -1.  stats may be NULL.
+int export_map_close(ExportMap* m, ExportMapStats* stats);
+
+// Name <-> layout: prefixed, columnar; -1 if unknown
+int         export_layout_parse(const char* name);
+const char* export_layout_name(ExportLayout layout);
+
+#endif // EXPORT_MAP_H
+
+// vim: expandtab number tabstop=4 shiftwidth=4
+// END
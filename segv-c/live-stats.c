@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "live-stats.h"
+
+struct LiveStats {
+    LiveSlot*       slots;
+    int             count;
+    uint64_t        interval;   // nanoseconds
+    uint64_t        started;
+    pthread_t       thread;
+    int             running;
+    pthread_mutex_t lock;       // reporter <-> live_stats_stop only, never the workers
+    pthread_cond_t  wake;
+    int             stop;
+    uint64_t        ops;        // totals at the previous interval
+    uint64_t        errors;
+    uint64_t        dropped;
+    uint64_t        last;
+};
+
+static uint64_t mono_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+LiveStats* live_stats_create(int slots, double interval)
+{
+    LiveStats*         ls = calloc(1, sizeof(*ls));
+    pthread_condattr_t attr;
+
+    if (!ls)
+        return NULL;
+    ls->slots = aligned_alloc(LIVE_CACHE_LINE, slots * sizeof(LiveSlot));
+    if (!ls->slots) {
+        free(ls);
+        return NULL;
+    }
+    memset(ls->slots, 0, slots * sizeof(LiveSlot));
+    ls->count = slots;
+    ls->interval = (uint64_t)(interval * 1e9);
+
+    pthread_mutex_init(&ls->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&ls->wake, &attr);
+    pthread_condattr_destroy(&attr);
+    return ls;
+}
+
+LiveSlot* live_stats_slot(LiveStats* ls, int i)
+{
+    return ls && i < ls->count ? &ls->slots[i] : NULL;
+}
+
+void live_event(LiveSlot* s, int code, const char* text)
+{
+    uint64_t   head = s->w.head;
+    LiveEvent* e;
+    struct timespec ts;
+
+    if (head - __atomic_load_n(&s->tail, __ATOMIC_ACQUIRE) == LIVE_RING_SIZE) {
+        __atomic_store_n(&s->w.dropped, s->w.dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+    e = &s->ring[head & (LIVE_RING_SIZE - 1)];
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    e->when = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    e->code = code;
+    snprintf(e->text, sizeof(e->text), "%s", text);
+
+    // Publish the entry before the new head
+    __atomic_store_n(&s->w.head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Print pending events, then one line of interval totals
+static void report(LiveStats* ls, uint64_t now)
+{
+    uint64_t ops = 0, errors = 0, in_flight = 0, dropped = 0;
+    double   secs = (now - ls->last) / 1e9;
+
+    for (int i = 0; i < ls->count; i++) {
+        LiveSlot* s = &ls->slots[i];
+        uint64_t  head = __atomic_load_n(&s->w.head, __ATOMIC_ACQUIRE);
+
+        for (uint64_t t = s->tail; t != head; t++) {
+            const LiveEvent* e = &s->ring[t & (LIVE_RING_SIZE - 1)];
+            printf(" LIVE %8.3fs Thread %d Error %d: %s\n", (e->when - ls->started) / 1e9, i + 1, e->code, e->text);
+        }
+        __atomic_store_n(&s->tail, head, __ATOMIC_RELEASE);
+
+        ops       += __atomic_load_n(&s->w.ops,       __ATOMIC_RELAXED);
+        errors    += __atomic_load_n(&s->w.errors,    __ATOMIC_RELAXED);
+        in_flight += __atomic_load_n(&s->w.in_flight, __ATOMIC_RELAXED);
+        dropped   += __atomic_load_n(&s->w.dropped,   __ATOMIC_RELAXED);
+    }
+
+    printf(" LIVE %8.3fs  ops/sec %10.1f  errors %6llu  in-flight %4llu  total ops %10llu",
+           (now - ls->started) / 1e9, secs > 0 ? (ops - ls->ops) / secs : 0.0,
+           (unsigned long long)(errors - ls->errors), (unsigned long long)in_flight, (unsigned long long)ops);
+    if (dropped != ls->dropped)
+        printf("  events dropped %llu", (unsigned long long)(dropped - ls->dropped));
+    printf("\n");
+    fflush(stdout);
+
+    ls->ops = ops;
+    ls->errors = errors;
+    ls->dropped = dropped;
+    ls->last = now;
+}
+
+static void* reporter(void* arg)
+{
+    LiveStats* ls = arg;
+    uint64_t   next = ls->started;
+
+    pthread_mutex_lock(&ls->lock);
+    while (!ls->stop) {
+        struct timespec ts;
+
+        // Fixed schedule from the start so the intervals do not drift
+        next += ls->interval;
+        ts.tv_sec  = next / 1000000000ull;
+        ts.tv_nsec = next % 1000000000ull;
+        while (!ls->stop && pthread_cond_timedwait(&ls->wake, &ls->lock, &ts) == 0)
+            ;
+        if (ls->stop)
+            break;
+        pthread_mutex_unlock(&ls->lock);
+        report(ls, mono_ns());
+        pthread_mutex_lock(&ls->lock);
+    }
+    pthread_mutex_unlock(&ls->lock);
+
+    report(ls, mono_ns());
+    return NULL;
+}
+
+int live_stats_start(LiveStats* ls)
+{
+    ls->started = ls->last = mono_ns();
+    if (pthread_create(&ls->thread, NULL, reporter, ls) != 0)
+        return -1;
+    ls->running = 1;
+    return 0;
+}
+
+void live_stats_stop(LiveStats* ls)
+{
+    if (!ls || !ls->running)
+        return;
+    pthread_mutex_lock(&ls->lock);
+    ls->stop = 1;
+    pthread_cond_signal(&ls->wake);
+    pthread_mutex_unlock(&ls->lock);
+    pthread_join(ls->thread, NULL);
+    ls->running = 0;
+}
+
+void live_stats_destroy(LiveStats* ls)
+{
+    if (!ls)
+        return;
+    live_stats_stop(ls);
+    pthread_cond_destroy(&ls->wake);
+    pthread_mutex_destroy(&ls->lock);
+    free(ls->slots);
+    free(ls);
+}
+
+// vim: expandtab number tabstop=4 shiftwidth=4
+// END
@@ -0,0 +1,79 @@
+// live-stats.h - per-thread counters and error events reported while a run is going
+//
+// Every worker owns one LiveSlot: its counters sit on their own cache line
+// and are only ever written by that worker, and its events go into a
+// single-producer/single-consumer ring.  Nothing on the worker side takes a
+// lock or writes a line another worker writes.  A reporter thread sums the
+// counters and drains the rings every interval:
+//
+//     LiveStats* ls = live_stats_create(threads, 1.0);
+//     live_stats_start(ls);
+//     ... worker i: live_op_begin(live_stats_slot(ls, i)); ...; live_op_end(slot, ok);
+//     live_stats_stop(ls);        // final interval and remaining events
+//     live_stats_destroy(ls);
+#ifndef LIVE_STATS_H
+#define LIVE_STATS_H
+
+#include <stdint.h>
+
+#define LIVE_CACHE_LINE     64
+#define LIVE_RING_SIZE      64          // events per slot, a power of two
+#define LIVE_EVENT_TEXT     116         // LiveEvent is 128 bytes
+
+typedef struct {
+    uint64_t when;                      // now_ns()-style CLOCK_MONOTONIC nanoseconds
+    int32_t  code;                      // OCI status or error code
+    char     text[LIVE_EVENT_TEXT];
+} LiveEvent;
+
+typedef struct {
+    // Written by the owning worker only
+    struct {
+        uint64_t ops;                   // operations completed
+        uint64_t errors;                // of which failed
+        uint64_t in_flight;             // 1 while an operation is running
+        uint64_t dropped;               // events lost to a full ring
+        uint64_t head;                  // next ring entry to write
+    } __attribute__((aligned(LIVE_CACHE_LINE))) w;
+
+    // Written by the reporter only
+    uint64_t  tail __attribute__((aligned(LIVE_CACHE_LINE)));
+
+    LiveEvent ring[LIVE_RING_SIZE];
+} __attribute__((aligned(LIVE_CACHE_LINE))) LiveSlot;
+
+typedef struct LiveStats LiveStats;
+
+// NULL when out of memory
+LiveStats* live_stats_create(int slots, double interval);
+LiveSlot*  live_stats_slot(LiveStats* ls, int i);
+
+// Start/stop the reporter thread; stop prints a last interval and any pending events
+int  live_stats_start(LiveStats* ls);
+void live_stats_stop(LiveStats* ls);
+void live_stats_destroy(LiveStats* ls);
+
+// Queue an error event for the reporter; dropped (and counted) if the ring is full
+void live_event(LiveSlot* s, int code, const char* text);
+
+// Hot path: single writer, so plain relaxed stores are enough.  NULL is a no-op.
+static inline void live_op_begin(LiveSlot* s)
+{
+    if (s)
+        __atomic_store_n(&s->w.in_flight, 1, __ATOMIC_RELAXED);
+}
+
+static inline void live_op_end(LiveSlot* s, int ok)
+{
+    if (!s)
+        return;
+    __atomic_store_n(&s->w.ops, s->w.ops + 1, __ATOMIC_RELAXED);
+    if (!ok)
+        __atomic_store_n(&s->w.errors, s->w.errors + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->w.in_flight, 0, __ATOMIC_RELAXED);
+}
+
+#endif // LIVE_STATS_H
+
+// vim: expandtab number tabstop=4 shiftwidth=4
+// END
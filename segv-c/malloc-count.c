@@ -0,0 +1,139 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <malloc.h>
+#include <unistd.h>
+#include "malloc-count.h"
+
+// The real allocator - glibc exports these for exactly this purpose
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void  __libc_free(void* ptr);
+extern void* __libc_memalign(size_t alignment, size_t size);
+
+static MallocCount counts;
+static int         counting = 1;
+
+static void count_alloc(void* ptr)
+{
+    int64_t live, peak;
+
+    if (!ptr || !__atomic_load_n(&counting, __ATOMIC_RELAXED))
+        return;
+    __atomic_add_fetch(&counts.allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&counts.bytes, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    live = __atomic_add_fetch(&counts.live, (int64_t)malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    peak = __atomic_load_n(&counts.peak, __ATOMIC_RELAXED);
+    while (live > peak && !__atomic_compare_exchange_n(&counts.peak, &peak, live, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static void count_free(void* ptr)
+{
+    if (!ptr || !__atomic_load_n(&counting, __ATOMIC_RELAXED))
+        return;
+    __atomic_add_fetch(&counts.frees, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&counts.live, (int64_t)malloc_usable_size(ptr), __ATOMIC_RELAXED);
+}
+
+void* malloc(size_t size)
+{
+    void* ptr = __libc_malloc(size);
+    count_alloc(ptr);
+    return ptr;
+}
+
+void* calloc(size_t nmemb, size_t size)
+{
+    void* ptr = __libc_calloc(nmemb, size);
+    count_alloc(ptr);
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    size_t old;
+    void*  new;
+
+    if (!ptr)
+        return malloc(size);
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+
+    // Count a resize as release of the old block and a fresh block, without
+    // touching allocs/frees so the per-call numbers stay meaningful
+    if (!__atomic_load_n(&counting, __ATOMIC_RELAXED))
+        return __libc_realloc(ptr, size);
+    old = malloc_usable_size(ptr);
+    new = __libc_realloc(ptr, size);
+    if (new) {
+        __atomic_add_fetch(&counts.reallocs, 1, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&counts.live, (int64_t)old, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&counts.allocs, 1, __ATOMIC_RELAXED);
+        count_alloc(new);
+    }
+    return new;
+}
+
+void free(void* ptr)
+{
+    count_free(ptr);
+    __libc_free(ptr);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    void* ptr = __libc_memalign(alignment, size);
+    count_alloc(ptr);
+    return ptr;
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** memptr, size_t alignment, size_t size)
+{
+    void* ptr;
+
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+    if (!(ptr = memalign(alignment, size)))
+        return ENOMEM;
+    *memptr = ptr;
+    return 0;
+}
+
+void* valloc(size_t size)
+{
+    return memalign(sysconf(_SC_PAGESIZE), size);
+}
+
+void malloc_count_snapshot(MallocCount* mc)
+{
+    mc->allocs   = __atomic_load_n(&counts.allocs,   __ATOMIC_RELAXED);
+    mc->frees    = __atomic_load_n(&counts.frees,    __ATOMIC_RELAXED);
+    mc->reallocs = __atomic_load_n(&counts.reallocs, __ATOMIC_RELAXED);
+    mc->bytes    = __atomic_load_n(&counts.bytes,    __ATOMIC_RELAXED);
+    mc->live     = __atomic_load_n(&counts.live,     __ATOMIC_RELAXED);
+    mc->peak     = __atomic_load_n(&counts.peak,     __ATOMIC_RELAXED);
+}
+
+void malloc_count_reset_peak(void)
+{
+    __atomic_store_n(&counts.peak, __atomic_load_n(&counts.live, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+void malloc_count_enable(int on)
+{
+    __atomic_store_n(&counting, on, __ATOMIC_RELAXED);
+}
+
+// vim: expandtab number tabstop=4 shiftwidth=4
+// END
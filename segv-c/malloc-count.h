@@ -0,0 +1,38 @@
+// malloc-count.h - process-wide heap accounting by malloc interposition
+//
+// Linking malloc-count.c into a program replaces malloc, calloc, realloc,
+// free and the memalign family for the whole process - libclntsh included -
+// with thin wrappers around glibc's __libc_* entry points that keep a few
+// counters.  Sizes are malloc_usable_size() so frees balance exactly.
+//
+// Counting is on from the start.  A program that only needs it some of the
+// time switches it off early, before anything it will count is allocated -
+// a block freed while counting that was allocated while not would unbalance
+// live - and saves every thread the atomic updates of one shared cache line.
+#ifndef MALLOC_COUNT_H
+#define MALLOC_COUNT_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint64_t allocs;    // blocks handed out (malloc, calloc, memalign, realloc of NULL)
+    uint64_t frees;     // blocks returned (free, realloc to 0)
+    uint64_t reallocs;  // realloc calls that resized an existing block
+    uint64_t bytes;     // usable bytes handed out, cumulative
+    int64_t  live;      // usable bytes currently allocated
+    int64_t  peak;      // high-water mark of live since the last reset
+} MallocCount;
+
+// Copy the current counters
+void malloc_count_snapshot(MallocCount* mc);
+
+// Restart the high-water mark from the current live bytes
+void malloc_count_reset_peak(void);
+
+// Count (1, the default) or pass straight through to glibc (0)
+void malloc_count_enable(int on);
+
+#endif // MALLOC_COUNT_H
+
+// vim: expandtab number tabstop=4 shiftwidth=4
+// END
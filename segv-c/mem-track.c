@@ -0,0 +1,173 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <malloc.h>
+#include "malloc-count.h"
+#include "mem-track.h"
+
+static const char* metric_names[MEM_METRICS] = { "rss", "arena", "in_use", "live", "blocks" };
+
+struct MemTrack {
+    MemSpec    spec;
+    uint64_t   started;
+    MemSample* samples;
+    int        count;
+    int        capacity;
+    FILE*      csv;
+};
+
+static uint64_t mono_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static double vm_rss(void)
+{
+    char  line[128];
+    long  kb = 0;
+    FILE* f = fopen("/proc/self/status", "r");
+
+    if (!f)
+        return 0;
+    while (fgets(line, sizeof(line), f))
+        if (strncmp(line, "VmRSS:", 6) == 0) {
+            kb = atol(line + 6);
+            break;
+        }
+    fclose(f);
+    return kb * 1024.0;
+}
+
+MemTrack* mem_track_create(const MemSpec* spec)
+{
+    MemTrack* mt = calloc(1, sizeof(*mt));
+
+    if (!mt)
+        return NULL;
+    mt->spec = *spec;
+    mt->started = mono_ns();
+    if (spec->path) {
+        if (!(mt->csv = fopen(spec->path, "w"))) {
+            free(mt);
+            return NULL;
+        }
+        fprintf(mt->csv, "cycles,elapsed_sec");
+        for (int m = 0; m < MEM_METRICS; m++)
+            fprintf(mt->csv, ",%s", metric_names[m]);
+        fprintf(mt->csv, "\n");
+    }
+    return mt;
+}
+
+const MemSample* mem_track_sample(MemTrack* mt, long cycles)
+{
+    MemSample*  s;
+    MallocCount mc;
+
+    if (mt->count == mt->capacity) {
+        int        cap  = mt->capacity ? mt->capacity * 2 : 256;
+        MemSample* more = realloc(mt->samples, cap * sizeof(MemSample));
+        if (!more)
+            return NULL;
+        mt->samples = more;
+        mt->capacity = cap;
+    }
+    s = &mt->samples[mt->count++];
+    s->cycles = cycles;
+    s->elapsed = (mono_ns() - mt->started) / 1e9;
+    s->v[MEM_RSS] = vm_rss();
+
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 mi = mallinfo2();
+#else
+    struct mallinfo  mi = mallinfo();      // int fields: wrong past 2 GiB
+#endif
+    s->v[MEM_ARENA] = (double)mi.arena + mi.hblkhd;
+    s->v[MEM_IN_USE] = (double)mi.uordblks + mi.hblkhd;
+
+    malloc_count_snapshot(&mc);
+    s->v[MEM_LIVE] = (double)mc.live;
+    s->v[MEM_BLOCKS] = (double)mc.allocs - (double)mc.frees;
+
+    if (mt->csv) {
+        fprintf(mt->csv, "%ld,%.3f", s->cycles, s->elapsed);
+        for (int m = 0; m < MEM_METRICS; m++)
+            fprintf(mt->csv, ",%.0f", s->v[m]);
+        fprintf(mt->csv, "\n");
+        fflush(mt->csv);        // a soak may be killed rather than finish
+    }
+    return s;
+}
+
+void mem_track_fit(const MemTrack* mt, MemTrend* trend)
+{
+    const MemSample* s = mt->samples;
+    long             warmup;
+    int              first = 0, n;
+
+    memset(trend, 0, sizeof(*trend));
+    trend->samples = mt->count;
+    if (mt->count == 0)
+        return;
+
+    warmup = mt->spec.warmup >= 0 ? mt->spec.warmup : s[mt->count - 1].cycles / 10;
+    while (first < mt->count && s[first].cycles < warmup)
+        first++;
+    if (mt->count - first < 3)
+        first = mt->count / 2;
+    n = mt->count - first;
+    trend->fitted = n;
+    trend->cycles = s[mt->count - 1].cycles - s[first].cycles;
+    if (n < 3 || trend->cycles <= 0)
+        return;
+
+    double mx = 0, sxx = 0;
+    for (int i = first; i < mt->count; i++)
+        mx += (double)s[i].cycles / n;
+    for (int i = first; i < mt->count; i++)
+        sxx += (s[i].cycles - mx) * (s[i].cycles - mx);
+
+    for (int m = 0; m < MEM_METRICS; m++) {
+        MemFit* f = &trend->m[m];
+        double  my = 0, sxy = 0, syy = 0, sse;
+
+        for (int i = first; i < mt->count; i++)
+            my += s[i].v[m] / n;
+        for (int i = first; i < mt->count; i++) {
+            sxy += (s[i].cycles - mx) * (s[i].v[m] - my);
+            syy += (s[i].v[m] - my) * (s[i].v[m] - my);
+        }
+        f->slope = sxy / sxx;
+        sse = syy - f->slope * sxy;
+        f->se = sse > 0 ? sqrt(sse / (n - 2) / sxx) : 0;
+        f->r2 = syy > 0 ? f->slope * sxy / syy : 0;
+        f->growth = s[mt->count - 1].v[m] - s[first].v[m];
+        f->leak = f->slope - 2 * f->se > (m == MEM_BLOCKS ? MEM_LEAK_BLOCKS : mt->spec.leak);
+        trend->leak |= f->leak;
+    }
+}
+
+void mem_track_destroy(MemTrack* mt)
+{
+    if (!mt)
+        return;
+    if (mt->csv)
+        fclose(mt->csv);
+    free(mt->samples);
+    free(mt);
+}
+
+const char* mem_metric_name(MemMetric m)
+{
+    return m < MEM_METRICS ? metric_names[m] : "?";
+}
+
+// vim: expandtab number tabstop=4 shiftwidth=4
+// END
@@ -0,0 +1,82 @@
+// mem-track.h - memory growth over a long soak, sampled every N connect cycles
+//
+// A slow per-session leak in the client library is invisible in a short run
+// and only shows as a trend over hours.  Each sample takes the resident set
+// from /proc/self/status, the allocator's own view from mallinfo2() and the
+// malloc-count.c interposition counters; samples are taken between loops,
+// when no session is open.  The fit is a least-squares line per metric
+// through the samples after the warm-up, so its slope is the growth per
+// connect cycle:
+//
+//     MemTrack* mt = mem_track_create(&spec);
+//     mem_track_sample(mt, 0);
+//     ... after each loop: if (cycles >= next) mem_track_sample(mt, cycles);
+//     mem_track_fit(mt, &trend);      // per-cycle slopes and the leak flags
+//     mem_track_destroy(mt);
+//
+// A metric is flagged as leaking when its slope, less two standard errors,
+// is still above the threshold - steady growth, not one late jump.
+#ifndef MEM_TRACK_H
+#define MEM_TRACK_H
+
+#include <stdint.h>
+
+#define MEM_LEAK_BLOCKS     0.5     // outstanding malloc blocks per cycle flagged as a leak
+
+typedef enum {
+    MEM_RSS,            // VmRSS, bytes
+    MEM_ARENA,          // mallinfo2 arena + hblkhd: taken from the system by malloc, bytes
+    MEM_IN_USE,         // mallinfo2 uordblks + hblkhd: handed out by malloc, bytes
+    MEM_LIVE,           // malloc-count live usable bytes
+    MEM_BLOCKS,         // malloc-count allocs - frees
+    MEM_METRICS
+} MemMetric;
+
+typedef struct {
+    const char* spec;   // -M text, for the report
+    long        every;  // cycles between samples
+    long        warmup; // cycles left out of the fit (default: the first 10% of the run)
+    double      leak;   // bytes per cycle a byte metric must exceed to be flagged
+    char*       path;   // samples as CSV, NULL = none
+} MemSpec;
+
+typedef struct {
+    long   cycles;
+    double elapsed;             // seconds since mem_track_create()
+    double v[MEM_METRICS];
+} MemSample;
+
+typedef struct {
+    double slope;               // per cycle
+    double se;                  // standard error of the slope
+    double r2;
+    double growth;              // last fitted sample less the first
+    int    leak;
+} MemFit;
+
+typedef struct {
+    int    samples;             // taken
+    int    fitted;              // after the warm-up; fewer than 3 and no fit is made
+    long   cycles;              // spanned by the fitted samples
+    MemFit m[MEM_METRICS];
+    int    leak;                // any metric flagged
+} MemTrend;
+
+typedef struct MemTrack MemTrack;
+
+// NULL when out of memory or the CSV file cannot be created
+MemTrack* mem_track_create(const MemSpec* spec);
+
+// Take a sample after cycles connect cycles; NULL when out of memory
+const MemSample* mem_track_sample(MemTrack* mt, long cycles);
+
+// Growth per cycle of every metric; a run shorter than the warm-up fits its second half
+void mem_track_fit(const MemTrack* mt, MemTrend* trend);
+
+void        mem_track_destroy(MemTrack* mt);
+const char* mem_metric_name(MemMetric m);
+
+#endif // MEM_TRACK_H
+
+// vim: expandtab number tabstop=4 shiftwidth=4
+// END
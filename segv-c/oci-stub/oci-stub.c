@@ -0,0 +1,1785 @@
+// oci-stub.c - stand-in libclntsh for offline benchmarking of segv-c.
+//
+// Implements the OCI calls used by db-thread and db-handle-size with no
+// network and no Oracle install.  Every call can be given a latency
+// distribution, a failure probability and can be forced through a single
+// process-wide lock to model contention inside the client library.
+//
+// Configuration is read once from the environment:
+//
+//   OCISTUB_LATENCY="attach=normal:2000:300,ping=exp:250,session_begin=4000"
+//       per-call latency in microseconds: fixed:US (or just US),
+//       uniform:LO:HI, normal:MEAN:SD, exp:MEAN
+//   OCISTUB_FAIL="attach=0.01,session_begin=0.005"
+//       per-call failure probability (0..1)
+//   OCISTUB_LOCK="env_create,attach"
+//       calls serialised through one global mutex while they "run"
+//   OCISTUB_ENV_LOCK="handle_alloc,handle_free,attach"
+//       calls serialised through the mutex of the OCI_THREADED environment
+//       they belong to - contention only shows when threads share an env
+//   OCISTUB_HEAP="env=49152,server=16384,session=8192"
+//       simulated heap footprint per handle type, in bytes
+//   OCISTUB_ROWS=1000      rows returned by an unbounded query
+//   OCISTUB_WIDTH=32       width of generated string columns
+//   OCISTUB_SEED=1         RNG seed
+//   OCISTUB_LEAK=256       bytes malloc()ed and never freed per OCISessionBegin,
+//                          a slow per-session client leak for soak runs to find
+//
+// OCI_ATTR_NONBLOCKING_MODE on an attached server handle makes session_begin,
+// session_end, ping and detach return OCI_STILL_EXECUTING until their sampled
+// latency has passed; the caller repeats the same call to poll.  Non-blocking
+// calls never sleep, so OCISTUB_LOCK/OCISTUB_ENV_LOCK do not apply to them.
+//
+// OCIDefineDynamic defines ask their callback for a buffer for every value as
+// it is delivered, first with OCI_FIRST_PIECE, then OCI_NEXT_PIECE for as long
+// as the value does not fit.
+//
+// Call names: env_create handle_alloc handle_free attach detach
+// session_begin session_end ping pool_create session_get session_release
+// stmt_prepare stmt_execute stmt_fetch
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include "oci.h"
+
+#define STUB_MAGIC      0x0C1057B0u
+#define STUB_CHUNK      512         // simulated heap is allocated in chunks of this size
+#define STUB_MSG_SIZE   256
+#define STUB_MAX_COLS   64
+#define STUB_CACHE_MAX  64
+
+// Call models
+
+enum {
+    C_ENV_CREATE, C_HANDLE_ALLOC, C_HANDLE_FREE, C_ATTACH, C_DETACH,
+    C_SESSION_BEGIN, C_SESSION_END, C_PING, C_POOL_CREATE, C_SESSION_GET,
+    C_SESSION_RELEASE, C_STMT_PREPARE, C_STMT_EXECUTE, C_STMT_FETCH,
+    C_COUNT
+};
+
+static const char* call_names[C_COUNT] = {
+    "env_create", "handle_alloc", "handle_free", "attach", "detach",
+    "session_begin", "session_end", "ping", "pool_create", "session_get",
+    "session_release", "stmt_prepare", "stmt_execute", "stmt_fetch"
+};
+
+enum { D_NONE, D_FIXED, D_UNIFORM, D_NORMAL, D_EXP };
+
+typedef struct {
+    int     dist;
+    double  a;
+    double  b;
+    double  fail;       // failure probability
+    int     locked;     // serialise through stub_global
+    int     errcode;    // ORA- code reported on injected failure
+    const char* errtext;
+    int     env_locked; // serialise through the owning OCI_THREADED env
+} CallModel;
+
+// Defaults loosely model a client on the same LAN as the listener
+static CallModel models[C_COUNT] = {
+    [C_ENV_CREATE]      = { D_FIXED,   150,    0, 0, 0,  1019, "unable to allocate memory in the user side" },
+    [C_HANDLE_ALLOC]    = { D_NONE,      0,    0, 0, 0,  1019, "unable to allocate memory in the user side" },
+    [C_HANDLE_FREE]     = { D_NONE,      0,    0, 0, 0, 24432, "invalid handle" },
+    [C_ATTACH]          = { D_NORMAL, 2000,  300, 0, 0, 12541, "TNS:no listener" },
+    [C_DETACH]          = { D_FIXED,   200,    0, 0, 0,  3114, "not connected to ORACLE" },
+    [C_SESSION_BEGIN]   = { D_NORMAL, 4000,  600, 0, 0,  1017, "invalid username/password; logon denied" },
+    [C_SESSION_END]     = { D_FIXED,   300,    0, 0, 0,  3114, "not connected to ORACLE" },
+    [C_PING]            = { D_NORMAL,  300,   50, 0, 0,  3113, "end-of-file on communication channel" },
+    [C_POOL_CREATE]     = { D_FIXED,   500,    0, 0, 0, 24415, "Missing or null username." },
+    [C_SESSION_GET]     = { D_FIXED,    20,    0, 0, 0, 24496, "OCISessionGet() timed out waiting for a free connection." },
+    [C_SESSION_RELEASE] = { D_FIXED,    10,    0, 0, 0, 24413, "Invalid number of sessions specified" },
+    [C_STMT_PREPARE]    = { D_FIXED,    50,    0, 0, 0,   900, "invalid SQL statement" },
+    [C_STMT_EXECUTE]    = { D_NORMAL,  350,   60, 0, 0,  3113, "end-of-file on communication channel" },
+    [C_STMT_FETCH]      = { D_NORMAL,  300,   50, 0, 0,  3113, "end-of-file on communication channel" },
+};
+
+// Simulated heap footprint per handle type (bytes)
+static size_t heap_env      = 49152;
+static size_t heap_error    = 512;
+static size_t heap_server   = 16384;
+static size_t heap_svcctx   = 1024;
+static size_t heap_session  = 8192;
+static size_t heap_stmt     = 4096;
+static size_t heap_spool    = 2048;
+
+static long         stub_rows   = 1000;
+static int          stub_width  = 32;
+static uint64_t     stub_seed   = 1;
+static size_t       stub_leak   = 0;
+static void*        stub_leaked;    // last block lost, so the compiler cannot drop the malloc
+
+static pthread_once_t   stub_once   = PTHREAD_ONCE_INIT;
+static pthread_mutex_t  stub_global = PTHREAD_MUTEX_INITIALIZER;
+
+static int call_lookup(const char* name, size_t len)
+{
+    for (int c = 0; c < C_COUNT; c++)
+        if (strlen(call_names[c]) == len && strncmp(call_names[c], name, len) == 0)
+            return c;
+    fprintf(stderr, "oci-stub: unknown call '%.*s'\n", (int)len, name);
+    return -1;
+}
+
+// Parse "name=value,name=value" calling fn for each pair
+static void parse_list(const char* var, void (*fn)(int call, const char* value))
+{
+    const char* spec = getenv(var);
+    char* copy;
+    char* save = NULL;
+
+    if (!spec || !*spec)
+        return;
+
+    copy = strdup(spec);
+    for (char* tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        char* eq = strchr(tok, '=');
+        int   c  = call_lookup(tok, eq ? (size_t)(eq - tok) : strlen(tok));
+        if (c >= 0)
+            fn(c, eq ? eq + 1 : "");
+    }
+    free(copy);
+}
+
+static void set_latency(int c, const char* value)
+{
+    CallModel* m = &models[c];
+    double a = 0, b = 0;
+
+    if (strncmp(value, "fixed:", 6) == 0) {
+        m->dist = D_FIXED;   a = atof(value + 6);
+    } else if (strncmp(value, "uniform:", 8) == 0) {
+        m->dist = D_UNIFORM; sscanf(value + 8, "%lf:%lf", &a, &b);
+    } else if (strncmp(value, "normal:", 7) == 0) {
+        m->dist = D_NORMAL;  sscanf(value + 7, "%lf:%lf", &a, &b);
+    } else if (strncmp(value, "exp:", 4) == 0) {
+        m->dist = D_EXP;     a = atof(value + 4);
+    } else {
+        m->dist = D_FIXED;   a = atof(value);
+    }
+    if (m->dist == D_FIXED && a <= 0)
+        m->dist = D_NONE;
+    m->a = a;
+    m->b = b;
+}
+
+static void set_fail(int c, const char* value)   { models[c].fail = atof(value); }
+static void set_locked(int c, const char* value) { (void)value; models[c].locked = 1; }
+static void set_env_locked(int c, const char* value) { (void)value; models[c].env_locked = 1; }
+
+static void set_heap(const char* spec)
+{
+    char* copy;
+    char* save = NULL;
+
+    if (!spec || !*spec)
+        return;
+
+    copy = strdup(spec);
+    for (char* tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        char*  eq = strchr(tok, '=');
+        size_t v;
+        if (!eq)
+            continue;
+        *eq = '\0';
+        v = strtoul(eq + 1, NULL, 0);
+        if      (strcmp(tok, "env")     == 0) heap_env     = v;
+        else if (strcmp(tok, "error")   == 0) heap_error   = v;
+        else if (strcmp(tok, "server")  == 0) heap_server  = v;
+        else if (strcmp(tok, "svcctx")  == 0) heap_svcctx  = v;
+        else if (strcmp(tok, "session") == 0) heap_session = v;
+        else if (strcmp(tok, "stmt")    == 0) heap_stmt    = v;
+        else if (strcmp(tok, "spool")   == 0) heap_spool   = v;
+        else fprintf(stderr, "oci-stub: unknown heap type '%s'\n", tok);
+    }
+    free(copy);
+}
+
+static void stub_init(void)
+{
+    const char* s;
+
+    parse_list("OCISTUB_LATENCY", set_latency);
+    parse_list("OCISTUB_FAIL",    set_fail);
+    parse_list("OCISTUB_LOCK",    set_locked);
+    parse_list("OCISTUB_ENV_LOCK", set_env_locked);
+    set_heap(getenv("OCISTUB_HEAP"));
+
+    if ((s = getenv("OCISTUB_ROWS"))  && *s) stub_rows  = atol(s);
+    if ((s = getenv("OCISTUB_WIDTH")) && *s) stub_width = atoi(s);
+    if ((s = getenv("OCISTUB_SEED"))  && *s) stub_seed  = strtoull(s, NULL, 0);
+    if ((s = getenv("OCISTUB_LEAK"))  && *s) stub_leak  = strtoul(s, NULL, 0);
+    if (stub_width < 1)
+        stub_width = 1;
+}
+
+static inline void stub_ready(void) { pthread_once(&stub_once, stub_init); }
+
+// Random numbers and delays
+
+static __thread uint64_t rng_state;
+
+static uint64_t rng_next(void)
+{
+    if (rng_state == 0) {
+        // splitmix64 of (seed, thread sequence) - short lived threads only
+        // draw a handful of numbers, so the first ones must already be mixed
+        static uint64_t seq;
+        uint64_t z = stub_seed * 0x9E3779B97F4A7C15ull
+                   + __atomic_add_fetch(&seq, 1, __ATOMIC_RELAXED) * 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        rng_state = z ^ (z >> 31);
+        if (rng_state == 0)
+            rng_state = 1;
+    }
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1Dull;
+}
+
+static double rng_unit(void) { return (rng_next() >> 11) * (1.0 / 9007199254740992.0); }
+
+static double sample_us(const CallModel* m)
+{
+    double u, v;
+
+    switch (m->dist) {
+        case D_FIXED:
+            return m->a;
+        case D_UNIFORM:
+            return m->a + (m->b - m->a) * rng_unit();
+        case D_NORMAL:
+            do { u = rng_unit(); } while (u <= 0.0);
+            v = rng_unit();
+            return m->a + m->b * sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+        case D_EXP:
+            do { u = rng_unit(); } while (u <= 0.0);
+            return -m->a * log(u);
+        default:
+            return 0.0;
+    }
+}
+
+static void sleep_us(double us)
+{
+    struct timespec ts;
+
+    if (us <= 0.0)
+        return;
+    ts.tv_sec  = (time_t)(us / 1e6);
+    ts.tv_nsec = (long)((us - ts.tv_sec * 1e6) * 1e3);
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+        ;
+}
+
+// Handles
+
+typedef struct StubHdr StubHdr;
+
+struct StubHdr {
+    ub4         magic;
+    ub4         type;
+    OCIEnv*     env;
+    StubHdr*    next;       // env child list
+    StubHdr*    prev;
+    void**      heap;       // simulated footprint
+    size_t      heap_n;
+};
+
+struct OCIEnv {
+    StubHdr     hdr;
+    ub4         mode;
+    void*       ctxp;
+    void*     (*malocfp)(void*, size_t);
+    void*     (*ralocfp)(void*, void*, size_t);
+    void      (*mfreefp)(void*, void*);
+    pthread_mutex_t lock;   // child list
+    pthread_mutex_t call_lock; // OCISTUB_ENV_LOCK calls on an OCI_THREADED env
+    StubHdr*    children;
+    int         errcode;    // for OCIErrorGet(envhp, ..., OCI_HTYPE_ENV)
+    char        errmsg[STUB_MSG_SIZE];
+};
+
+struct OCIError {
+    StubHdr     hdr;
+    int         errcode;
+    char        errmsg[STUB_MSG_SIZE];
+};
+
+struct OCIServer {
+    StubHdr     hdr;
+    int         attached;
+    int         nonblocking;    // OCI_ATTR_NONBLOCKING_MODE
+    int         pending;        // call in progress + 1, 0 = none
+    int         pending_fail;
+    uint64_t    pending_until;  // CLOCK_MONOTONIC ns the call completes
+    char        dblink[128];
+};
+
+typedef struct {
+    char*       sql;
+    OCIStmt*    stmt;
+    uint64_t    used;
+} CacheEntry;
+
+struct OCIStmt;
+
+struct OCISvcCtx {
+    StubHdr     hdr;
+    OCIServer*  server;
+    OCISession* session;
+    OCISPool*   pool;           // set for sessions borrowed from a pool
+    void*       pooled;         // PoolSession backing this service context
+    ub4         cache_size;
+    CacheEntry  cache[STUB_CACHE_MAX];
+    uint64_t    cache_clock;
+    uint64_t    round_trips;
+};
+
+struct OCISession {
+    StubHdr     hdr;
+    int         active;
+    char        username[64];
+    char        password[64];
+};
+
+typedef struct {
+    ub4         pos;
+    void*       valuep;
+    sb4         value_sz;
+    ub2         dty;
+    sb2*        indp;
+    ub2*        rlenp;
+    ub2*        rcodep;
+    OCICallbackDefine cbf;      // OCIDefineDynamic, NULL for a plain define
+    void*       cbctx;
+} StubDefine;
+
+struct OCIStmt {
+    StubHdr     hdr;
+    OCISvcCtx*  svc;
+    char*       sql;
+    int         cached;         // owned by the svcctx statement cache
+    int         is_query;
+    int         ncols;
+    long        rows_total;     // rows in the result set
+    long        rows_sent;      // rows transferred from "server" so far
+    long        rows_taken;     // rows handed to the caller
+    long        buffered;       // prefetched rows waiting client side
+    ub4         rows_fetched;   // last fetch
+    ub4         row_count;
+    ub4         prefetch_rows;
+    ub4         prefetch_mem;
+    ub4         stmt_type;
+    StubDefine  defs[STUB_MAX_COLS];
+};
+
+struct OCIDefine {
+    StubHdr     hdr;
+};
+
+struct OCIBind {
+    StubHdr     hdr;
+};
+
+typedef struct PoolSession PoolSession;
+
+struct PoolSession {
+    OCISvcCtx*  svc;
+    OCIServer*  srv;
+    OCISession* ses;
+    PoolSession* next;
+};
+
+struct OCISPool {
+    StubHdr     hdr;
+    char        name[32];
+    char        dblink[128];
+    char        username[64];
+    char        password[64];
+    ub4         min, max, incr;
+    ub4         open;
+    ub4         busy;
+    ub4         getmode;
+    PoolSession* idle;
+    pthread_mutex_t lock;
+    pthread_cond_t  freed;
+    OCISPool*   next;           // registry
+};
+
+static pthread_mutex_t  pool_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static OCISPool*        pool_registry;
+static int              pool_serial;
+
+static void* env_alloc(OCIEnv* env, size_t size)
+{
+    void* p = (env && env->malocfp) ? env->malocfp(env->ctxp, size) : malloc(size);
+    if (p)
+        memset(p, 0, size);
+    return p;
+}
+
+static void env_free(OCIEnv* env, void* p)
+{
+    if (!p)
+        return;
+    if (env && env->mfreefp)
+        env->mfreefp(env->ctxp, p);
+    else
+        free(p);
+}
+
+static void heap_grow(OCIEnv* env, StubHdr* h, size_t bytes)
+{
+    size_t n = (bytes + STUB_CHUNK - 1) / STUB_CHUNK;
+
+    if (n == 0)
+        return;
+    h->heap = env_alloc(env, n * sizeof(void*));
+    if (!h->heap)
+        return;
+    for (size_t i = 0; i < n; i++) {
+        h->heap[i] = env_alloc(env, STUB_CHUNK);
+        if (!h->heap[i])
+            break;
+        h->heap_n++;
+    }
+}
+
+static void heap_release(OCIEnv* env, StubHdr* h)
+{
+    for (size_t i = 0; i < h->heap_n; i++)
+        env_free(env, h->heap[i]);
+    env_free(env, h->heap);
+    h->heap   = NULL;
+    h->heap_n = 0;
+}
+
+static int valid(const void* p, ub4 type)
+{
+    const StubHdr* h = p;
+    return h && h->magic == STUB_MAGIC && (type == 0 || h->type == type);
+}
+
+static void set_error(OCIError* errhp, int code, const char* text)
+{
+    if (!valid(errhp, OCI_HTYPE_ERROR))
+        return;
+    errhp->errcode = code;
+    snprintf(errhp->errmsg, sizeof(errhp->errmsg), "ORA-%05d: %s", code, text);
+}
+
+static void clear_error(OCIError* errhp)
+{
+    if (valid(errhp, OCI_HTYPE_ERROR))
+        errhp->errcode = 0;
+}
+
+// Simulate the cost of a call; returns OCI_ERROR on injected failure.
+// env is the owning environment when errhp does not already say
+static sword stub_call(int c, OCIEnv* env, OCIError* errhp)
+{
+    const CallModel* m = &models[c];
+    double us = sample_us(m);
+
+    if (!env && valid(errhp, OCI_HTYPE_ERROR))
+        env = errhp->hdr.env;
+    if (!(m->env_locked && env && (env->mode & OCI_THREADED)))
+        env = NULL;
+
+    if (env)
+        pthread_mutex_lock(&env->call_lock);
+    if (m->locked) {
+        pthread_mutex_lock(&stub_global);
+        sleep_us(us);
+        pthread_mutex_unlock(&stub_global);
+    } else {
+        sleep_us(us);
+    }
+    if (env)
+        pthread_mutex_unlock(&env->call_lock);
+
+    if (m->fail > 0.0 && rng_unit() < m->fail) {
+        set_error(errhp, m->errcode, m->errtext);
+        return OCI_ERROR;
+    }
+    clear_error(errhp);
+    return OCI_SUCCESS;
+}
+
+static uint64_t mono_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// stub_call() for calls that go over srv: in non-blocking mode the first call
+// starts the operation and every repeat polls it, nothing ever sleeps
+static sword stub_call_nb(int c, OCIServer* srv, OCIError* errhp)
+{
+    const CallModel* m = &models[c];
+
+    if (!srv || !srv->nonblocking)
+        return stub_call(c, NULL, errhp);
+
+    if (!srv->pending) {
+        srv->pending       = c + 1;
+        srv->pending_until = mono_ns() + (uint64_t)(sample_us(m) * 1e3);
+        srv->pending_fail  = m->fail > 0.0 && rng_unit() < m->fail;
+        return OCI_STILL_EXECUTING;
+    }
+    if (srv->pending != c + 1) {
+        set_error(errhp, 3127, "no new operations allowed until the active operation ends");
+        return OCI_ERROR;
+    }
+    if (mono_ns() < srv->pending_until)
+        return OCI_STILL_EXECUTING;
+
+    srv->pending = 0;
+    if (srv->pending_fail) {
+        set_error(errhp, m->errcode, m->errtext);
+        return OCI_ERROR;
+    }
+    clear_error(errhp);
+    return OCI_SUCCESS;
+}
+
+static size_t handle_size(ub4 type)
+{
+    switch (type) {
+        case OCI_HTYPE_ERROR:   return sizeof(struct OCIError);
+        case OCI_HTYPE_SVCCTX:  return sizeof(struct OCISvcCtx);
+        case OCI_HTYPE_STMT:    return sizeof(struct OCIStmt);
+        case OCI_HTYPE_SERVER:  return sizeof(struct OCIServer);
+        case OCI_HTYPE_SESSION: return sizeof(struct OCISession);
+        case OCI_HTYPE_SPOOL:   return sizeof(struct OCISPool);
+        case OCI_HTYPE_DEFINE:  return sizeof(struct OCIDefine);
+        case OCI_HTYPE_BIND:    return sizeof(struct OCIBind);
+        default:                return 0;
+    }
+}
+
+static size_t handle_heap(ub4 type)
+{
+    switch (type) {
+        case OCI_HTYPE_ERROR:   return heap_error;
+        case OCI_HTYPE_SVCCTX:  return heap_svcctx;
+        case OCI_HTYPE_STMT:    return heap_stmt;
+        case OCI_HTYPE_SERVER:  return heap_server;
+        case OCI_HTYPE_SESSION: return heap_session;
+        case OCI_HTYPE_SPOOL:   return heap_spool;
+        default:                return 0;
+    }
+}
+
+static void child_link(OCIEnv* env, StubHdr* h)
+{
+    pthread_mutex_lock(&env->lock);
+    h->next = env->children;
+    if (env->children)
+        env->children->prev = h;
+    env->children = h;
+    pthread_mutex_unlock(&env->lock);
+}
+
+static void child_unlink(OCIEnv* env, StubHdr* h)
+{
+    pthread_mutex_lock(&env->lock);
+    if (h->prev)
+        h->prev->next = h->next;
+    else
+        env->children = h->next;
+    if (h->next)
+        h->next->prev = h->prev;
+    pthread_mutex_unlock(&env->lock);
+}
+
+static void stmt_reset(OCIStmt* st);
+static void stmt_cache_flush(OCISvcCtx* svc);
+static void pool_destroy(OCISPool* sp);
+
+static void handle_destroy(StubHdr* h)
+{
+    OCIEnv* env = h->env;
+
+    switch (h->type) {
+        case OCI_HTYPE_STMT:
+            stmt_reset((OCIStmt*)h);
+            break;
+        case OCI_HTYPE_SVCCTX:
+            stmt_cache_flush((OCISvcCtx*)h);
+            break;
+        case OCI_HTYPE_SPOOL:
+            pool_destroy((OCISPool*)h);
+            break;
+    }
+    heap_release(env, h);
+    h->magic = 0;
+    env_free(env, h);
+}
+
+static sword env_create(OCIEnv** envp, ub4 mode, void* ctxp,
+                        void* (*malocfp)(void*, size_t),
+                        void* (*ralocfp)(void*, void*, size_t),
+                        void  (*mfreefp)(void*, void*),
+                        size_t xtramem_sz, void** usrmempp)
+{
+    OCIEnv* env;
+    sword   status;
+
+    stub_ready();
+
+    if (!envp)
+        return OCI_INVALID_HANDLE;
+    *envp = NULL;
+
+    if ((status = stub_call(C_ENV_CREATE, NULL, NULL)) != OCI_SUCCESS)
+        return status;
+
+    env = malocfp ? malocfp(ctxp, sizeof(*env) + xtramem_sz) : malloc(sizeof(*env) + xtramem_sz);
+    if (!env)
+        return OCI_ERROR;
+    memset(env, 0, sizeof(*env) + xtramem_sz);
+
+    env->hdr.magic = STUB_MAGIC;
+    env->hdr.type  = OCI_HTYPE_ENV;
+    env->hdr.env   = env;
+    env->mode      = mode;
+    env->ctxp      = ctxp;
+    env->malocfp   = malocfp;
+    env->ralocfp   = ralocfp;
+    env->mfreefp   = mfreefp;
+    pthread_mutex_init(&env->lock, NULL);
+    pthread_mutex_init(&env->call_lock, NULL);
+
+    if (usrmempp)
+        *usrmempp = xtramem_sz ? (void*)(env + 1) : NULL;
+
+    heap_grow(env, &env->hdr, heap_env + ((mode & OCI_THREADED) ? heap_env / 4 : 0));
+
+    *envp = env;
+    return OCI_SUCCESS;
+}
+
+sword OCIEnvCreate(OCIEnv **envp, ub4 mode, void *ctxp,
+                   void *(*malocfp)(void *ctxp, size_t size),
+                   void *(*ralocfp)(void *ctxp, void *memptr, size_t newsize),
+                   void  (*mfreefp)(void *ctxp, void *memptr),
+                   size_t xtramem_sz, void **usrmempp)
+{
+    return env_create(envp, mode, ctxp, malocfp, ralocfp, mfreefp, xtramem_sz, usrmempp);
+}
+
+sword OCIEnvNlsCreate(OCIEnv **envp, ub4 mode, void *ctxp,
+                      void *(*malocfp)(void *ctxp, size_t size),
+                      void *(*ralocfp)(void *ctxp, void *memptr, size_t newsize),
+                      void  (*mfreefp)(void *ctxp, void *memptr),
+                      size_t xtramem_sz, void **usrmempp,
+                      ub2 charset, ub2 ncharset)
+{
+    (void)charset;
+    (void)ncharset;
+    return env_create(envp, mode, ctxp, malocfp, ralocfp, mfreefp, xtramem_sz, usrmempp);
+}
+
+sword OCIHandleAlloc(const void *parenth, void **hndlpp, const ub4 type,
+                     const size_t xtramem_sz, void **usrmempp)
+{
+    OCIEnv*  env = (OCIEnv*)parenth;
+    StubHdr* h;
+    size_t   size = handle_size(type);
+    sword    status;
+
+    stub_ready();
+
+    if (!valid(env, OCI_HTYPE_ENV) || !hndlpp || size == 0)
+        return OCI_INVALID_HANDLE;
+    *hndlpp = NULL;
+
+    if ((status = stub_call(C_HANDLE_ALLOC, env, NULL)) != OCI_SUCCESS)
+        return status;
+
+    if (!(h = env_alloc(env, size + xtramem_sz)))
+        return OCI_ERROR;
+
+    h->magic = STUB_MAGIC;
+    h->type  = type;
+    h->env   = env;
+    heap_grow(env, h, handle_heap(type));
+
+    if (type == OCI_HTYPE_SPOOL) {
+        OCISPool* sp = (OCISPool*)h;
+        pthread_mutex_init(&sp->lock, NULL);
+        pthread_cond_init(&sp->freed, NULL);
+    }
+    if (type == OCI_HTYPE_STMT)
+        ((OCIStmt*)h)->prefetch_rows = 1;
+
+    if (usrmempp)
+        *usrmempp = xtramem_sz ? (char*)h + size : NULL;
+
+    child_link(env, h);
+    *hndlpp = h;
+    return OCI_SUCCESS;
+}
+
+sword OCIHandleFree(void *hndlp, const ub4 type)
+{
+    StubHdr* h = hndlp;
+
+    stub_ready();
+
+    if (!valid(h, type))
+        return OCI_INVALID_HANDLE;
+
+    stub_call(C_HANDLE_FREE, type == OCI_HTYPE_ENV ? NULL : h->env, NULL);
+
+    if (type == OCI_HTYPE_ENV) {
+        OCIEnv* env = (OCIEnv*)h;
+        StubHdr* c;
+
+        // Freeing an environment releases everything allocated under it,
+        // session pools first as they own handles of their own
+        for (c = env->children; c; ) {
+            StubHdr* next = c->next;
+            if (c->type == OCI_HTYPE_SPOOL) {
+                child_unlink(env, c);
+                handle_destroy(c);
+            }
+            c = next;
+        }
+        while ((c = env->children) != NULL) {
+            env->children = c->next;
+            handle_destroy(c);
+        }
+        heap_release(env, h);
+        pthread_mutex_destroy(&env->lock);
+        pthread_mutex_destroy(&env->call_lock);
+        h->magic = 0;
+        if (env->mfreefp)
+            env->mfreefp(env->ctxp, env);
+        else
+            free(env);
+        return OCI_SUCCESS;
+    }
+
+    child_unlink(h->env, h);
+    handle_destroy(h);
+    return OCI_SUCCESS;
+}
+
+sword OCIDescriptorFree(void *descp, const ub4 type)
+{
+    (void)descp;
+    (void)type;
+    return OCI_SUCCESS;
+}
+
+sword OCIErrorGet(void *hndlp, ub4 recordno, OraText *sqlstate, sb4 *errcodep,
+                  OraText *bufp, ub4 bufsiz, ub4 type)
+{
+    const char* msg;
+    int code;
+
+    if (type == OCI_HTYPE_ERROR && valid(hndlp, OCI_HTYPE_ERROR)) {
+        code = ((OCIError*)hndlp)->errcode;
+        msg  = ((OCIError*)hndlp)->errmsg;
+    } else if (type == OCI_HTYPE_ENV && valid(hndlp, OCI_HTYPE_ENV)) {
+        code = ((OCIEnv*)hndlp)->errcode;
+        msg  = ((OCIEnv*)hndlp)->errmsg;
+    } else {
+        return OCI_INVALID_HANDLE;
+    }
+
+    if (recordno != 1 || code == 0)
+        return OCI_NO_DATA;
+
+    if (sqlstate)
+        memcpy(sqlstate, "HY000", 6);
+    if (errcodep)
+        *errcodep = code;
+    if (bufp && bufsiz) {
+        strncpy((char*)bufp, msg, bufsiz - 1);
+        bufp[bufsiz - 1] = '\0';
+    }
+    return OCI_SUCCESS;
+}
+
+// Attributes
+
+static void copy_text(char* dst, size_t dstsz, const void* src, ub4 len)
+{
+    size_t n = src ? (len ? len : strlen(src)) : 0;
+    if (n >= dstsz)
+        n = dstsz - 1;
+    if (n)
+        memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+sword OCIAttrSet(void *trgthndlp, ub4 trghndltyp, void *attributep,
+                 ub4 size, ub4 attrtype, OCIError *errhp)
+{
+    stub_ready();
+
+    if (!valid(trgthndlp, trghndltyp))
+        return OCI_INVALID_HANDLE;
+
+    switch (trghndltyp) {
+        case OCI_HTYPE_SVCCTX: {
+            OCISvcCtx* svc = trgthndlp;
+            if (attrtype == OCI_ATTR_SERVER)  { svc->server  = attributep; return OCI_SUCCESS; }
+            if (attrtype == OCI_ATTR_SESSION) { svc->session = attributep; return OCI_SUCCESS; }
+            if (attrtype == OCI_ATTR_STMTCACHESIZE) {
+                ub4 n = attributep ? *(ub4*)attributep : 0;
+                stmt_cache_flush(svc);
+                svc->cache_size = n > STUB_CACHE_MAX ? STUB_CACHE_MAX : n;
+                return OCI_SUCCESS;
+            }
+            break;
+        }
+        case OCI_HTYPE_SERVER: {
+            OCIServer* srv = trgthndlp;
+            if (attrtype == OCI_ATTR_NONBLOCKING_MODE) {
+                // Toggles, like the real thing; only an attached server has a connection to switch
+                if (!srv->attached) {
+                    set_error(errhp, 3114, "not connected to ORACLE");
+                    return OCI_ERROR;
+                }
+                if (srv->pending) {
+                    set_error(errhp, 3127, "no new operations allowed until the active operation ends");
+                    return OCI_ERROR;
+                }
+                srv->nonblocking = !srv->nonblocking;
+                return OCI_SUCCESS;
+            }
+            break;
+        }
+        case OCI_HTYPE_SESSION: {
+            OCISession* ses = trgthndlp;
+            if (attrtype == OCI_ATTR_USERNAME) { copy_text(ses->username, sizeof(ses->username), attributep, size); return OCI_SUCCESS; }
+            if (attrtype == OCI_ATTR_PASSWORD) { copy_text(ses->password, sizeof(ses->password), attributep, size); return OCI_SUCCESS; }
+            break;
+        }
+        case OCI_HTYPE_STMT: {
+            OCIStmt* st = trgthndlp;
+            if (attrtype == OCI_ATTR_PREFETCH_ROWS)   { st->prefetch_rows = *(ub4*)attributep; return OCI_SUCCESS; }
+            if (attrtype == OCI_ATTR_PREFETCH_MEMORY) { st->prefetch_mem  = *(ub4*)attributep; return OCI_SUCCESS; }
+            break;
+        }
+        case OCI_HTYPE_SPOOL: {
+            OCISPool* sp = trgthndlp;
+            if (attrtype == OCI_ATTR_SPOOL_GETMODE) { sp->getmode = *(ub1*)attributep; return OCI_SUCCESS; }
+            if (attrtype == OCI_ATTR_SPOOL_TIMEOUT) return OCI_SUCCESS;
+            break;
+        }
+    }
+
+    set_error(errhp, 24315, "illegal attribute type");
+    return OCI_ERROR;
+}
+
+sword OCIAttrGet(const void *trgthndlp, ub4 trghndltyp, void *attributep,
+                 ub4 *sizep, ub4 attrtype, OCIError *errhp)
+{
+    stub_ready();
+
+    if (!valid(trgthndlp, trghndltyp) || !attributep)
+        return OCI_INVALID_HANDLE;
+
+    switch (trghndltyp) {
+        case OCI_HTYPE_SVCCTX: {
+            const OCISvcCtx* svc = trgthndlp;
+            if (attrtype == OCI_ATTR_SERVER)  { *(OCIServer**)attributep  = svc->server;  return OCI_SUCCESS; }
+            if (attrtype == OCI_ATTR_SESSION) { *(OCISession**)attributep = svc->session; return OCI_SUCCESS; }
+            if (attrtype == OCI_ATTR_STMTCACHESIZE) { *(ub4*)attributep = svc->cache_size; return OCI_SUCCESS; }
+            break;
+        }
+        case OCI_HTYPE_SERVER: {
+            const OCIServer* srv = trgthndlp;
+            if (attrtype == OCI_ATTR_NONBLOCKING_MODE) { *(ub1*)attributep = (ub1)srv->nonblocking; return OCI_SUCCESS; }
+            break;
+        }
+        case OCI_HTYPE_STMT: {
+            const OCIStmt* st = trgthndlp;
+            if (attrtype == OCI_ATTR_ROWS_FETCHED) { *(ub4*)attributep = st->rows_fetched; return OCI_SUCCESS; }
+            if (attrtype == OCI_ATTR_ROW_COUNT)    { *(ub4*)attributep = st->row_count;    return OCI_SUCCESS; }
+            if (attrtype == OCI_ATTR_PARAM_COUNT)  { *(ub4*)attributep = st->ncols;        return OCI_SUCCESS; }
+            if (attrtype == OCI_ATTR_STMT_TYPE)    { *(ub2*)attributep = st->stmt_type;    return OCI_SUCCESS; }
+            break;
+        }
+        case OCI_HTYPE_SPOOL: {
+            OCISPool* sp = (OCISPool*)trgthndlp;
+            ub4 v;
+            if (attrtype == OCI_ATTR_SPOOL_BUSY_COUNT || attrtype == OCI_ATTR_SPOOL_OPEN_COUNT) {
+                pthread_mutex_lock(&sp->lock);
+                v = attrtype == OCI_ATTR_SPOOL_BUSY_COUNT ? sp->busy : sp->open;
+                pthread_mutex_unlock(&sp->lock);
+                *(ub4*)attributep = v;
+                return OCI_SUCCESS;
+            }
+            break;
+        }
+    }
+    (void)sizep;
+
+    set_error(errhp, 24315, "illegal attribute type");
+    return OCI_ERROR;
+}
+
+// Server / session
+
+sword OCIServerAttach(OCIServer *srvhp, OCIError *errhp,
+                      const OraText *dblink, sb4 dblink_len, ub4 mode)
+{
+    sword status;
+    (void)mode;
+
+    stub_ready();
+
+    if (!valid(srvhp, OCI_HTYPE_SERVER) || !valid(errhp, OCI_HTYPE_ERROR))
+        return OCI_INVALID_HANDLE;
+
+    if (!dblink || dblink_len <= 0) {
+        set_error(errhp, 12162, "TNS:net service name is incorrectly specified");
+        return OCI_ERROR;
+    }
+    if ((status = stub_call(C_ATTACH, NULL, errhp)) != OCI_SUCCESS)
+        return status;
+
+    copy_text(srvhp->dblink, sizeof(srvhp->dblink), dblink, (ub4)dblink_len);
+    srvhp->attached = 1;
+    return OCI_SUCCESS;
+}
+
+sword OCIServerDetach(OCIServer *srvhp, OCIError *errhp, ub4 mode)
+{
+    sword status;
+    (void)mode;
+
+    stub_ready();
+
+    if (!valid(srvhp, OCI_HTYPE_SERVER))
+        return OCI_INVALID_HANDLE;
+    if (!srvhp->attached) {
+        set_error(errhp, 24327, "need explicit attach before authenticating a user");
+        return OCI_ERROR;
+    }
+    if ((status = stub_call_nb(C_DETACH, srvhp, errhp)) == OCI_STILL_EXECUTING)
+        return status;
+    srvhp->attached = 0;
+    srvhp->nonblocking = 0;
+    return status;
+}
+
+sword OCISessionBegin(OCISvcCtx *svchp, OCIError *errhp, OCISession *usrhp,
+                      ub4 credt, ub4 mode)
+{
+    sword status;
+    (void)mode;
+
+    stub_ready();
+
+    if (!valid(svchp, OCI_HTYPE_SVCCTX) || !valid(usrhp, OCI_HTYPE_SESSION))
+        return OCI_INVALID_HANDLE;
+
+    if (!svchp->server || !svchp->server->attached) {
+        set_error(errhp, 24327, "need explicit attach before authenticating a user");
+        return OCI_ERROR;
+    }
+    if (credt == OCI_CRED_RDBMS && (!usrhp->username[0] || !usrhp->password[0])) {
+        set_error(errhp, 1017, "invalid username/password; logon denied");
+        return OCI_ERROR;
+    }
+    if ((status = stub_call_nb(C_SESSION_BEGIN, svchp->server, errhp)) != OCI_SUCCESS)
+        return status;
+
+    usrhp->active = 1;
+    svchp->round_trips += 2;
+
+    // Touched so it shows in RSS too, then forgotten
+    if (stub_leak) {
+        void* lost = malloc(stub_leak);
+        if (lost) {
+            memset(lost, 0x5a, stub_leak);
+            __atomic_store_n(&stub_leaked, lost, __ATOMIC_RELAXED);
+        }
+    }
+    return OCI_SUCCESS;
+}
+
+sword OCISessionEnd(OCISvcCtx *svchp, OCIError *errhp, OCISession *usrhp,
+                    ub4 mode)
+{
+    sword status;
+    (void)mode;
+
+    stub_ready();
+
+    if (!valid(svchp, OCI_HTYPE_SVCCTX) || !valid(usrhp, OCI_HTYPE_SESSION))
+        return OCI_INVALID_HANDLE;
+    if (!usrhp->active) {
+        set_error(errhp, 1012, "not logged on");
+        return OCI_ERROR;
+    }
+    if ((status = stub_call_nb(C_SESSION_END, svchp->server, errhp)) == OCI_STILL_EXECUTING)
+        return status;
+    usrhp->active = 0;
+    svchp->round_trips++;
+    return status;
+}
+
+static int svc_connected(OCISvcCtx* svchp, OCIError* errhp)
+{
+    if (!svchp->server || !svchp->server->attached || !svchp->session || !svchp->session->active) {
+        set_error(errhp, 3114, "not connected to ORACLE");
+        return 0;
+    }
+    return 1;
+}
+
+sword OCIPing(OCISvcCtx *svchp, OCIError *errhp, ub4 mode)
+{
+    sword status;
+    (void)mode;
+
+    stub_ready();
+
+    if (!valid(svchp, OCI_HTYPE_SVCCTX))
+        return OCI_INVALID_HANDLE;
+    if (!svc_connected(svchp, errhp))
+        return OCI_ERROR;
+
+    if ((status = stub_call_nb(C_PING, svchp->server, errhp)) != OCI_STILL_EXECUTING)
+        svchp->round_trips++;
+    return status;
+}
+
+// Session pool
+
+// Open one pooled session; called without sp->lock held
+static PoolSession* pool_open(OCISPool* sp, OCIError* errhp)
+{
+    OCIEnv*      env = sp->hdr.env;
+    PoolSession* ps  = calloc(1, sizeof(*ps));
+    sword        status;
+
+    if (!ps)
+        return NULL;
+
+    OCIHandleAlloc(env, (void**)&ps->svc, OCI_HTYPE_SVCCTX, 0, NULL);
+    OCIHandleAlloc(env, (void**)&ps->srv, OCI_HTYPE_SERVER, 0, NULL);
+    OCIHandleAlloc(env, (void**)&ps->ses, OCI_HTYPE_SESSION, 0, NULL);
+
+    status = OCIServerAttach(ps->srv, errhp, (OraText*)sp->dblink, (sb4)strlen(sp->dblink), OCI_DEFAULT);
+    if (status == OCI_SUCCESS) {
+        ps->svc->server = ps->srv;
+        copy_text(ps->ses->username, sizeof(ps->ses->username), sp->username, 0);
+        copy_text(ps->ses->password, sizeof(ps->ses->password), sp->password, 0);
+        status = OCISessionBegin(ps->svc, errhp, ps->ses, OCI_CRED_RDBMS, OCI_DEFAULT);
+        if (status != OCI_SUCCESS)
+            OCIServerDetach(ps->srv, NULL, OCI_DEFAULT);
+    }
+    if (status != OCI_SUCCESS) {
+        OCIHandleFree(ps->ses, OCI_HTYPE_SESSION);
+        OCIHandleFree(ps->srv, OCI_HTYPE_SERVER);
+        OCIHandleFree(ps->svc, OCI_HTYPE_SVCCTX);
+        free(ps);
+        return NULL;
+    }
+
+    ps->svc->session = ps->ses;
+    ps->svc->pool    = sp;
+    ps->svc->pooled  = ps;
+    return ps;
+}
+
+static void pool_close(PoolSession* ps)
+{
+    OCISessionEnd(ps->svc, NULL, ps->ses, OCI_DEFAULT);
+    OCIServerDetach(ps->srv, NULL, OCI_DEFAULT);
+    OCIHandleFree(ps->ses, OCI_HTYPE_SESSION);
+    OCIHandleFree(ps->srv, OCI_HTYPE_SERVER);
+    OCIHandleFree(ps->svc, OCI_HTYPE_SVCCTX);
+    free(ps);
+}
+
+static void pool_destroy(OCISPool* sp)
+{
+    PoolSession* ps;
+    OCISPool**   pp;
+
+    pthread_mutex_lock(&pool_registry_lock);
+    for (pp = &pool_registry; *pp; pp = &(*pp)->next)
+        if (*pp == sp) {
+            *pp = sp->next;
+            break;
+        }
+    pthread_mutex_unlock(&pool_registry_lock);
+
+    pthread_mutex_lock(&sp->lock);
+    ps = sp->idle;
+    sp->idle = NULL;
+    pthread_mutex_unlock(&sp->lock);
+
+    while (ps) {
+        PoolSession* next = ps->next;
+        pool_close(ps);
+        ps = next;
+    }
+    sp->open = 0;
+}
+
+sword OCISessionPoolCreate(OCIEnv *envhp, OCIError *errhp, OCISPool *spoolhp,
+                           OraText **poolName, ub4 *poolNameLen,
+                           const OraText *connStr, ub4 connStrLen,
+                           ub4 sessMin, ub4 sessMax, ub4 sessIncr,
+                           OraText *userid, ub4 useridLen,
+                           OraText *password, ub4 passwordLen, ub4 mode)
+{
+    sword status;
+    (void)mode;
+
+    stub_ready();
+
+    if (!valid(envhp, OCI_HTYPE_ENV) || !valid(spoolhp, OCI_HTYPE_SPOOL))
+        return OCI_INVALID_HANDLE;
+    if (!userid || !useridLen) {
+        set_error(errhp, 24415, "Missing or null username.");
+        return OCI_ERROR;
+    }
+    if (sessMax == 0 || sessMin > sessMax) {
+        set_error(errhp, 24413, "Invalid number of sessions specified");
+        return OCI_ERROR;
+    }
+    if ((status = stub_call(C_POOL_CREATE, NULL, errhp)) != OCI_SUCCESS)
+        return status;
+
+    copy_text(spoolhp->dblink,   sizeof(spoolhp->dblink),   connStr,  connStrLen);
+    copy_text(spoolhp->username, sizeof(spoolhp->username), userid,   useridLen);
+    copy_text(spoolhp->password, sizeof(spoolhp->password), password, passwordLen);
+    spoolhp->min  = sessMin;
+    spoolhp->max  = sessMax;
+    spoolhp->incr = sessIncr ? sessIncr : 1;
+
+    pthread_mutex_lock(&pool_registry_lock);
+    snprintf(spoolhp->name, sizeof(spoolhp->name), "OCISTUB_SPOOL_%d", ++pool_serial);
+    spoolhp->next  = pool_registry;
+    pool_registry  = spoolhp;
+    pthread_mutex_unlock(&pool_registry_lock);
+
+    for (ub4 i = 0; i < sessMin; i++) {
+        PoolSession* ps = pool_open(spoolhp, errhp);
+        if (!ps)
+            return OCI_ERROR;
+        pthread_mutex_lock(&spoolhp->lock);
+        ps->next = spoolhp->idle;
+        spoolhp->idle = ps;
+        spoolhp->open++;
+        pthread_mutex_unlock(&spoolhp->lock);
+    }
+
+    if (poolName)    *poolName    = (OraText*)spoolhp->name;
+    if (poolNameLen) *poolNameLen = (ub4)strlen(spoolhp->name);
+    return OCI_SUCCESS;
+}
+
+sword OCISessionPoolDestroy(OCISPool *spoolhp, OCIError *errhp, ub4 mode)
+{
+    (void)errhp;
+    (void)mode;
+
+    if (!valid(spoolhp, OCI_HTYPE_SPOOL))
+        return OCI_INVALID_HANDLE;
+    pool_destroy(spoolhp);
+    return OCI_SUCCESS;
+}
+
+sword OCISessionGet(OCIEnv *envhp, OCIError *errhp, OCISvcCtx **svchp,
+                    OCIAuthInfo *authInfop, OraText *dbName, ub4 dbName_len,
+                    const OraText *tagInfo, ub4 tagInfo_len,
+                    OraText **retTagInfo, ub4 *retTagInfo_len,
+                    boolean *found, ub4 mode)
+{
+    OCISPool*    sp;
+    PoolSession* ps = NULL;
+    ub4          grow = 0;
+    sword        status;
+    (void)authInfop;
+    (void)tagInfo;
+    (void)tagInfo_len;
+
+    stub_ready();
+
+    if (!valid(envhp, OCI_HTYPE_ENV) || !svchp)
+        return OCI_INVALID_HANDLE;
+    if (!(mode & OCI_SESSGET_SPOOL)) {
+        set_error(errhp, 24301, "null host specified in thread-safe logon");
+        return OCI_ERROR;
+    }
+
+    pthread_mutex_lock(&pool_registry_lock);
+    for (sp = pool_registry; sp; sp = sp->next)
+        if (strlen(sp->name) == dbName_len && memcmp(sp->name, dbName, dbName_len) == 0)
+            break;
+    pthread_mutex_unlock(&pool_registry_lock);
+
+    if (!sp) {
+        set_error(errhp, 24418, "Cannot open further sessions.");
+        return OCI_ERROR;
+    }
+    if ((status = stub_call(C_SESSION_GET, NULL, errhp)) != OCI_SUCCESS)
+        return status;
+
+    pthread_mutex_lock(&sp->lock);
+    while (!sp->idle && sp->open >= sp->max) {
+        if (sp->getmode == OCI_SPOOL_ATTRVAL_NOWAIT) {
+            pthread_mutex_unlock(&sp->lock);
+            set_error(errhp, 24496, "OCISessionGet() timed out waiting for a free connection.");
+            return OCI_ERROR;
+        }
+        pthread_cond_wait(&sp->freed, &sp->lock);
+    }
+    if (sp->idle) {
+        ps = sp->idle;
+        sp->idle = ps->next;
+        sp->busy++;
+    } else {
+        // Reserve room for this session and up to incr-1 spares
+        grow = sp->incr;
+        if (sp->open + grow > sp->max)
+            grow = sp->max - sp->open;
+        sp->open += grow;
+        sp->busy++;
+    }
+    pthread_mutex_unlock(&sp->lock);
+
+    if (!ps) {
+        for (ub4 i = 0; i < grow; i++) {
+            PoolSession* np = pool_open(sp, errhp);
+            pthread_mutex_lock(&sp->lock);
+            if (!np) {
+                sp->open--;
+            } else if (!ps) {
+                ps = np;
+            } else {
+                np->next = sp->idle;
+                sp->idle = np;
+                pthread_cond_signal(&sp->freed);
+            }
+            pthread_mutex_unlock(&sp->lock);
+        }
+        if (!ps) {
+            pthread_mutex_lock(&sp->lock);
+            sp->busy--;
+            pthread_cond_signal(&sp->freed);
+            pthread_mutex_unlock(&sp->lock);
+            return OCI_ERROR;
+        }
+    }
+
+    if (found)          *found = 1;
+    if (retTagInfo)     *retTagInfo = NULL;
+    if (retTagInfo_len) *retTagInfo_len = 0;
+    *svchp = ps->svc;
+    return OCI_SUCCESS;
+}
+
+sword OCISessionRelease(OCISvcCtx *svchp, OCIError *errhp,
+                        OraText *tag, ub4 tag_len, ub4 mode)
+{
+    OCISPool*    sp;
+    PoolSession* ps;
+    sword        status;
+    (void)tag;
+    (void)tag_len;
+
+    stub_ready();
+
+    if (!valid(svchp, OCI_HTYPE_SVCCTX) || !svchp->pool)
+        return OCI_INVALID_HANDLE;
+
+    sp = svchp->pool;
+    ps = svchp->pooled;
+    status = stub_call(C_SESSION_RELEASE, NULL, errhp);
+
+    if (mode & OCI_SESSRLS_DROP) {
+        pool_close(ps);
+        pthread_mutex_lock(&sp->lock);
+        sp->open--;
+        sp->busy--;
+        pthread_cond_signal(&sp->freed);
+        pthread_mutex_unlock(&sp->lock);
+        return status;
+    }
+
+    pthread_mutex_lock(&sp->lock);
+    ps->next = sp->idle;
+    sp->idle = ps;
+    sp->busy--;
+    pthread_cond_signal(&sp->freed);
+    pthread_mutex_unlock(&sp->lock);
+    return status;
+}
+
+// Statements
+
+static const char* find_word(const char* s, const char* word)
+{
+    size_t n = strlen(word);
+    for (; *s; s++)
+        if (strncasecmp(s, word, n) == 0)
+            return s;
+    return NULL;
+}
+
+// Shape the fake result set from the statement text
+static void stmt_shape(OCIStmt* st)
+{
+    const char* s = st->sql;
+    const char* from;
+
+    while (isspace((unsigned char)*s) || *s == '(')
+        s++;
+
+    st->is_query  = strncasecmp(s, "SELECT", 6) == 0 || strncasecmp(s, "WITH", 4) == 0;
+    st->stmt_type = st->is_query ? OCI_STMT_SELECT : 0;
+    st->ncols     = 0;
+
+    if (!st->is_query)
+        return;
+
+    // Column count: top-level commas in the select list
+    st->ncols = 1;
+    from = find_word(s, " FROM ");
+    for (int depth = 0; *s && (!from || s < from); s++) {
+        if (*s == '(') depth++;
+        else if (*s == ')') depth--;
+        else if (*s == ',' && depth == 0) st->ncols++;
+    }
+    if (st->ncols > STUB_MAX_COLS)
+        st->ncols = STUB_MAX_COLS;
+}
+
+static long stmt_rows(const OCIStmt* st)
+{
+    const char* lim;
+
+    if (find_word(st->sql, "v$mystat"))
+        return 1;
+    if ((lim = find_word(st->sql, "LEVEL <=")) != NULL)
+        return atol(lim + 8);
+    if ((lim = find_word(st->sql, "ROWNUM <=")) != NULL)
+        return atol(lim + 9);
+    if (find_word(st->sql, "DUAL"))
+        return 1;
+    return stub_rows;
+}
+
+static void stmt_reset(OCIStmt* st)
+{
+    if (st->sql && !st->cached) {
+        free(st->sql);
+    }
+    st->sql = NULL;
+}
+
+static void stmt_cache_flush(OCISvcCtx* svc)
+{
+    for (ub4 i = 0; i < STUB_CACHE_MAX; i++) {
+        CacheEntry* e = &svc->cache[i];
+        if (e->stmt) {
+            OCIStmt* st = e->stmt;
+            st->cached = 0;
+            free(e->sql);
+            st->sql = NULL;
+            handle_destroy(&st->hdr);
+        }
+        memset(e, 0, sizeof(*e));
+    }
+}
+
+sword OCIStmtPrepare2(OCISvcCtx *svchp, OCIStmt **stmtp, OCIError *errhp,
+                      const OraText *stmt, ub4 stmt_len,
+                      const OraText *key, ub4 key_len,
+                      ub4 language, ub4 mode)
+{
+    OCIStmt* st;
+    sword    status;
+    (void)key;
+    (void)key_len;
+    (void)language;
+    (void)mode;
+
+    stub_ready();
+
+    if (!valid(svchp, OCI_HTYPE_SVCCTX) || !stmtp || !stmt)
+        return OCI_INVALID_HANDLE;
+
+    // Statement cache lookup
+    for (ub4 i = 0; i < svchp->cache_size; i++) {
+        CacheEntry* e = &svchp->cache[i];
+        if (e->stmt && strlen(e->sql) == stmt_len && memcmp(e->sql, stmt, stmt_len) == 0) {
+            e->used = ++svchp->cache_clock;
+            st = e->stmt;
+            st->rows_total = st->rows_sent = st->rows_taken = st->buffered = 0;
+            st->rows_fetched = st->row_count = 0;
+            st->prefetch_rows = 1;
+            st->prefetch_mem  = 0;
+            memset(st->defs, 0, sizeof(st->defs));
+            *stmtp = st;
+            clear_error(errhp);
+            return OCI_SUCCESS;
+        }
+    }
+
+    if ((status = stub_call(C_STMT_PREPARE, NULL, errhp)) != OCI_SUCCESS)
+        return status;
+    if ((status = OCIHandleAlloc(svchp->hdr.env, (void**)&st, OCI_HTYPE_STMT, 0, NULL)) != OCI_SUCCESS)
+        return status;
+
+    st->svc = svchp;
+    st->sql = strndup((const char*)stmt, stmt_len);
+    stmt_shape(st);
+    *stmtp = st;
+    return OCI_SUCCESS;
+}
+
+sword OCIStmtRelease(OCIStmt *stmtp, OCIError *errhp,
+                     const OraText *key, ub4 key_len, ub4 mode)
+{
+    OCISvcCtx*  svc;
+    CacheEntry* slot = NULL;
+    (void)key;
+    (void)key_len;
+    (void)errhp;
+
+    if (!valid(stmtp, OCI_HTYPE_STMT))
+        return OCI_INVALID_HANDLE;
+
+    svc = stmtp->svc;
+    if (stmtp->cached || !svc || svc->cache_size == 0 || (mode & OCI_STRLS_CACHE_DELETE))
+        return stmtp->cached ? OCI_SUCCESS : OCIHandleFree(stmtp, OCI_HTYPE_STMT);
+
+    // Keep it in the cache, evicting the least recently used entry
+    for (ub4 i = 0; i < svc->cache_size; i++) {
+        CacheEntry* e = &svc->cache[i];
+        if (!e->stmt) { slot = e; break; }
+        if (!slot || e->used < slot->used)
+            slot = e;
+    }
+    if (slot->stmt) {
+        OCIStmt* old = slot->stmt;
+        old->cached = 0;
+        free(slot->sql);
+        old->sql = NULL;
+        handle_destroy(&old->hdr);
+    }
+
+    // The cache owns the handle from here on, not the environment
+    child_unlink(stmtp->hdr.env, &stmtp->hdr);
+    slot->stmt = stmtp;
+    slot->sql  = stmtp->sql;
+    slot->used = ++svc->cache_clock;
+    stmtp->cached = 1;
+    return OCI_SUCCESS;
+}
+
+sword OCIDefineByPos(OCIStmt *stmtp, OCIDefine **defnpp, OCIError *errhp,
+                     ub4 position, void *valuep, sb4 value_sz, ub2 dty,
+                     void *indp, ub2 *rlenp, ub2 *rcodep, ub4 mode)
+{
+    StubDefine* d;
+    (void)mode;
+
+    if (!valid(stmtp, OCI_HTYPE_STMT))
+        return OCI_INVALID_HANDLE;
+    if (position < 1 || position > STUB_MAX_COLS) {
+        set_error(errhp, 1007, "variable not in select list");
+        return OCI_ERROR;
+    }
+
+    d = &stmtp->defs[position - 1];
+    d->pos      = position;
+    d->valuep   = valuep;
+    d->value_sz = value_sz;
+    d->dty      = dty;
+    d->indp     = indp;
+    d->rlenp    = rlenp;
+    d->rcodep   = rcodep;
+    d->cbf      = NULL;
+    d->cbctx    = NULL;
+    if (defnpp)
+        *defnpp = (OCIDefine*)d;
+    return OCI_SUCCESS;
+}
+
+sword OCIDefineDynamic(OCIDefine *defnp, OCIError *errhp, void *octxp,
+                       OCICallbackDefine ocbfp)
+{
+    StubDefine* d = (StubDefine*)defnp;
+
+    if (!d || !d->pos) {
+        set_error(errhp, 24343, "user defined callback error");
+        return OCI_INVALID_HANDLE;
+    }
+    d->cbf   = ocbfp;
+    d->cbctx = octxp;
+    return OCI_SUCCESS;
+}
+
+sword OCIBindByPos(OCIStmt *stmtp, OCIBind **bindpp, OCIError *errhp,
+                   ub4 position, void *valuep, sb4 value_sz, ub2 dty,
+                   void *indp, ub2 *alenp, ub2 *rcodep,
+                   ub4 maxarr_len, ub4 *curelep, ub4 mode)
+{
+    (void)errhp; (void)position; (void)valuep; (void)value_sz; (void)dty;
+    (void)indp; (void)alenp; (void)rcodep; (void)maxarr_len; (void)curelep; (void)mode;
+
+    if (!valid(stmtp, OCI_HTYPE_STMT))
+        return OCI_INVALID_HANDLE;
+    if (bindpp)
+        *bindpp = NULL;
+    return OCI_SUCCESS;
+}
+
+sword OCIParamGet(const void *hndlp, ub4 htype, OCIError *errhp,
+                  void **parmdpp, ub4 pos)
+{
+    const OCIStmt* st = hndlp;
+
+    if (htype != OCI_HTYPE_STMT || !valid(st, OCI_HTYPE_STMT) || !parmdpp)
+        return OCI_INVALID_HANDLE;
+    if (pos < 1 || (int)pos > st->ncols) {
+        set_error(errhp, 24334, "no descriptor for this position");
+        return OCI_ERROR;
+    }
+    *parmdpp = (void*)&st->defs[pos - 1];
+    return OCI_SUCCESS;
+}
+
+// Produce the value of column col (0 based) for row (0 based)
+static int row_value(const OCIStmt* st, int col, long row, char* buf, size_t bufsz)
+{
+    if (find_word(st->sql, "v$mystat"))
+        return snprintf(buf, bufsz, "%llu", (unsigned long long)st->svc->round_trips);
+    if (col == 0)
+        return snprintf(buf, bufsz, "%ld", row + 1);
+
+    int n = stub_width < (int)bufsz - 1 ? stub_width : (int)bufsz - 1;
+    memset(buf, 'A' + (col + row) % 26, n);
+    buf[n] = '\0';
+    return n;
+}
+
+// Hand one value to a dynamic define, a piece per callback until it is all
+// delivered; -1 if the callback did not return OCI_CONTINUE
+static int define_dynamic(StubDefine* d, ub4 slot, const char* val, int len)
+{
+    ub1 piece = OCI_FIRST_PIECE;
+    int off = 0;
+
+    do {
+        void* buf = NULL;
+        ub4*  alen = NULL;
+        void* ind = NULL;
+        ub2*  rcode = NULL;
+        ub4   n;
+
+        if (d->cbf(d->cbctx, (OCIDefine*)d, slot, &buf, &alen, &piece, &ind, &rcode) != OCI_CONTINUE)
+            return -1;
+        n = alen ? *alen : 0;
+        if (n > (ub4)(len - off))
+            n = len - off;
+        if (buf && n)
+            memcpy(buf, val + off, n);
+        if (alen)
+            *alen = n;
+        if (ind)
+            *(sb2*)ind = 0;
+        if (rcode)
+            *rcode = 0;
+        off += n;
+        piece = OCI_NEXT_PIECE;
+
+        // A callback that takes nothing would loop forever; the rest is dropped
+        if (n == 0)
+            break;
+    } while (off < len);
+    return 0;
+}
+
+static int define_store(StubDefine* d, ub4 slot, const char* val, int len)
+{
+    char* dst;
+
+    if (d->cbf)
+        return define_dynamic(d, slot, val, len);
+    if (!d->valuep)
+        return 0;
+    dst = (char*)d->valuep + (size_t)slot * d->value_sz;
+
+    switch (d->dty) {
+        case SQLT_INT:
+            if (d->value_sz == sizeof(long long))
+                *(long long*)dst = atoll(val);
+            else
+                *(int*)dst = atoi(val);
+            len = d->value_sz;
+            break;
+        case SQLT_STR:
+            if (len > d->value_sz - 1)
+                len = d->value_sz - 1;
+            memcpy(dst, val, len);
+            dst[len] = '\0';
+            break;
+        default:
+            if (len > d->value_sz)
+                len = d->value_sz;
+            memcpy(dst, val, len);
+            break;
+    }
+    if (d->indp)   d->indp[slot]   = 0;
+    if (d->rlenp)  d->rlenp[slot]  = (ub2)len;
+    if (d->rcodep) d->rcodep[slot] = 0;
+    return 0;
+}
+
+// Rows per server round trip given the prefetch settings
+static long stmt_batch(const OCIStmt* st, ub4 want)
+{
+    long batch = want;
+    long row_bytes = (long)st->ncols * (stub_width + 8);
+
+    if (st->prefetch_rows > batch)
+        batch = st->prefetch_rows;
+    if (st->prefetch_mem && row_bytes > 0 && st->prefetch_mem / row_bytes > batch)
+        batch = st->prefetch_mem / row_bytes;
+    return batch < 1 ? 1 : batch;
+}
+
+// Hand up to nrows rows to the caller's defines, fetching from the server as needed
+static ub4 stmt_deliver(OCIStmt* st, OCIError* errhp, ub4 nrows, sword* status)
+{
+    char buf[4096];
+    ub4  got = 0;
+
+    *status = OCI_SUCCESS;
+    while (got < nrows && st->rows_taken < st->rows_total) {
+        if (st->buffered == 0) {
+            long batch = stmt_batch(st, nrows - got);
+            if (batch > st->rows_total - st->rows_sent)
+                batch = st->rows_total - st->rows_sent;
+            if ((*status = stub_call(C_STMT_FETCH, NULL, errhp)) != OCI_SUCCESS)
+                return got;
+            st->svc->round_trips++;
+            st->rows_sent += batch;
+            st->buffered   = batch;
+        }
+        for (int c = 0; c < st->ncols; c++) {
+            int len = row_value(st, c, st->rows_taken, buf, sizeof(buf));
+            if (define_store(&st->defs[c], got, buf, len) != 0) {
+                set_error(errhp, 24343, "user defined callback error");
+                *status = OCI_ERROR;
+                return got;
+            }
+        }
+        st->rows_taken++;
+        st->buffered--;
+        got++;
+    }
+    return got;
+}
+
+sword OCIStmtExecute(OCISvcCtx *svchp, OCIStmt *stmtp, OCIError *errhp,
+                     ub4 iters, ub4 rowoff, const OCISnapshot *snap_in,
+                     OCISnapshot *snap_out, ub4 mode)
+{
+    sword status;
+    (void)rowoff;
+    (void)snap_in;
+    (void)snap_out;
+
+    stub_ready();
+
+    if (!valid(svchp, OCI_HTYPE_SVCCTX) || !valid(stmtp, OCI_HTYPE_STMT))
+        return OCI_INVALID_HANDLE;
+    if (!svc_connected(svchp, errhp))
+        return OCI_ERROR;
+
+    stmtp->svc = svchp;
+    if (mode & OCI_DESCRIBE_ONLY)
+        return stub_call(C_STMT_EXECUTE, NULL, errhp);
+
+    if (!stmtp->is_query && iters == 0) {
+        set_error(errhp, 24333, "zero iteration count");
+        return OCI_ERROR;
+    }
+
+    if ((status = stub_call(C_STMT_EXECUTE, NULL, errhp)) != OCI_SUCCESS)
+        return status;
+    svchp->round_trips++;
+
+    if (!stmtp->is_query) {
+        stmtp->row_count = iters;
+        return OCI_SUCCESS;
+    }
+
+    // The execute round trip carries the first prefetch batch
+    stmtp->rows_total = stmt_rows(stmtp);
+    stmtp->rows_taken = 0;
+    stmtp->rows_sent  = stmt_batch(stmtp, iters);
+    if (stmtp->rows_sent > stmtp->rows_total)
+        stmtp->rows_sent = stmtp->rows_total;
+    stmtp->buffered   = stmtp->rows_sent;
+    stmtp->row_count  = 0;
+
+    if (iters > 0) {
+        stmtp->rows_fetched = stmt_deliver(stmtp, errhp, iters, &status);
+        stmtp->row_count   += stmtp->rows_fetched;
+        if (status != OCI_SUCCESS)
+            return status;
+        if (stmtp->rows_fetched < iters)
+            return OCI_NO_DATA;
+    }
+    return OCI_SUCCESS;
+}
+
+sword OCIStmtFetch2(OCIStmt *stmtp, OCIError *errhp, ub4 nrows,
+                    ub2 orientation, sb4 scrollOffset, ub4 mode)
+{
+    sword status;
+    (void)orientation;
+    (void)scrollOffset;
+    (void)mode;
+
+    stub_ready();
+
+    if (!valid(stmtp, OCI_HTYPE_STMT))
+        return OCI_INVALID_HANDLE;
+    if (!stmtp->is_query) {
+        set_error(errhp, 24374, "define not done before fetch or execute and fetch");
+        return OCI_ERROR;
+    }
+
+    stmtp->rows_fetched = stmt_deliver(stmtp, errhp, nrows ? nrows : 1, &status);
+    stmtp->row_count   += stmtp->rows_fetched;
+    if (status != OCI_SUCCESS)
+        return status;
+    return stmtp->rows_fetched < (nrows ? nrows : 1) ? OCI_NO_DATA : OCI_SUCCESS;
+}
+
+// vim: expandtab number tabstop=4 shiftwidth=4
+// END
@@ -0,0 +1,224 @@
+// oci.h - minimal stand-in for the Oracle Call Interface header.
+//
+// Declares only the subset of OCI used by the programs in segv-c so they
+// can be built and benchmarked against libclntsh from oci-stub.c without
+// an Oracle client install.  Constant values match the real ocidfn.h/oci.h
+// so code compiled here behaves the same when rebuilt against the SDK.
+#ifndef OCI_STUB_H
+#define OCI_STUB_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned char   ub1;
+typedef signed char     sb1;
+typedef unsigned short  ub2;
+typedef signed short    sb2;
+typedef unsigned int    ub4;
+typedef signed int      sb4;
+typedef int             sword;
+typedef unsigned int    uword;
+typedef int             eword;
+typedef int             boolean;
+typedef unsigned char   OraText;
+typedef unsigned char   text;
+typedef void            dvoid;
+
+typedef struct OCIEnv       OCIEnv;
+typedef struct OCIError     OCIError;
+typedef struct OCISvcCtx    OCISvcCtx;
+typedef struct OCIStmt      OCIStmt;
+typedef struct OCIBind      OCIBind;
+typedef struct OCIDefine    OCIDefine;
+typedef struct OCIServer    OCIServer;
+typedef struct OCISession   OCISession;
+typedef struct OCISession   OCIAuthInfo;
+typedef struct OCISPool     OCISPool;
+typedef struct OCISnapshot  OCISnapshot;
+typedef struct OCIParam     OCIParam;
+
+// Return codes
+#define OCI_SUCCESS             0
+#define OCI_SUCCESS_WITH_INFO   1
+#define OCI_NO_DATA             100
+#define OCI_ERROR               -1
+#define OCI_INVALID_HANDLE      -2
+#define OCI_NEED_DATA           99
+#define OCI_STILL_EXECUTING     -3123
+#define OCI_CONTINUE            -24200
+
+// Modes
+#define OCI_DEFAULT             0x00000000
+#define OCI_THREADED            0x00000001
+#define OCI_OBJECT              0x00000002
+
+// Handle types
+#define OCI_HTYPE_ENV           1
+#define OCI_HTYPE_ERROR         2
+#define OCI_HTYPE_SVCCTX        3
+#define OCI_HTYPE_STMT          4
+#define OCI_HTYPE_BIND          5
+#define OCI_HTYPE_DEFINE        6
+#define OCI_HTYPE_SERVER        8
+#define OCI_HTYPE_SESSION       9
+#define OCI_HTYPE_AUTHINFO      OCI_HTYPE_SESSION
+#define OCI_HTYPE_SPOOL         27
+
+// Descriptor types
+#define OCI_DTYPE_PARAM         53
+
+// Attributes
+#define OCI_ATTR_NONBLOCKING_MODE   3
+#define OCI_ATTR_SERVER             6
+#define OCI_ATTR_SESSION            7
+#define OCI_ATTR_ROW_COUNT          9
+#define OCI_ATTR_PREFETCH_ROWS      11
+#define OCI_ATTR_PREFETCH_MEMORY    13
+#define OCI_ATTR_PARAM_COUNT        18
+#define OCI_ATTR_USERNAME           22
+#define OCI_ATTR_PASSWORD           23
+#define OCI_ATTR_STMT_TYPE          24
+#define OCI_ATTR_STMTCACHESIZE      176
+#define OCI_ATTR_ROWS_FETCHED       197
+#define OCI_ATTR_SPOOL_TIMEOUT      308
+#define OCI_ATTR_SPOOL_GETMODE      309
+#define OCI_ATTR_SPOOL_BUSY_COUNT   310
+#define OCI_ATTR_SPOOL_OPEN_COUNT   311
+
+// Credentials
+#define OCI_CRED_RDBMS          1
+#define OCI_CRED_EXT            2
+
+// Session pool
+#define OCI_SPC_REINITIALIZE    0x0001
+#define OCI_SPC_HOMOGENEOUS     0x0002
+#define OCI_SPC_STMTCACHE       0x0004
+#define OCI_SPD_FORCE           0x0001
+#define OCI_SESSGET_SPOOL       0x0001
+#define OCI_SESSGET_STMTCACHE   0x0004
+#define OCI_SESSRLS_DROP        0x0001
+#define OCI_SPOOL_ATTRVAL_WAIT      0
+#define OCI_SPOOL_ATTRVAL_NOWAIT    1
+#define OCI_SPOOL_ATTRVAL_FORCEGET  2
+
+// Statements
+#define OCI_NTV_SYNTAX          1
+#define OCI_STMT_SELECT         1
+#define OCI_FETCH_NEXT          0x00000002
+#define OCI_DESCRIBE_ONLY       0x00000010
+#define OCI_COMMIT_ON_SUCCESS   0x00000020
+#define OCI_STRLS_CACHE_DELETE  0x0010
+#define OCI_DYNAMIC_FETCH       0x00000002
+
+// Pieces
+#define OCI_ONE_PIECE           0
+#define OCI_FIRST_PIECE         1
+#define OCI_NEXT_PIECE          2
+#define OCI_LAST_PIECE          3
+
+// External datatypes
+#define SQLT_CHR                1
+#define SQLT_NUM                2
+#define SQLT_INT                3
+#define SQLT_STR                5
+#define SQLT_VCS                9
+#define SQLT_AFC                96
+
+sword OCIEnvCreate(OCIEnv **envp, ub4 mode, void *ctxp,
+                   void *(*malocfp)(void *ctxp, size_t size),
+                   void *(*ralocfp)(void *ctxp, void *memptr, size_t newsize),
+                   void  (*mfreefp)(void *ctxp, void *memptr),
+                   size_t xtramem_sz, void **usrmempp);
+
+sword OCIEnvNlsCreate(OCIEnv **envp, ub4 mode, void *ctxp,
+                      void *(*malocfp)(void *ctxp, size_t size),
+                      void *(*ralocfp)(void *ctxp, void *memptr, size_t newsize),
+                      void  (*mfreefp)(void *ctxp, void *memptr),
+                      size_t xtramem_sz, void **usrmempp,
+                      ub2 charset, ub2 ncharset);
+
+sword OCIHandleAlloc(const void *parenth, void **hndlpp, const ub4 type,
+                     const size_t xtramem_sz, void **usrmempp);
+sword OCIHandleFree(void *hndlp, const ub4 type);
+
+sword OCIDescriptorFree(void *descp, const ub4 type);
+
+sword OCIAttrSet(void *trgthndlp, ub4 trghndltyp, void *attributep,
+                 ub4 size, ub4 attrtype, OCIError *errhp);
+sword OCIAttrGet(const void *trgthndlp, ub4 trghndltyp, void *attributep,
+                 ub4 *sizep, ub4 attrtype, OCIError *errhp);
+
+sword OCIErrorGet(void *hndlp, ub4 recordno, OraText *sqlstate, sb4 *errcodep,
+                  OraText *bufp, ub4 bufsiz, ub4 type);
+
+sword OCIServerAttach(OCIServer *srvhp, OCIError *errhp,
+                      const OraText *dblink, sb4 dblink_len, ub4 mode);
+sword OCIServerDetach(OCIServer *srvhp, OCIError *errhp, ub4 mode);
+
+sword OCISessionBegin(OCISvcCtx *svchp, OCIError *errhp, OCISession *usrhp,
+                      ub4 credt, ub4 mode);
+sword OCISessionEnd(OCISvcCtx *svchp, OCIError *errhp, OCISession *usrhp,
+                    ub4 mode);
+
+sword OCIPing(OCISvcCtx *svchp, OCIError *errhp, ub4 mode);
+
+sword OCISessionPoolCreate(OCIEnv *envhp, OCIError *errhp, OCISPool *spoolhp,
+                           OraText **poolName, ub4 *poolNameLen,
+                           const OraText *connStr, ub4 connStrLen,
+                           ub4 sessMin, ub4 sessMax, ub4 sessIncr,
+                           OraText *userid, ub4 useridLen,
+                           OraText *password, ub4 passwordLen, ub4 mode);
+sword OCISessionPoolDestroy(OCISPool *spoolhp, OCIError *errhp, ub4 mode);
+
+sword OCISessionGet(OCIEnv *envhp, OCIError *errhp, OCISvcCtx **svchp,
+                    OCIAuthInfo *authInfop, OraText *dbName, ub4 dbName_len,
+                    const OraText *tagInfo, ub4 tagInfo_len,
+                    OraText **retTagInfo, ub4 *retTagInfo_len,
+                    boolean *found, ub4 mode);
+sword OCISessionRelease(OCISvcCtx *svchp, OCIError *errhp,
+                        OraText *tag, ub4 tag_len, ub4 mode);
+
+sword OCIStmtPrepare2(OCISvcCtx *svchp, OCIStmt **stmtp, OCIError *errhp,
+                      const OraText *stmt, ub4 stmt_len,
+                      const OraText *key, ub4 key_len,
+                      ub4 language, ub4 mode);
+sword OCIStmtRelease(OCIStmt *stmtp, OCIError *errhp,
+                     const OraText *key, ub4 key_len, ub4 mode);
+sword OCIStmtExecute(OCISvcCtx *svchp, OCIStmt *stmtp, OCIError *errhp,
+                     ub4 iters, ub4 rowoff, const OCISnapshot *snap_in,
+                     OCISnapshot *snap_out, ub4 mode);
+sword OCIStmtFetch2(OCIStmt *stmtp, OCIError *errhp, ub4 nrows,
+                    ub2 orientation, sb4 scrollOffset, ub4 mode);
+
+sword OCIParamGet(const void *hndlp, ub4 htype, OCIError *errhp,
+                  void **parmdpp, ub4 pos);
+
+sword OCIDefineByPos(OCIStmt *stmtp, OCIDefine **defnpp, OCIError *errhp,
+                     ub4 position, void *valuep, sb4 value_sz, ub2 dty,
+                     void *indp, ub2 *rlenp, ub2 *rcodep, ub4 mode);
+
+// Dynamic defines (OCI_DYNAMIC_FETCH): the callback supplies the buffer for
+// every value, and is called again with OCI_NEXT_PIECE while data is left
+typedef sb4 (*OCICallbackDefine)(void *octxp, OCIDefine *defnp, ub4 iter,
+                                 void **bufpp, ub4 **alenp, ub1 *piecep,
+                                 void **indp, ub2 **rcodep);
+
+sword OCIDefineDynamic(OCIDefine *defnp, OCIError *errhp, void *octxp,
+                       OCICallbackDefine ocbfp);
+
+sword OCIBindByPos(OCIStmt *stmtp, OCIBind **bindpp, OCIError *errhp,
+                   ub4 position, void *valuep, sb4 value_sz, ub2 dty,
+                   void *indp, ub2 *alenp, ub2 *rcodep,
+                   ub4 maxarr_len, ub4 *curelep, ub4 mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OCI_STUB_H
+
+// vim: expandtab number tabstop=4 shiftwidth=4
+// END
@@ -0,0 +1,300 @@
+#define _GNU_SOURCE             // signalfd, clock_nanosleep
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/signalfd.h>
+#include "sig-route.h"
+
+static const char* mode_names[SIG_MODE_COUNT] = { "async", "route" };
+
+// Blocked and routed in SIG_ROUTE mode, along with SIG_ROUTE_INJECT.  SIGCHLD,
+// SIGPIPE and SIGURG are left alone: the client library relies on them for
+// bequeath children, broken sockets and out-of-band breaks.
+static const int routed[] = { SIGHUP, SIGINT, SIGQUIT, SIGTERM, SIGUSR1, SIGUSR2, SIGALRM, SIGWINCH };
+
+struct SigRoute {
+    SigMode          mode;
+    double           rate;
+    pid_t            pid;
+    pthread_t        main;          // the thread that called start
+    pthread_t        handler;       // SIG_ROUTE
+    pthread_t        injector;
+    int              injecting;
+    int              sfd;
+    int              stop;          // handler: exit once drained
+    int              stop_inject;   // injector: send no more
+    sigset_t         set;           // what the signalfd reads
+    sigset_t         saved_mask;
+    struct sigaction saved_action;  // SIG_ASYNC
+    SigStats         stats;
+};
+
+// The SIG_ASYNC handler has no argument to find its SigRoute through
+static SigRoute* active;
+
+static uint64_t mono_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int lat_bucket(uint64_t ns)
+{
+    int b = ns ? 63 - __builtin_clzll(ns) : 0;
+
+    return b < SIG_LAT_BUCKETS ? b : SIG_LAT_BUCKETS - 1;
+}
+
+// Count one injected signal; safe in a signal handler and on several threads at once
+static void sig_note(SigRoute* r, uint64_t sent, uint64_t now)
+{
+    uint64_t lat = now > sent ? now - sent : 0;
+    uint64_t max = __atomic_load_n(&r->stats.lat_max, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&r->stats.handled, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&r->stats.lat_sum, lat, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&r->stats.lat[lat_bucket(lat)], 1, __ATOMIC_RELAXED);
+    while (lat > max && !__atomic_compare_exchange_n(&r->stats.lat_max, &max, lat, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+    if (r->mode == SIG_ASYNC && !pthread_equal(pthread_self(), r->main))
+        __atomic_fetch_add(&r->stats.elsewhere, 1, __ATOMIC_RELAXED);
+}
+
+static void async_handler(int sig, siginfo_t* si, void* uc)
+{
+    SigRoute* r = active;
+    int       saved = errno;
+
+    (void)sig;
+    (void)uc;
+    if (r && si->si_code == SI_QUEUE)
+        sig_note(r, (uint64_t)(uintptr_t)si->si_value.sival_ptr, mono_ns());
+    errno = saved;
+}
+
+// SIG_ROUTE: the only thread any asynchronous signal is delivered to
+static void* handler_thread(void* arg)
+{
+    SigRoute*               r = arg;
+    struct signalfd_siginfo si[64];
+    struct pollfd           pfd = { r->sfd, POLLIN, 0 };
+
+    for (;;) {
+        ssize_t n = read(r->sfd, si, sizeof(si));
+
+        if (n < 0) {
+            if (errno == EAGAIN) {
+                // Drained: a stop request is only honoured once nothing is pending
+                if (__atomic_load_n(&r->stop, __ATOMIC_ACQUIRE))
+                    break;
+                poll(&pfd, 1, -1);
+            }
+            continue;
+        }
+
+        uint64_t now = mono_ns();
+        for (size_t i = 0; i < n / sizeof(si[0]); i++) {
+            int sig = (int)si[i].ssi_signo;
+
+            if (sig == SIG_ROUTE_INJECT && si[i].ssi_code == SI_QUEUE) {
+                sig_note(r, si[i].ssi_ptr, now);
+            } else if (sig == SIGINT || sig == SIGTERM || sig == SIGQUIT || sig == SIGHUP) {
+                // Terminate the way the signal would have without us
+                sigset_t one;
+
+                signal(sig, SIG_DFL);
+                sigemptyset(&one);
+                sigaddset(&one, sig);
+                pthread_sigmask(SIG_UNBLOCK, &one, NULL);
+                raise(sig);
+            } else if (sig != SIG_ROUTE_INJECT) {
+                r->stats.other++;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void* injector_thread(void* arg)
+{
+    SigRoute*       r = arg;
+    uint64_t        period = (uint64_t)(1e9 / r->rate);
+    uint64_t        next = mono_ns();
+    struct timespec ts;
+    sigset_t        own;
+
+    // Never serve its own signals, so SIG_ASYNC shows where they really land
+    sigemptyset(&own);
+    sigaddset(&own, SIG_ROUTE_INJECT);
+    pthread_sigmask(SIG_BLOCK, &own, NULL);
+
+    while (!__atomic_load_n(&r->stop_inject, __ATOMIC_ACQUIRE)) {
+        uint64_t now = mono_ns();
+        union sigval v;
+
+        next += period;
+        if (next > now) {
+            ts.tv_sec = next / 1000000000ull;
+            ts.tv_nsec = next % 1000000000ull;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        } else if (now - next > 1000000000ull) {
+            next = now;             // more than a second behind: drop the backlog
+        }
+
+        v.sival_ptr = (void*)(uintptr_t)mono_ns();
+        if (sigqueue(r->pid, SIG_ROUTE_INJECT, v) == 0)
+            r->stats.sent++;
+        else
+            r->stats.refused++;
+    }
+    return NULL;
+}
+
+SigRoute* sig_route_start(SigMode mode, double rate)
+{
+    SigRoute* r = calloc(1, sizeof(*r));
+
+    if (!r)
+        return NULL;
+    r->mode = mode;
+    r->rate = rate;
+    r->pid = getpid();
+    r->main = pthread_self();
+    r->sfd = -1;
+
+    if (mode == SIG_ROUTE) {
+        sigemptyset(&r->set);
+        for (size_t i = 0; i < sizeof(routed) / sizeof(routed[0]); i++)
+            sigaddset(&r->set, routed[i]);
+        sigaddset(&r->set, SIG_ROUTE_INJECT);
+        if (pthread_sigmask(SIG_BLOCK, &r->set, &r->saved_mask) != 0)
+            goto fail;
+        if ((r->sfd = signalfd(-1, &r->set, SFD_NONBLOCK | SFD_CLOEXEC)) < 0 ||
+            pthread_create(&r->handler, NULL, handler_thread, r) != 0) {
+            if (r->sfd >= 0)
+                close(r->sfd);
+            pthread_sigmask(SIG_SETMASK, &r->saved_mask, NULL);
+            goto fail;
+        }
+    } else {
+        struct sigaction sa;
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = async_handler;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        active = r;
+        if (sigaction(SIG_ROUTE_INJECT, &sa, &r->saved_action) != 0) {
+            active = NULL;
+            goto fail;
+        }
+    }
+
+    if (rate > 0) {
+        if (pthread_create(&r->injector, NULL, injector_thread, r) != 0) {
+            sig_route_stop(r, NULL);
+            return NULL;
+        }
+        r->injecting = 1;
+    }
+    return r;
+
+fail:
+    free(r);
+    return NULL;
+}
+
+void sig_route_stop(SigRoute* r, SigStats* stats)
+{
+    if (!r)
+        return;
+
+    // The injector goes first: a signal it sends after the handler has left
+    // would be delivered with the default action once the mask is restored
+    __atomic_store_n(&r->stop_inject, 1, __ATOMIC_RELEASE);
+    if (r->injecting)
+        pthread_join(r->injector, NULL);
+
+    if (r->mode == SIG_ROUTE) {
+        sigset_t        one;
+        struct timespec zero = { 0, 0 };
+        siginfo_t       si;
+
+        // Wake the handler so it drains and sees the stop request
+        __atomic_store_n(&r->stop, 1, __ATOMIC_RELEASE);
+        pthread_kill(r->handler, SIG_ROUTE_INJECT);
+        pthread_join(r->handler, NULL);
+        close(r->sfd);
+
+        // Whatever the handler left pending is taken here, still blocked
+        sigemptyset(&one);
+        sigaddset(&one, SIG_ROUTE_INJECT);
+        while (sigtimedwait(&one, &si, &zero) > 0)
+            if (si.si_code == SI_QUEUE)
+                sig_note(r, (uint64_t)(uintptr_t)si.si_value.sival_ptr, mono_ns());
+        pthread_sigmask(SIG_SETMASK, &r->saved_mask, NULL);
+    } else {
+        // Let anything still queued reach the handler before it goes
+        sigset_t        one, old;
+        struct timespec zero = { 0, 0 };
+        siginfo_t       si;
+
+        sigemptyset(&one);
+        sigaddset(&one, SIG_ROUTE_INJECT);
+        pthread_sigmask(SIG_BLOCK, &one, &old);
+        while (sigtimedwait(&one, &si, &zero) > 0)
+            if (si.si_code == SI_QUEUE)
+                sig_note(r, (uint64_t)(uintptr_t)si.si_value.sival_ptr, mono_ns());
+        sigaction(SIG_ROUTE_INJECT, &r->saved_action, NULL);
+        active = NULL;
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+    }
+
+    if (stats)
+        *stats = r->stats;
+    free(r);
+}
+
+double sig_stats_percentile(const SigStats* s, double q)
+{
+    uint64_t want, seen = 0;
+
+    if (s->handled == 0)
+        return 0;
+    want = (uint64_t)(q * s->handled);
+    if (want >= s->handled)
+        want = s->handled - 1;
+    for (int b = 0; b < SIG_LAT_BUCKETS; b++) {
+        if (seen + s->lat[b] > want) {
+            double lo = b ? (double)(1ull << b) : 0;
+            double hi = (double)(2ull << b);
+            double v  = lo + (hi - lo) * (want - seen + 0.5) / s->lat[b];
+            return v < (double)s->lat_max ? v : (double)s->lat_max;
+        }
+        seen += s->lat[b];
+    }
+    return (double)s->lat_max;
+}
+
+int sig_mode_parse(const char* name)
+{
+    for (int m = 0; m < SIG_MODE_COUNT; m++)
+        if (strcmp(name, mode_names[m]) == 0)
+            return m;
+    return -1;
+}
+
+const char* sig_mode_name(SigMode mode)
+{
+    return mode < SIG_MODE_COUNT ? mode_names[mode] : "?";
+}
+
+// vim: expandtab number tabstop=4 shiftwidth=4
+// END
@@ -0,0 +1,65 @@
+// sig-route.h - keep asynchronous signals off the OCI worker threads
+//
+// The kernel hands a process-directed signal to any thread that does not
+// block it, so a handler may run on a thread the OCI client created and the
+// application knows nothing about (the second SEGV in the README).  In
+// SIG_ROUTE mode sig_route_start() blocks the asynchronous signals in the
+// calling thread before anything else is started - workers, the client's own
+// threads and the live reporter inherit the mask - and a single handler
+// thread reads them from a signalfd.  SIG_ASYNC is the default behaviour: a
+// plain handler on whichever thread the kernel picks.
+//
+// With a rate, an injector thread sigqueue()s SIG_ROUTE_INJECT on a fixed
+// schedule, each signal carrying its send time, so both modes report how
+// long a signal waited for its handler:
+//
+//     SigRoute* r = sig_route_start(SIG_ROUTE, 10000);   // before any other thread
+//     ... run ...
+//     sig_route_stop(r, &stats);                          // mask and handler restored
+#ifndef SIG_ROUTE_H
+#define SIG_ROUTE_H
+
+#include <stdint.h>
+#include <signal.h>
+
+#define SIG_ROUTE_INJECT    SIGRTMIN    // queued, so a busy handler delays signals instead of merging them
+#define SIG_LAT_BUCKETS     40          // powers of two nanoseconds, the last one open ended
+
+typedef enum {
+    SIG_ASYNC,          // handler on any thread that does not block the signal
+    SIG_ROUTE,          // blocked everywhere, read from a signalfd by one thread
+    SIG_MODE_COUNT
+} SigMode;
+
+typedef struct {
+    uint64_t sent;      // injected
+    uint64_t refused;   // sigqueue() EAGAIN: too many signals pending (RLIMIT_SIGPENDING)
+    uint64_t handled;   // injected signals that reached a handler
+    uint64_t other;     // SIG_ROUTE: other routed signals, e.g. SIGUSR1 from outside
+    uint64_t elsewhere; // SIG_ASYNC: handlers run on a thread other than the one that called start
+    uint64_t lat_sum;   // nanoseconds from sigqueue() to the handler
+    uint64_t lat_max;
+    uint64_t lat[SIG_LAT_BUCKETS]; // handled with a latency below 2^(b+1) ns
+} SigStats;
+
+typedef struct SigRoute SigRoute;
+
+// NULL with errno set on failure; rate 0 = no injector.  Call it from the
+// thread that will create all the others, before it creates any.
+SigRoute* sig_route_start(SigMode mode, double rate);
+
+// Stop injecting, drain what is pending and restore the signal mask and
+// handler of the calling thread.  stats may be NULL; r may be NULL.
+void sig_route_stop(SigRoute* r, SigStats* stats);
+
+// Latency below which a fraction q of the handled signals fell, ns; within a factor of two
+double sig_stats_percentile(const SigStats* s, double q);
+
+// Name <-> mode: async, route; -1 if unknown
+int         sig_mode_parse(const char* name);
+const char* sig_mode_name(SigMode mode);
+
+#endif // SIG_ROUTE_H
+
+// vim: expandtab number tabstop=4 shiftwidth=4
+// END
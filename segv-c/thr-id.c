@@ -1,31 +1,528 @@
+// thr-id - what a thread's lifecycle costs, without any OCI in the way
+//
+// Times pthread_create + pthread_join in batches (a batch of -b threads is
+// what one db-thread loop spawns and joins) over stack sizes, guard sizes
+// and CPU pinning, and the same batches handed to a pool of pre-spawned
+// workers instead.  Every setting runs -T timed trials after a warm-up; the
+// report gives the mean per-thread cost with a 95% confidence interval.
+//
+//     ./thr-id -b 8 -s 0,64,1024 -g 0,4 -a none,spread -o spawn.json
+//     ./thr-id -i          # the original: three threads print pthread_self()
+//
+// For the Perl side, DBQ_SPAWN=1000 perl ../segv-perl/t_A_segv.pl times
+// threads->create/join the same way.
+#define _GNU_SOURCE             // pthread_attr_setaffinity_np, sched_getcpu
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <sched.h>
+#include <unistd.h>
 #include <pthread.h>
 
+#define MAX_LIST    16
+#define ATTR_REJECTED (-2)      // a setting's stack or guard size was refused
+
+typedef enum {
+    AFF_NONE,           // wherever the scheduler puts it
+    AFF_SPREAD,         // thread i pinned to CPU i % ncpu
+    AFF_SAME,           // creator and every thread pinned to one CPU
+    AFF_COUNT
+} Affinity;
+
+static const char* affinity_names[AFF_COUNT] = { "none", "spread", "same" };
+
+// One thread or job: stamped by the creator and by the thread itself
+typedef struct {
+    uint64_t begin;     // before pthread_create / the job was queued
+    uint64_t created;   // pthread_create returned
+    uint64_t started;   // first instruction in the thread / the job picked up
+} Slot;
+
+// Pre-spawned workers fed a batch at a time, as db-thread -w does
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  ready;
+    pthread_cond_t  idle;
+    Slot*           jobs;
+    int             count;      // queued, not picked up yet
+    int             next;
+    int             pending;    // queued + running
+    int             shutdown;
+} Pool;
+
+// Per-trial figures of one setting, microseconds per thread
+typedef struct {
+    const char* mode;           // spawn or pool
+    int         stack_kib;      // 0 = default attributes
+    int         guard_kib;      // -1 = default attributes
+    Affinity    affinity;
+    int         batch;
+    int         trials;
+    int         per_trial;      // threads or jobs per trial
+    double      create_us;      // mean pthread_create call / batch submit per job
+    double      start_us;       // mean begin to started
+    double      mean_us;        // lifecycle per thread, mean over trials
+    double      sd_us;
+    double      ci95_us;        // half width
+    double      min_us;
+    double      max_us;
+} Result;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
 void* thread_function(void* arg) {
     pthread_t thread_id = pthread_self(); // Get the current thread's ID
     printf("Thread ID: %lu\n", (unsigned long)thread_id);
     return NULL;
 }
 
-int main() {
-    int num_threads = 3;
-    pthread_t threads[num_threads];
+static void* timed_function(void* arg)
+{
+    ((Slot*)arg)->started = now_ns();
+    return NULL;
+}
+
+// Two sided 95% Student t for df 1..30, then the normal value
+static double t95(int df)
+{
+    static const double t[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+    return df < 1 ? 0 : df <= 30 ? t[df - 1] : 1.960;
+}
+
+static void set_affinity(pthread_attr_t* attr, Affinity aff, int i, int cpu0, int ncpu)
+{
+    cpu_set_t set;
+
+    if (aff == AFF_NONE)
+        return;
+    CPU_ZERO(&set);
+    CPU_SET(aff == AFF_SAME ? cpu0 : (cpu0 + i) % ncpu, &set);
+    pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+}
+
+// Attributes for thread i of a setting; 0, or ATTR_REJECTED with attr already destroyed
+static int make_attr(pthread_attr_t* attr, const Result* r, int i, int cpu0, int ncpu)
+{
+    pthread_attr_init(attr);
+    if ((r->stack_kib > 0 && pthread_attr_setstacksize(attr, (size_t)r->stack_kib * 1024) != 0) ||
+        (r->guard_kib >= 0 && pthread_attr_setguardsize(attr, (size_t)r->guard_kib * 1024) != 0)) {
+        pthread_attr_destroy(attr);
+        return ATTR_REJECTED;
+    }
+    set_affinity(attr, r->affinity, i, cpu0, ncpu);
+    return 0;
+}
+
+static void* pool_worker(void* arg)
+{
+    Pool* p = arg;
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (p->count == 0 && !p->shutdown)
+            pthread_cond_wait(&p->ready, &p->lock);
+        if (p->count == 0)
+            break;
+        Slot* s = &p->jobs[p->next++];
+        p->count--;
+        pthread_mutex_unlock(&p->lock);
+
+        s->started = now_ns();
+
+        pthread_mutex_lock(&p->lock);
+        if (--p->pending == 0)
+            pthread_cond_signal(&p->idle);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+// One trial: per_trial threads in batches; fills the per-thread means, -1 or ATTR_REJECTED on failure
+static int trial_spawn(const Result* r, Slot* slots, int cpu0, int ncpu, double* create, double* start, double* life)
+{
+    pthread_t threads[r->batch];
+    uint64_t  total = 0, c = 0, s = 0;
+
+    for (int done = 0; done < r->per_trial; done += r->batch) {
+        pthread_attr_t attr[r->batch];
+        uint64_t       t0;
+
+        for (int i = 0; i < r->batch; i++)
+            if (make_attr(&attr[i], r, i, cpu0, ncpu) != 0) {
+                while (--i >= 0)
+                    pthread_attr_destroy(&attr[i]);
+                return ATTR_REJECTED;
+            }
+
+        t0 = now_ns();
+        for (int i = 0; i < r->batch; i++) {
+            slots[i].begin = now_ns();
+            if (pthread_create(&threads[i], &attr[i], timed_function, &slots[i]) != 0) {
+                perror("Failed to create thread");
+                for (int j = 0; j < i; j++)
+                    pthread_join(threads[j], NULL);
+                for (int j = 0; j < r->batch; j++)
+                    pthread_attr_destroy(&attr[j]);
+                return -1;
+            }
+            slots[i].created = now_ns();
+        }
+        for (int i = 0; i < r->batch; i++)
+            pthread_join(threads[i], NULL);
+        total += now_ns() - t0;
+
+        for (int i = 0; i < r->batch; i++) {
+            c += slots[i].created - slots[i].begin;
+            s += slots[i].started - slots[i].begin;
+            pthread_attr_destroy(&attr[i]);
+        }
+    }
+    *create = c / 1e3 / r->per_trial;
+    *start = s / 1e3 / r->per_trial;
+    *life = total / 1e3 / r->per_trial;
+    return 0;
+}
+
+static int trial_pool(const Result* r, Pool* p, Slot* slots, double* create, double* start, double* life)
+{
+    uint64_t total = 0, c = 0, s = 0;
+
+    for (int done = 0; done < r->per_trial; done += r->batch) {
+        uint64_t t0 = now_ns(), queued;
+
+        // Submit: queue the whole batch and wake the workers, charged to every job alike
+        pthread_mutex_lock(&p->lock);
+        for (int i = 0; i < r->batch; i++)
+            slots[i].begin = t0;
+        p->jobs = slots;
+        p->next = 0;
+        p->count = p->pending = r->batch;
+        pthread_cond_broadcast(&p->ready);
+        queued = now_ns();
+        c += queued - t0;
+        while (p->pending > 0)
+            pthread_cond_wait(&p->idle, &p->lock);
+        pthread_mutex_unlock(&p->lock);
+        total += now_ns() - t0;
+
+        for (int i = 0; i < r->batch; i++)
+            s += slots[i].started - slots[i].begin;
+    }
+    *create = c / 1e3 / r->per_trial;
+    *start = s / 1e3 / r->per_trial;
+    *life = total / 1e3 / r->per_trial;
+    return 0;
+}
+
+// Warm-up plus r->trials timed trials of one setting; 0, -1 (already reported) or ATTR_REJECTED
+static int run_setting(Result* r, int cpu0, int ncpu)
+{
+    Slot       slots[r->batch];
+    Pool       pool;
+    pthread_t  workers[r->batch];
+    int        started = 0;
+    double     life[r->trials];
+    double     create = 0, start = 0, sum = 0, sq = 0;
+    int        pooled = strcmp(r->mode, "pool") == 0;
+    int        rc = -1;
+    cpu_set_t  saved;
+
+    // Pin the creator too, so "same" really is one CPU
+    sched_getaffinity(0, sizeof(saved), &saved);
+    if (r->affinity == AFF_SAME) {
+        cpu_set_t one;
+        CPU_ZERO(&one);
+        CPU_SET(cpu0, &one);
+        sched_setaffinity(0, sizeof(one), &one);
+    }
+
+    if (pooled) {
+        memset(&pool, 0, sizeof(pool));
+        pthread_mutex_init(&pool.lock, NULL);
+        pthread_cond_init(&pool.ready, NULL);
+        pthread_cond_init(&pool.idle, NULL);
+        for (started = 0; started < r->batch; started++) {
+            pthread_attr_t attr;
+            int            ok;
+
+            if ((rc = make_attr(&attr, r, started, cpu0, ncpu)) != 0)
+                goto out;
+            ok = pthread_create(&workers[started], &attr, pool_worker, &pool) == 0;
+            pthread_attr_destroy(&attr);
+            if (!ok) {
+                perror("Failed to create thread");
+                rc = -1;
+                goto out;
+            }
+        }
+    }
+
+    for (int t = -1; t < r->trials; t++) {
+        double c, s, l;
+
+        if ((rc = pooled ? trial_pool(r, &pool, slots, &c, &s, &l) : trial_spawn(r, slots, cpu0, ncpu, &c, &s, &l)) != 0)
+            goto out;
+        if (t < 0)
+            continue;           // warm-up
+        life[t] = l;
+        create += c;
+        start += s;
+        sum += l;
+    }
+
+    r->create_us = create / r->trials;
+    r->start_us = start / r->trials;
+    r->mean_us = sum / r->trials;
+    r->min_us = r->max_us = life[0];
+    for (int t = 0; t < r->trials; t++) {
+        sq += (life[t] - r->mean_us) * (life[t] - r->mean_us);
+        if (life[t] < r->min_us)
+            r->min_us = life[t];
+        if (life[t] > r->max_us)
+            r->max_us = life[t];
+    }
+    r->sd_us = r->trials > 1 ? sqrt(sq / (r->trials - 1)) : 0;
+    r->ci95_us = r->trials > 1 ? t95(r->trials - 1) * r->sd_us / sqrt(r->trials) : 0;
+    rc = 0;
+
+out:
+    if (pooled) {
+        pthread_mutex_lock(&pool.lock);
+        pool.shutdown = 1;
+        pthread_cond_broadcast(&pool.ready);
+        pthread_mutex_unlock(&pool.lock);
+        for (int i = 0; i < started; i++)
+            pthread_join(workers[i], NULL);
+        pthread_mutex_destroy(&pool.lock);
+        pthread_cond_destroy(&pool.ready);
+        pthread_cond_destroy(&pool.idle);
+    }
+    sched_setaffinity(0, sizeof(saved), &saved);
+    return rc;
+}
+
+static void print_result(const Result* r, int header)
+{
+    char stack[16] = "default", guard[16] = "default";
+
+    if (r->stack_kib > 0)
+        snprintf(stack, sizeof(stack), "%d", r->stack_kib);
+    if (r->guard_kib >= 0)
+        snprintf(guard, sizeof(guard), "%d", r->guard_kib);
+    if (header)
+        printf("\n %-5s %9s %9s %-8s %6s %7s %10s %10s %12s %10s %10s %10s %11s\n", "MODE", "STACK KiB", "GUARD KiB",
+               "AFFINITY", "BATCH", "TRIALS", "CREATE us", "START us", "PER THREAD", "+/- 95%", "MIN", "MAX", "THREADS/S");
+    printf(" %-5s %9s %9s %-8s %6d %7d %10.2f %10.2f %12.2f %10.2f %10.2f %10.2f %11.0f\n", r->mode, stack, guard,
+           affinity_names[r->affinity], r->batch, r->trials, r->create_us, r->start_us, r->mean_us, r->ci95_us,
+           r->min_us, r->max_us, r->mean_us > 0 ? 1e6 / r->mean_us : 0.0);
+}
+
+// Results as JSON (*.json) or CSV; 0 or -1
+static int write_results(const char* path, const Result* res, int n)
+{
+    size_t len  = strlen(path);
+    int    json = len >= 5 && strcmp(path + len - 5, ".json") == 0;
+    FILE*  f;
+
+    if (!(f = fopen(path, "w"))) {
+        perror(path);
+        return -1;
+    }
+    if (json)
+        fprintf(f, "{\n  \"cpus\": %ld,\n  \"results\": [", sysconf(_SC_NPROCESSORS_ONLN));
+    else
+        fprintf(f, "mode,stack_kib,guard_kib,affinity,batch,trials,per_trial,create_us,start_us,"
+                   "per_thread_us,sd_us,ci95_us,min_us,max_us\n");
+    for (int i = 0; i < n; i++) {
+        const Result* r = &res[i];
+        if (json)
+            fprintf(f, "%s\n    { \"mode\": \"%s\", \"stack_kib\": %d, \"guard_kib\": %d, \"affinity\": \"%s\", \"batch\": %d,"
+                       " \"trials\": %d, \"per_trial\": %d, \"create_us\": %.3f, \"start_us\": %.3f, \"per_thread_us\": %.3f,"
+                       " \"sd_us\": %.3f, \"ci95_us\": %.3f, \"min_us\": %.3f, \"max_us\": %.3f }",
+                    i ? "," : "", r->mode, r->stack_kib, r->guard_kib, affinity_names[r->affinity], r->batch, r->trials,
+                    r->per_trial, r->create_us, r->start_us, r->mean_us, r->sd_us, r->ci95_us, r->min_us, r->max_us);
+        else
+            fprintf(f, "%s,%d,%d,%s,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", r->mode, r->stack_kib, r->guard_kib,
+                    affinity_names[r->affinity], r->batch, r->trials, r->per_trial, r->create_us, r->start_us,
+                    r->mean_us, r->sd_us, r->ci95_us, r->min_us, r->max_us);
+    }
+    if (json)
+        fprintf(f, "\n  ]\n}\n");
+    return fclose(f);
+}
+
+// Comma separated integers, -1 allowed; returns the count or -1
+static int parse_list(const char* arg, int* out)
+{
+    int   n = 0;
+    char* end;
+
+    while (*arg && n < MAX_LIST) {
+        long v = strtol(arg, &end, 10);
+        if (end == arg || v < -1 || v > 1 << 20)
+            return -1;
+        out[n++] = (int)v;
+        arg = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',')
+            return -1;
+    }
+    return *arg ? -1 : n;
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "Usage: %s [-n threads] [-T trials] [-b batch] [-s stacks] [-g guards] [-a affinities] [-P] [-o file] | -i\n", prog);
+    fprintf(stderr, "  -n threads   threads (or pool jobs) per trial, rounded up to whole batches (default 2000)\n");
+    fprintf(stderr, "  -T trials    timed trials per setting after one warm-up trial (default 10)\n");
+    fprintf(stderr, "  -b batch     threads created before joining them all, as db-thread -t does per loop (default 1)\n");
+    fprintf(stderr, "  -s KiB,...   stack sizes, 0 = default attributes (default 0,64,1024)\n");
+    fprintf(stderr, "  -g KiB,...   guard sizes, -1 = default attributes (default -1,0)\n");
+    fprintf(stderr, "  -a list      none, spread (thread i on CPU i) and/or same (everything on one CPU) (default none)\n");
+    fprintf(stderr, "  -P           skip the pre-spawned pool comparison\n");
+    fprintf(stderr, "  -o file      also write the results as JSON (*.json) or CSV\n");
+    fprintf(stderr, "  -i           just start three threads that print pthread_self(), as thr-id always did\n");
+}
+
+int main(int argc, char* argv[]) {
+    int         num_threads = 3;
+    int         per_trial = 2000, trials = 10, batch = 1, no_pool = 0;
+    int         stacks[MAX_LIST] = { 0, 64, 1024 }, num_stacks = 3;
+    int         guards[MAX_LIST] = { -1, 0 }, num_guards = 2;
+    Affinity    affs[AFF_COUNT] = { AFF_NONE };
+    int         num_affs = 1;
+    const char* report_path = NULL;
+    int         identify = 0;
+    int         opt, rc;
+
+    while ((opt = getopt(argc, argv, "n:T:b:s:g:a:Po:i")) != -1) {
+        switch (opt) {
+            case 'n': per_trial = atoi(optarg); break;
+            case 'T': trials = atoi(optarg); break;
+            case 'b': batch = atoi(optarg); break;
+            case 's':
+                if ((num_stacks = parse_list(optarg, stacks)) <= 0) {
+                    fprintf(stderr, "Invalid stack sizes: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'g':
+                if ((num_guards = parse_list(optarg, guards)) <= 0) {
+                    fprintf(stderr, "Invalid guard sizes: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'a': {
+                char* copy = strdup(optarg);
+                char* save = NULL;
+                num_affs = 0;
+                for (char* tok = strtok_r(copy, ",", &save); tok && num_affs < AFF_COUNT; tok = strtok_r(NULL, ",", &save)) {
+                    int a;
+                    for (a = 0; a < AFF_COUNT && strcmp(tok, affinity_names[a]) != 0; a++)
+                        ;
+                    if (a == AFF_COUNT) {
+                        fprintf(stderr, "Invalid affinity: %s\n", tok);
+                        free(copy);
+                        return EXIT_FAILURE;
+                    }
+                    affs[num_affs++] = a;
+                }
+                free(copy);
+                break;
+            }
+            case 'P': no_pool = 1; break;
+            case 'o': report_path = optarg; break;
+            case 'i': identify = 1; break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (identify) {
+        pthread_t threads[num_threads];
 
-    // Create threads
-    for (int i = 0; i < num_threads; i++) {
-        if (pthread_create(&threads[i], NULL, thread_function, NULL) != 0) {
-            perror("Failed to create thread");
+        // Create threads
+        for (int i = 0; i < num_threads; i++) {
+            if (pthread_create(&threads[i], NULL, thread_function, NULL) != 0) {
+                perror("Failed to create thread");
+                return EXIT_FAILURE;
+            }
+        }
+
+        // Wait for threads to complete
+        for (int i = 0; i < num_threads; i++) {
+            pthread_join(threads[i], NULL);
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    if (per_trial <= 0 || trials <= 0 || batch <= 0 || batch > 4096 || num_affs == 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    per_trial = (per_trial + batch - 1) / batch * batch;
+    for (int i = 0; i < num_stacks; i++)
+        if (stacks[i] < 0 || (stacks[i] > 0 && stacks[i] * 1024L < PTHREAD_STACK_MIN)) {
+            fprintf(stderr, "Invalid stack size: %d KiB (at least %ld KiB, or 0)\n", stacks[i], (long)PTHREAD_STACK_MIN / 1024);
             return EXIT_FAILURE;
         }
+
+    int     ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int     cpu0 = sched_getcpu() < 0 ? 0 : sched_getcpu();
+    int     max = num_stacks * num_guards * num_affs + num_affs;
+    Result* res = calloc(max, sizeof(Result));
+    int     n = 0;
+
+    if (!res) {
+        perror("Failed to allocate memory");
+        return EXIT_FAILURE;
     }
+    printf(" INFO: %d threads per trial in batches of %d, %d trials per setting, %d CPUs\n", per_trial, batch, trials, ncpu);
 
-    // Wait for threads to complete
-    for (int i = 0; i < num_threads; i++) {
-        pthread_join(threads[i], NULL);
+    for (int a = 0; a < num_affs; a++) {
+        for (int s = 0; s < num_stacks; s++)
+            for (int g = 0; g < num_guards; g++) {
+                Result* r = &res[n];
+                *r = (Result){ "spawn", stacks[s], guards[g], affs[a], batch, trials, per_trial };
+                if ((rc = run_setting(r, cpu0, ncpu)) != 0) {
+                    if (rc == ATTR_REJECTED)
+                        fprintf(stderr, "Error: stack %d KiB, guard %d KiB not accepted\n", stacks[s], guards[g]);
+                    free(res);
+                    return EXIT_FAILURE;
+                }
+                print_result(r, n++ == 0);
+            }
+        if (!no_pool) {
+            // The batch handed to batch pre-spawned workers instead
+            Result* r = &res[n];
+            *r = (Result){ "pool", stacks[0], guards[0], affs[a], batch, trials, per_trial };
+            if ((rc = run_setting(r, cpu0, ncpu)) != 0) {
+                if (rc == ATTR_REJECTED)
+                    fprintf(stderr, "Error: stack %d KiB, guard %d KiB not accepted\n", stacks[0], guards[0]);
+                free(res);
+                return EXIT_FAILURE;
+            }
+            print_result(r, n++ == 0);
+        }
     }
+    printf(" (microseconds per thread or job: CREATE is the pthread_create call, for pool the batch queued and\n"
+           "  broadcast divided by its size; START until the thread or job runs, PER THREAD the batch from first\n"
+           "  create to last join divided by its size; +/- is the 95%% CI over trials)\n");
 
-    return EXIT_SUCCESS;
+    rc = report_path && write_results(report_path, res, n) != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    free(res);
+    return rc;
 }
 
 // END
@@ -153,9 +153,10 @@ THREADS_SEGV:
       ok    $queue->isEnabled,          '  q->isEnabled';
       ok  ! $queue->ping,               '  q->ping';
 
-      while ( $queue->ping < $size ) { $queue->run; usleep 5000 }
+      ## Sleeps until ACKs arrive instead of polling; re-ping only if one went missing
+      while ( $queue->connected < $size ) { $queue->run( 5 ) or $queue->ping }
 
-      is    $queue->ping, $size,  '  ALL->connected';
+      is    $queue->connected, $size,  '  ALL->connected';
 
       if ( $do_onemore && ! $onemore )
       {
@@ -196,6 +197,188 @@ THREADS_SEGV:
   finish_onemore;
 }
 
+QUEUE_TIMING:
+{
+  ## DBQ_TIMING=1,2,4,8 [DBQ_ROUNDS=200] [DBQ_POLL=1 for the old sleep-polling dispatch]
+  last QUEUE_TIMING if ! $ENV{DBQ_TIMING};
+
+  section sprintf 'DB::Queue dispatch timing (%s)', $DB::Queue::POLL ? 'sleep polling' : 'blocking';
+
+  my $rounds = $ENV{DBQ_ROUNDS} || 200;
+
+  note sprintf '%7s %7s %9s %9s %9s %9s %9s %10s %10s',
+    'WORKERS', 'ROUNDS', 'MSGS', 'p50 ms', 'p90 ms', 'p99 ms', 'max ms', 'MSGS/S', 'BURST/S';
+
+  for my $workers ( split /,/, $ENV{DBQ_TIMING} )
+  {
+    my $queue = DB::Queue->new;
+
+    ok    $queue->enable($workers),   "  q->enable($workers)";
+    $queue->ping;
+    $queue->run( 5 ) while $queue->pending;
+    is    $queue->connected, $workers,  "  $workers workers: connected";
+
+    ## Lock step: one ping per worker, wait for every ACK, repeat
+    $queue->timing(1);
+    my $t0 = Time::HiRes::time();
+    for ( 1 .. $rounds )
+    {
+      $queue->ping;
+      $queue->run( 5 ) while $queue->pending;
+    }
+    my $lockstep = Time::HiRes::time() - $t0;
+    my @lat = sort { $a <=> $b } @{ $queue->timing(0) };
+
+    ## Burst: every round queued at once, drained as fast as the workers go
+    $t0 = Time::HiRes::time();
+    $queue->ping for 1 .. $rounds;
+    $queue->run( 5 ) while $queue->pending;
+    my $burst = Time::HiRes::time() - $t0;
+
+    my $pct = sub { @lat ? $lat[ int( $_[0] * $#lat + 0.5 ) ] * 1e3 : 0 };
+    note sprintf '%7d %7d %9d %9.3f %9.3f %9.3f %9.3f %10.1f %10.1f',
+      $workers, $rounds, scalar @lat, $pct->(0.50), $pct->(0.90), $pct->(0.99), $pct->(1),
+      @lat / $lockstep, $rounds * $workers / $burst;
+
+    is    scalar @lat, $rounds * $workers,  "  $workers workers: every ping ACKed";
+    ok    $queue->disable,              '  q->disable';
+  }
+}
+
+QUEUE_SHARED:
+{
+  ## DBQ_SHARED=2,4,8 [DBQ_JOBS=400] [DBQ_SKEW=0.1 share of 20ms jobs among 1ms ones]
+  last QUEUE_SHARED if ! $ENV{DBQ_SHARED};
+
+  section 'DB::Queue per-worker vs shared input queue (skewed jobs)';
+
+  my $jobs = $ENV{DBQ_JOBS} || 400;
+  my $skew = $ENV{DBQ_SKEW} // 0.1;
+
+  ## Same job list for every run
+  srand 16;
+  my @hold = map { rand() < $skew ? 0.020 : 0.001 } 1 .. $jobs;
+
+  note sprintf '%7s %-7s %7s %9s %9s %9s %9s %7s %7s',
+    'WORKERS', 'QUEUE', 'JOBS', 'JOBS/S', 'p50 ms', 'p99 ms', 'max ms', 'MIN/W', 'MAX/W';
+
+  for my $workers ( split /,/, $ENV{DBQ_SHARED} )
+  {
+    for my $shared ( 0, 1 )
+    {
+      my $queue = DB::Queue->new;
+      my $mode  = $shared ? 'shared' : 'private';
+
+      ok    $queue->enable( $workers, $shared ),  "  q->enable($workers, $mode)";
+      $queue->ping;
+      $queue->run( 5 ) while $queue->pending;
+
+      $queue->timing(1);
+      my $t0 = Time::HiRes::time();
+      $queue->submit( DB::Msg::Job->new( $_ )) for @hold;
+      $queue->run( 5 ) while $queue->pending;
+      my $took = Time::HiRes::time() - $t0;
+      my @lat = sort { $a <=> $b } @{ $queue->timing(0) };
+      my @per = sort { $a <=> $b } map { $queue->done->{$_} || 0 } $queue->tids;
+
+      my $pct = sub { @lat ? $lat[ int( $_[0] * $#lat + 0.5 ) ] * 1e3 : 0 };
+      note sprintf '%7d %-7s %7d %9.1f %9.3f %9.3f %9.3f %7d %7d',
+        $workers, $mode, scalar @lat, @lat / $took, $pct->(0.50), $pct->(0.99), $pct->(1),
+        $per[0], $per[-1];
+
+      is    scalar @lat, $jobs,         "  $workers $mode: every job done";
+
+      ## Session-bound work stays on the worker it was addressed to
+      my $tid    = ( $queue->tids )[-1];
+      my $before = $queue->done->{$tid} || 0;
+      $queue->submit( DB::Msg::Job->new, $tid ) for 1 .. 20;
+      $queue->run( 5 ) while $queue->pending;
+      is    $queue->done->{$tid} - $before, 20,   "  $workers $mode: affinity to tid $tid";
+      ok  ! $queue->submit( DB::Msg::Job->new, -1 ),  "  $workers $mode: no job for an unknown tid";
+
+      ok    $queue->disable,            '  q->disable';
+    }
+  }
+}
+
+THREAD_SPAWN:
+{
+  ## DBQ_SPAWN=1000 [DBQ_TRIALS=10] [DBQ_BATCH=1]: the Perl counterpart of segv-c/thr-id
+  last THREAD_SPAWN if ! $ENV{DBQ_SPAWN};
+
+  section 'threads->create/join vs a pre-spawned DB::Queue pool';
+
+  my $batch  = $ENV{DBQ_BATCH}  || 1;
+  my $trials = $ENV{DBQ_TRIALS} || 10;
+  my $count  = int(( $ENV{DBQ_SPAWN} + $batch - 1 ) / $batch ) * $batch;
+
+  ## Two sided 95% Student t for df 1..30, then the normal value
+  my @t95 = qw| 12.706 4.303 3.182 2.776 2.571 2.447 2.365 2.306 2.262 2.228
+                2.201 2.179 2.160 2.145 2.131 2.120 2.110 2.101 2.093 2.086
+                2.080 2.074 2.069 2.064 2.060 2.056 2.052 2.048 2.045 2.042 |;
+
+  ## Warm-up plus $trials timed runs of $trial->(), microseconds per thread or job
+  my $measure = sub
+  {
+    my $trial = shift;
+    my @us;
+
+    for my $t ( 0 .. $trials )
+    {
+      my $t0 = Time::HiRes::time();
+      $trial->();
+      push @us, ( Time::HiRes::time() - $t0 ) * 1e6 / $count if $t;
+    }
+
+    my $mean = 0;
+    $mean += $_ / @us for @us;
+    my $sd   = 0;
+    $sd += ( $_ - $mean ) ** 2 for @us;
+    $sd = @us > 1 ? sqrt( $sd / ( @us - 1 )) : 0;
+    my $ci = @us > 1 ? ( $t95[ $#us - 1 ] // 1.960 ) * $sd / sqrt( @us ) : 0;
+    my @sorted = sort { $a <=> $b } @us;
+
+    return ( $mean, $ci, $sorted[0], $sorted[-1] );
+  };
+
+  note sprintf '%-7s %6s %7s %7s %12s %10s %10s %10s %11s',
+    'MODE', 'BATCH', 'TRIALS', 'THREADS', 'PER THREAD', '+/- 95%', 'MIN', 'MAX', 'THREADS/S';
+
+  my @spawn = $measure->( sub
+  {
+    for ( 1 .. $count / $batch )
+    {
+      $_->join for map { threads->create( sub { return } ) } 1 .. $batch;
+    }
+  });
+
+  note sprintf '%-7s %6d %7d %7d %12.2f %10.2f %10.2f %10.2f %11.0f',
+    'create', $batch, $trials, $count, @spawn, 1e6 / $spawn[0];
+
+  my $queue = DB::Queue->new;
+  ok    $queue->enable( $batch, 1 ),  "  q->enable($batch, shared)";
+  $queue->ping;
+  $queue->run( 5 ) while $queue->pending;
+  my $seen = $queue->received;
+
+  my @pool = $measure->( sub
+  {
+    for ( 1 .. $count / $batch )
+    {
+      $queue->submit( DB::Msg::Job->new ) for 1 .. $batch;
+      $queue->run( 5 ) while $queue->pending;
+    }
+  });
+
+  note sprintf '%-7s %6d %7d %7d %12.2f %10.2f %10.2f %10.2f %11.0f',
+    'pool', $batch, $trials, $count, @pool, 1e6 / $pool[0];
+  note sprintf '  threads->create/join costs %.1fx a pool hand-off; compare ./thr-id -b %d for the C lifecycle',
+    $spawn[0] / $pool[0], $batch;
+
+  is    $queue->received - $seen, $count * ( $trials + 1 ),  "  every pool job done";
+  ok    $queue->disable,              '  q->disable';
+}
+
 note sprintf 'Completed in %5.3fs', Time::HiRes::time() - $TEST_START;
 done_testing();
 
@@ -241,7 +424,7 @@ package DB::Queue;
 use strict;
 use warnings;
 use threads::shared 1.51;
-use Thread::Queue;
+use Thread::Queue 3.01;     ## dequeue_timed
 use Time::HiRes qw| usleep |;
 use DBI;
 use Test::More;
@@ -254,12 +437,23 @@ our $QUEUE_IN;
 our $QUEUE_OU;
 our $STATUS;
 our $THREADS;
+our $POLL;      ## DBQ_POLL=1: the old dequeue_nb + usleep dispatch, for comparison
+our $WAIT;      ## seconds a worker blocks in dequeue_timed before checking its queue is still open
+our $SEEN;      ## replies drained by run()
+our $ASKED;     ## pings and jobs dispatched, each answered by one reply
+our $SHARED;    ## enable( N, 1 ): the DB::Queue::Shared all workers take from
 
 our $ONETHR :shared;
+our $SIGNAL :shared;  ## replies enqueued by all workers; cond_signal'd for each one
 
 BEGIN {
   $VERSION  = 0.1;
   $ONETHR   = 1;
+  $SIGNAL   = 0;
+  $SEEN     = 0;
+  $ASKED    = 0;
+  $POLL     = $ENV{DBQ_POLL} ? 1 : 0;
+  $WAIT     = 1;
   $ENABLED  = 0;
   $QUEUE_IN = [];
   $QUEUE_OU = [];
@@ -275,6 +469,7 @@ sub CLONE {
   $THREADS  = [];
   $QUEUE_IN = [];
   $QUEUE_OU = [];
+  $SHARED   = undef;
 }
 
 DESTROY { __PACKAGE__->disable; }
@@ -308,11 +503,10 @@ sub disable
       my $thr     = shift @ $THREADS;
       my $status  = delete $STATUS->{ $thr->tid };
 
-      $qI && $qI->enqueue( DB::Msg::Exit->new );
+      $qI && $qI->enqueue( DB::Msg::Exit->new->to( $thr->tid ));
 
       if ( $thr )
       {
-        while ( ! $thr->is_joinable ) { usleep( 20000 ); }
         note 'join ', $thr->tid;
         $thr->join;
       }
@@ -320,22 +514,35 @@ sub disable
       threads->yield;
     }
 
+    ## Replies left in the dropped queues will never be drained
+    {
+      lock $SIGNAL;
+      $SEEN = $SIGNAL;
+    }
+    $ASKED  = $SEEN;
+    $SHARED = undef;
+
     $ENABLED = 0;
   }
 
   return $self->isDisabled;
 }
 
+## enable( N ): a private input queue per worker
+## enable( N, 1 ): one shared input queue the N workers compete on
 sub enable
 {
   my $self = shift;
   my $threads = shift;
+  my $shared  = shift;
 
   if ( $threads && $self->isDisabled )
   {
+    $SHARED = DB::Queue::Shared->new if $shared;
+
     for my $cnt ( 1 .. $threads )
     {
-      my ( $Qin, $Qou ) = ( Thread::Queue->new, Thread::Queue->new );
+      my ( $Qin, $Qou ) = ( $SHARED || Thread::Queue->new, Thread::Queue->new );
       push @ $QUEUE_IN, $Qin;
       push @ $QUEUE_OU, $Qou;
 
@@ -353,30 +560,115 @@ sub enable
 sub ping
 {
   my $self = shift;
-  my $conn = 0;
 
-  for my $queue ( @ $QUEUE_IN )
+  for my $i ( 0 .. $#{ $QUEUE_IN } )
+  {
+    $QUEUE_IN->[$i]->enqueue( DB::Msg::Ping->new->to( $THREADS->[$i]->tid ));
+    $ASKED++;
+  }
+
+  return $self->connected;
+}
+
+## Queue a job for whichever worker is idle first, or for worker $tid only
+## (session-bound work).  With per-worker queues the untargeted jobs are
+## dealt out round robin instead.
+sub submit
+{
+  my $self = shift;
+  my $job  = shift;
+  my $tid  = shift;
+
+  return 0 if ! @ $THREADS;
+
+  ## Nobody would ever take a job for a tid that is not a worker
+  my ( $i ) = defined $tid
+    ? grep { $THREADS->[$_]->tid == $tid } 0 .. $#{ $THREADS }
+    : ( $self->{NEXT}++ % @ $THREADS );
+
+  return 0 if ! defined $i;
+
+  $job->to( $tid ) if defined $tid;
+
+  if ( $SHARED )
   {
-    $queue->enqueue( DB::Msg::Ping->new );
+    $SHARED->enqueue( $job );
   }
+  else
+  {
+    $QUEUE_IN->[$i]->enqueue( $job );
+  }
+
+  $ASKED++;
+
+  return 1;
+}
+
+## Worker thread ids, in enable() order
+sub tids { return map { $_->tid } @ $THREADS }
+
+## Jobs completed per worker tid
+sub done { return $_[0]->{DONE} ||= {} }
+
+## Workers whose last ACK said connected
+sub connected
+{
+  my $conn = 0;
 
   for my $state ( values % $STATUS ) { $state && $conn++ }
 
   return $conn;
 }
 
-sub run
+## Replies drained by run() so far
+sub received { return $SEEN }
+
+## Pings and jobs not answered yet
+sub pending { return $ASKED - $SEEN }
+
+## timing(1) starts collecting dispatch-to-reply seconds, timing(0) returns them
+sub timing
 {
   my $self = shift;
+
+  return $self->{LATENCY} = [] if shift;
+  return delete( $self->{LATENCY} ) || [];
+}
+
+## Drain the reply queues; with a timeout, first sleep on the completion signal
+## until a worker has answered something not drained yet.  Returns the count.
+sub run
+{
+  my $self    = shift;
+  my $timeout = shift;
+  my $count   = 0;
   my $msg;
 
+  if ( $timeout && ! $POLL )
+  {
+    my $until = Time::HiRes::time() + $timeout;
+
+    lock $SIGNAL;
+    while ( $SIGNAL <= $SEEN ) { cond_timedwait( $SIGNAL, $until ) or last }
+  }
+
   for my $queue ( @ $QUEUE_OU )
   {
     while ( $msg = $queue->dequeue_nb )
     {
+      $count++;
+
       if ( $msg->isState )
       {
         $STATUS->{ $msg->tid } = $msg->isConnected;
+        $self->{LATENCY} && push @{ $self->{LATENCY} }, Time::HiRes::time() - $msg->sent;
+        next;
+      }
+
+      if ( $msg->isDone )
+      {
+        $self->done->{ $msg->tid }++;
+        $self->{LATENCY} && push @{ $self->{LATENCY} }, Time::HiRes::time() - $msg->sent;
         next;
       }
 
@@ -384,7 +676,12 @@ sub run
     }
   }
 
-  return;
+  ## The old main loop: spin on the queues
+  usleep 5000 if $timeout && $POLL && ! $count;
+
+  $SEEN += $count;
+
+  return $count;
 }
 
 QUEUE_BACKEND:
@@ -406,32 +703,43 @@ QUEUE_BACKEND:
     BUSY:
     while (1)
     {
-      my $msg;
+      my $msg = $POLL ? $queue_in->dequeue_nb : $queue_in->dequeue_timed( $WAIT );
 
-      while ( defined( $msg = $queue_in->dequeue_nb ))
+      if ( ! defined $msg )
       {
-        ## CASE - PING
-        if ( $msg->isPing )
-        {
-        # printf "# tid-%s PING\n", $tid;
-          _connect();
-        # $queue_ou->enqueue( DB::Msg::Ping::ACK->new( $dbh && $dbh->ping ));
-          $queue_ou->enqueue( DB::Msg::Ping::ACK->new( $dbh ? 1 : 0 ));
-          next;
-        }
-
-        ## CASE - EXIT
-        if ( $msg->isExit )
-        {
-          _disconnect();
-        # $queue_ou->enqueue( DB::Msg::Ping::ACK->new( 0 ));
-          last BUSY;
-        }
-
-        printf STDERR "# Unexpected %s\n", ref $msg;
+        usleep 50000 if $POLL;
+        next;
       }
 
-      usleep 50000;
+      ## CASE - PING
+      if ( $msg->isPing )
+      {
+      # printf "# tid-%s PING\n", $tid;
+        _connect();
+      # _reply( DB::Msg::Ping::ACK->new( $dbh && $dbh->ping, $msg ));
+        _reply( DB::Msg::Ping::ACK->new( $dbh ? 1 : 0, $msg ));
+        next;
+      }
+
+      ## CASE - JOB
+      if ( $msg->isJob )
+      {
+        _connect();
+        my $ok = $dbh && ( ! $msg->sql || $dbh->do( $msg->sql )) ? 1 : 0;
+        usleep( $msg->hold * 1e6 ) if $msg->hold;
+        _reply( DB::Msg::Job::Done->new( $ok, $msg ));
+        next;
+      }
+
+      ## CASE - EXIT
+      if ( $msg->isExit )
+      {
+        _disconnect();
+      # _reply( DB::Msg::Ping::ACK->new( 0, $msg ));
+        last BUSY;
+      }
+
+      printf STDERR "# Unexpected %s\n", ref $msg;
     }
 
   # printf "# tid-%s EXIT\n", $tid;
@@ -439,6 +747,18 @@ QUEUE_BACKEND:
     return 1;
   }
 
+  ## Hand the reply back and wake run() if it is waiting on the signal
+  sub _reply
+  {
+    $queue_ou->enqueue( shift );
+
+    lock $SIGNAL;
+    $SIGNAL++;
+    cond_signal $SIGNAL;
+
+    return;
+  }
+
   sub _connect
   {
     if ( ! $dbh )
@@ -481,10 +801,16 @@ package DB::Msg;
 use strict;
 use warnings;
 
-sub new { return bless {}, shift }
+## SENT: when the message was dispatched, carried over to its reply
+## TO:   the worker tid a message on a shared queue is meant for
+sub new { return bless { SENT => Time::HiRes::time() }, shift }
 sub isExit  { return 0 }
 sub isPing  { return 0 }
 sub isState { return 0 }
+sub isJob   { return 0 }
+sub isDone  { return 0 }
+sub sent    { return $_[0]->{SENT} }
+sub to      { $_[0]->{TO} = $_[1]; return $_[0] }
 
 package DB::Msg::Exit;
 
@@ -498,6 +824,8 @@ sub new { return (shift)->SUPER::new }
 sub isExit  { return 1 }
 sub isPing  { return 0 }
 sub isState { return 0 }
+sub isJob   { return 0 }
+sub isDone  { return 0 }
 
 
 package DB::Msg::Ping;
@@ -512,6 +840,8 @@ sub new { return (shift)->SUPER::new }
 sub isExit  { return 0 }
 sub isPing  { return 1 }
 sub isState { return 0 }
+sub isJob   { return 0 }
+sub isDone  { return 0 }
 
 package DB::Msg::Ping::ACK;
 
@@ -526,15 +856,158 @@ sub new
   my $self = (shift)->SUPER::new;
   $self->{TID} = threads->tid;
   $self->{CONNECTED} = shift;
+  my $msg = shift;
+  $self->{SENT} = $msg->sent if $msg;
   return $self;
 }
 
 sub isExit  { return 0 }
 sub isPing  { return 0 }
 sub isState { return 1 }
+sub isJob   { return 0 }
+sub isDone  { return 0 }
 
 sub tid         { return $_[0]->{TID} }
 sub isConnected { return $_[0]->{CONNECTED} }
 
+package DB::Msg::Job;
+
+use strict;
+use warnings;
+
+our @ISA;
+BEGIN { push @ISA, 'DB::Msg' }
+
+## HOLD: seconds to keep the session busy after SQL (stands in for query time)
+sub new
+{
+  my $self = (shift)->SUPER::new;
+  $self->{HOLD} = shift || 0;
+  $self->{SQL}  = shift;
+  return $self;
+}
+
+sub isExit  { return 0 }
+sub isPing  { return 0 }
+sub isState { return 0 }
+sub isJob   { return 1 }
+sub isDone  { return 0 }
+
+sub hold { return $_[0]->{HOLD} }
+sub sql  { return $_[0]->{SQL} }
+
+package DB::Msg::Job::Done;
+
+use strict;
+use warnings;
+
+our @ISA;
+BEGIN { push @ISA, 'DB::Msg' }
+
+sub new
+{
+  my $self = (shift)->SUPER::new;
+  $self->{TID} = threads->tid;
+  $self->{OK}  = shift;
+  my $job = shift;
+  $self->{SENT} = $job->sent if $job;
+  return $self;
+}
+
+sub isExit  { return 0 }
+sub isPing  { return 0 }
+sub isState { return 0 }
+sub isJob   { return 0 }
+sub isDone  { return 1 }
+
+sub tid  { return $_[0]->{TID} }
+sub isOk { return $_[0]->{OK} }
+
+package DB::Queue::Shared;
+
+## One input list every worker takes from.  A message addressed to() a worker
+## waits for that worker; anything else goes to whichever worker asks first.
+
+use strict;
+use warnings;
+use threads;
+use threads::shared 1.51;
+
+sub new { return bless shared_clone( [] ), shift }
+
+sub enqueue
+{
+  my $self = shift;
+  my $msg  = shift;
+
+  lock @ $self;
+  push @ $self, shared_clone( $msg );
+
+  ## Any waiter can take an open message; an addressed one may need them all woken
+  defined $msg->{TO} ? cond_broadcast( @ $self ) : cond_signal( @ $self );
+
+  return;
+}
+
+sub dequeue_nb
+{
+  my $self = shift;
+
+  lock @ $self;
+  return $self->_take;
+}
+
+sub dequeue_timed
+{
+  my $self  = shift;
+  my $until = Time::HiRes::time() + shift;
+  my $msg;
+
+  lock @ $self;
+  until ( $msg = $self->_take ) { cond_timedwait( @ $self, $until ) or last }
+
+  return $msg;
+}
+
+sub pending
+{
+  my $self = shift;
+
+  lock @ $self;
+  return scalar @ $self;
+}
+
+## First message for this thread, with the lock held; pass the wakeup on if more is left
+sub _take
+{
+  my $self = shift;
+  my $tid  = threads->tid;
+
+  for my $i ( 0 .. $#{ $self } )
+  {
+    my $to = $self->[$i]{TO};
+    next if defined $to && $to != $tid;
+
+    ## The head is a plain shift; no splice on shared arrays, so an addressed
+    ## message further back closes its gap by hand
+    my $msg;
+    if ( $i == 0 )
+    {
+      $msg = shift @ $self;
+    }
+    else
+    {
+      $msg = $self->[$i];
+      $self->[$_] = $self->[ $_ + 1 ] for $i .. $#{ $self } - 1;
+      pop @ $self;
+    }
+
+    cond_signal( @ $self ) if @ $self;
+    return $msg;
+  }
+
+  return;
+}
+
 ## vim: number expandtab tabstop=2 shiftwidth=2
 ## END